@@ -182,13 +182,13 @@ std::shared_ptr<Immediate> ConstantsStateImpl::GetTemporaryImpl(
 std::shared_ptr<Immediate> ConstantsStateImpl::GetOperandImpl(
     const Operand& operand) const {
   std::shared_ptr<Immediate> value = nullptr;
-  if (operand.index() == kImmediate) {
-    value = std::make_shared<Immediate>(absl::get<Immediate>(operand));
-  } else if (operand.index() == kTemporary) {
-    value = GetTemporaryImpl(absl::get<Temporary>(operand).index);
-  } else if (operand.index() == kRegister) {
-    value = GetRegisterImpl(absl::get<Register>(operand).index);
-  } else if (operand.index() == kOffset) {
+  if (operand.type() == kImmediate) {
+    value = std::make_shared<Immediate>(operand.immediate());
+  } else if (operand.type() == kTemporary) {
+    value = GetTemporaryImpl(operand.temporary().index);
+  } else if (operand.type() == kRegister) {
+    value = GetRegisterImpl(operand.reg().index);
+  } else if (operand.type() == kOffset) {
   } else {
     CHECK(false);
   }
@@ -225,10 +225,10 @@ void ConstantsStateImpl::SetTemporaryImpl(uint16_t index,
 
 void ConstantsStateImpl::SetOperandImpl(const Operand& operand,
                                         std::shared_ptr<Immediate> value) {
-  if (operand.index() == kTemporary) {
-    SetTemporaryImpl(absl::get<Temporary>(operand).index, value);
-  } else if (operand.index() == kRegister) {
-    SetRegisterImpl(absl::get<Register>(operand).index, value);
+  if (operand.type() == kTemporary) {
+    SetTemporaryImpl(operand.temporary().index, value);
+  } else if (operand.type() == kRegister) {
+    SetRegisterImpl(operand.reg().index, value);
   } else {
     CHECK(false);
   }
@@ -236,10 +236,10 @@ void ConstantsStateImpl::SetOperandImpl(const Operand& operand,
 
 void ConstantsStateImpl::SetOperandImpl(const Operand& operand,
                                         Immediate&& value) {
-  if (operand.index() == kTemporary) {
-    SetTemporaryImpl(absl::get<Temporary>(operand).index, std::move(value));
-  } else if (operand.index() == kRegister) {
-    SetRegisterImpl(absl::get<Register>(operand).index, std::move(value));
+  if (operand.type() == kTemporary) {
+    SetTemporaryImpl(operand.temporary().index, std::move(value));
+  } else if (operand.type() == kRegister) {
+    SetRegisterImpl(operand.reg().index, std::move(value));
   } else {
     CHECK(false);
   }
@@ -247,10 +247,10 @@ void ConstantsStateImpl::SetOperandImpl(const Operand& operand,
 
 void ConstantsStateImpl::SetOperandImpl(const Operand& operand,
                                         const Immediate& value) {
-  if (operand.index() == kTemporary) {
-    SetTemporaryImpl(absl::get<Temporary>(operand).index, value);
-  } else if (operand.index() == kRegister) {
-    SetRegisterImpl(absl::get<Register>(operand).index, value);
+  if (operand.type() == kTemporary) {
+    SetTemporaryImpl(operand.temporary().index, value);
+  } else if (operand.type() == kRegister) {
+    SetRegisterImpl(operand.reg().index, value);
   } else {
     CHECK(false);
   }
@@ -271,10 +271,10 @@ void ConstantsStateImpl::ClearTemporary(uint16_t index) {
 }
 
 void ConstantsStateImpl::ClearOperand(const Operand& operand) {
-  if (operand.index() == kTemporary) {
-    ClearTemporary(absl::get<Temporary>(operand).index);
-  } else if (operand.index() == kRegister) {
-    ClearRegister(absl::get<Register>(operand).index);
+  if (operand.type() == kTemporary) {
+    ClearTemporary(operand.temporary().index);
+  } else if (operand.type() == kRegister) {
+    ClearRegister(operand.reg().index);
   } else {
     CHECK(false);
   }
@@ -361,10 +361,11 @@ void ConstantsStateImpl::TransformLdm(const Instruction& ri,
   auto value = GetOperand(ri.input0);
   if (value) {
     uint64_t address = static_cast<uint64_t>(*value);
-    if (memory_image.readable(address, Size(ri.output) / 8) &&
-        memory_image.writable(address, Size(ri.output) / 8)) {
-      SetOperand(ri.output, Immediate(memory_image.Read(address).data(),
-                                      Size(ri.output) / 8));
+    std::vector<uint8_t> bytes(Size(ri.output) / 8);
+    if (memory_image.readable(address, bytes.size()) &&
+        memory_image.writable(address, bytes.size()) &&
+        memory_image.Read(address, bytes.data(), bytes.size())) {
+      SetOperand(ri.output, Immediate(bytes.data(), bytes.size()));
     }
   } else {
     SetOperandImpl(ri.output, nullptr);
@@ -785,6 +786,11 @@ class LocalConstantsAnalysisImpl : public ConstantsAnalysis {
   uint64_t address_;
   std::map<Edge, std::unique_ptr<ConstantsStateImpl>> edge_states_;
 
+  // the analysis revisits instructions until it reaches a fixed point, so
+  // keep their translations, a whole basic block at a time, keyed by start.
+  std::map<uint64_t, std::unique_ptr<BasicBlock>> basic_blocks_;
+
+  const BasicBlock* FindBasicBlock(uint64_t address);
   std::unique_ptr<ConstantsStateImpl> AtImpl(const Node& node);
 
  public:
@@ -799,10 +805,27 @@ LocalConstantsAnalysisImpl::LocalConstantsAnalysisImpl(Session& session,
                                                        uint64_t address)
     : session_(session), address_(address) {}
 
+const BasicBlock* LocalConstantsAnalysisImpl::FindBasicBlock(
+    uint64_t address) {
+  auto iter = basic_blocks_.upper_bound(address);
+  if (iter != basic_blocks_.begin() &&
+      std::prev(iter)->second->contains(address)) {
+    return std::prev(iter)->second.get();
+  }
+
+  auto block = absl::make_unique<BasicBlock>();
+  auto instruction_provider = session_.instruction_provider();
+  if (!instruction_provider->TranslateBasicBlock(address, block.get()) ||
+      !block->contains(address)) {
+    return nullptr;
+  }
+  return basic_blocks_.emplace_hint(iter, address, std::move(block))
+      ->second.get();
+}
+
 std::unique_ptr<ConstantsStateImpl> LocalConstantsAnalysisImpl::AtImpl(
     const Node& node) {
   auto flow_graph = session_.flow_graph(address_);
-  auto instruction_provider = session_.instruction_provider();
 
   // find the first node of the basic block containing this node
   Node in_node = flow_graph->BasicBlockStart(node);
@@ -834,16 +857,22 @@ std::unique_ptr<ConstantsStateImpl> LocalConstantsAnalysisImpl::AtImpl(
     return nullptr;
   }
 
-  auto ni = instruction_provider->NativeInstruction(in_node.address);
+  const BasicBlock* block = FindBasicBlock(in_node.address);
+  if (!block || block->Index(node) == block->size()) {
+    LOG(WARNING) << "node not translated " << node;
+    return nullptr;
+  }
+
+  size_t index = block->Index(in_node);
   while (in_node != node) {
-    DCHECK(in_node.offset < ni->reil.size() - 1);
     Node next_in_node(in_node.address, in_node.offset + 1);
+    const Instruction& ri = block->reil()[index++];
 
     VLOG(4) << "in_state: " << *in_state;
-    VLOG(3) << in_node << " " << ni->reil[in_node.offset];
+    VLOG(3) << in_node << " " << ri;
 
-    in_state->Transform(Edge(in_node, next_in_node, EdgeKind::kFlow),
-                        ni->reil[in_node.offset], session_.memory_image());
+    in_state->Transform(Edge(in_node, next_in_node, EdgeKind::kFlow), ri,
+                        session_.memory_image());
 
     if (!in_state->Valid()) {
       LOG(WARNING) << "invalid in_state";
@@ -858,7 +887,6 @@ std::unique_ptr<ConstantsStateImpl> LocalConstantsAnalysisImpl::AtImpl(
 
 void LocalConstantsAnalysisImpl::Update() {
   auto flow_graph = session_.flow_graph(address_);
-  auto instruction_provider = session_.instruction_provider();
 
   std::set<Node> queue = {Node(address_)};
 
@@ -881,9 +909,13 @@ void LocalConstantsAnalysisImpl::Update() {
     }
 
     auto in_state = AtImpl(node);
+    if (!in_state) {
+      continue;
+    }
 
     // for each out edge, transform the in state to the new out state.
-    auto ri = instruction_provider->Instruction(node);
+    const BasicBlock* block = FindBasicBlock(node.address);
+    const Instruction& ri = block->reil()[block->Index(node)];
     for (auto& out_edge : flow_graph->outgoing_edges(node)) {
       auto out_state = absl::make_unique<ConstantsStateImpl>(*in_state);
 
@@ -18,6 +18,7 @@
 #include <thread>
 
 #include "flow_graph/flow_graph.h"
+#include "flow_graph/translation_cache.h"
 #include "memory_image/memory_image.h"
 
 namespace reil {
@@ -26,13 +27,18 @@ class Session {
   const MemoryImage& memory_image_;
   std::map<uint64_t, std::unique_ptr<FlowGraph>> flow_graphs_;
 
+  // the instruction providers of all threads share a single cache.
+  TranslationCache translation_cache_;
   std::mutex instruction_providers_lock_;
   std::map<std::thread::id, std::unique_ptr<InstructionProvider>>
       instruction_providers_;
 
  public:
-  Session(const MemoryImage& memory_image)
-      : memory_image_(memory_image), flow_graphs_() {}
+  Session(const MemoryImage& memory_image,
+          uint64_t translation_cache_budget = TranslationCache::kDefaultBudget)
+      : memory_image_(memory_image),
+        flow_graphs_(),
+        translation_cache_(translation_cache_budget) {}
 
   inline const MemoryImage& memory_image() const { return memory_image_; }
 
@@ -41,16 +47,18 @@ class Session {
   }
 
   inline InstructionProvider* instruction_provider() {
+    std::lock_guard<std::mutex> guard_ip_lock(instruction_providers_lock_);
     auto iter = instruction_providers_.find(std::this_thread::get_id());
     if (iter == instruction_providers_.end()) {
-      std::lock_guard<std::mutex> guard_ip_lock(instruction_providers_lock_);
       std::tie(iter, std::ignore) = instruction_providers_.emplace(
           std::this_thread::get_id(),
-          InstructionProvider::Create(memory_image_));
+          InstructionProvider::Create(memory_image_, &translation_cache_));
     }
     return iter->second.get();
   }
 
+  inline TranslationCache& translation_cache() { return translation_cache_; }
+
   inline void AddFlowGraph(std::unique_ptr<FlowGraph> flow_graph) {
     flow_graphs_[flow_graph->Entry().address] = std::move(flow_graph);
   }
@@ -31,10 +31,9 @@ namespace decoder = ::reil::aarch64::decoder;
 static decoder::Instruction DecodeInstruction(const MemoryImage& memory_image,
                                               uint64_t address) {
   decoder::Instruction insn;
-  absl::Span<const uint8_t> bytes = memory_image.Read(address);
-  if (bytes.size() >= sizeof(uint32_t)) {
-    uint32_t opcode;
-    memcpy(&opcode, bytes.data(), sizeof(opcode));
+  uint32_t opcode;
+  if (memory_image.Read(address, reinterpret_cast<uint8_t*>(&opcode),
+                        sizeof(opcode))) {
     insn = decoder::DecodeInstruction(address, opcode);
   } else {
     insn.address = address;
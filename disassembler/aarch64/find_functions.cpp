@@ -29,11 +29,22 @@ std::set<uint64_t> FindFunctions(const MemoryImage& memory_image) {
       uint64_t start_address = 0;
       bool pacsp = false, sub = false, stp = false;
 
-      for (size_t offset = 0; offset + 4 < mapping.data.size(); offset += 4) {
+      // read through the image, since the mapping may be paged in on demand.
+      absl::Span<const uint8_t> bytes;
+      for (size_t offset = 0; offset + 4 < mapping.size(); offset += 4) {
         uint64_t address = mapping.address + offset;
         uint32_t opcode;
 
-        memcpy(&opcode, &mapping.data[offset], sizeof(opcode));
+        if (bytes.size() < sizeof(opcode)) {
+          bytes = memory_image.Read(address);
+          if (bytes.size() < sizeof(opcode)) {
+            LOG(WARNING) << "could not read mapping at 0x" << std::hex
+                         << mapping.address << " offset 0x" << offset;
+            break;
+          }
+        }
+        memcpy(&opcode, bytes.data(), sizeof(opcode));
+        bytes.remove_prefix(sizeof(opcode));
 
         //VLOG(3) << std::hex << address << ": " << opcode << " "
         //        << reil::aarch64::decoder::DecodeInstruction(address, opcode);
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <mutex>
 #include <sstream>
@@ -31,11 +32,12 @@ std::mutex queue_mutex;
 std::map<uint64_t, std::unique_ptr<reil::NativeFlowGraph>> functions;
 std::mutex functions_mutex;
 
-void disassembler_thread(const reil::MemoryImage& memory_image) {
+void disassembler_thread(const reil::MemoryImage& memory_image,
+                         reil::TranslationCache& translation_cache) {
   std::unique_lock<std::mutex> queue_lock(queue_mutex, std::defer_lock);
   std::unique_lock<std::mutex> functions_lock(functions_mutex, std::defer_lock);
 
-  auto ip = reil::InstructionProvider::Create(memory_image);
+  auto ip = reil::InstructionProvider::Create(memory_image, &translation_cache);
   CHECK(ip);
 
   std::lock(queue_lock, functions_lock);
@@ -81,7 +83,7 @@ int main(int argc, char** argv) {
 
   if (argc < 2) {
     std::cerr << "Usage: " << argv[0] << " memory_image_proto"
-              << "[output_directory]" << std::endl;
+              << "[output_directory [translation_store]]" << std::endl;
     return -1;
   }
 
@@ -95,15 +97,33 @@ int main(int argc, char** argv) {
   int resolved = 0;
   int thread_count = std::thread::hardware_concurrency() / 2;
 
+  // the threads often translate the same instructions, so share one cache.
+  reil::TranslationCache translation_cache;
+
+  // translations from earlier runs over the same image are reused.
+  std::unique_ptr<reil::TranslationStore> translation_store;
+  if (argc >= 4) {
+    translation_store = reil::TranslationStore::Open(argv[3], *memory_image);
+    translation_cache.set_store(translation_store.get());
+  }
+
   std::vector<std::thread> disassembler_threads;
   for (int i = 0; i < thread_count; ++i) {
-    disassembler_threads.emplace_back(disassembler_thread, *memory_image);
+    disassembler_threads.emplace_back(disassembler_thread,
+                                      std::cref(*memory_image),
+                                      std::ref(translation_cache));
   }
 
   for (int i = 0; i < thread_count; ++i) {
     disassembler_threads[i].join();
   }
 
+  LOG(INFO) << "translation_cache: " << translation_cache.stats();
+  if (translation_store) {
+    LOG(INFO) << "translation_store: " << translation_store->stats();
+    translation_store->Save();
+  }
+
   functions_lock.lock();
   if (argc >= 3) {
     for (auto& function_iter : functions) {
@@ -0,0 +1,66 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "flow_graph/basic_block.h"
+
+#include <algorithm>
+
+#include "glog/logging.h"
+
+namespace reil {
+bool BasicBlock::contains(uint64_t address) const {
+  return !empty() && start() <= address && address < end_;
+}
+
+size_t BasicBlock::Index(const Node& node) const {
+  auto iter = std::lower_bound(addresses_.begin(), addresses_.end(),
+                               node.address);
+  if (iter == addresses_.end() || *iter != node.address) {
+    return size();
+  }
+
+  size_t i = iter - addresses_.begin();
+  size_t index = reil_begins_[i] + node.offset;
+  if (index >= reil_begins_[i + 1]) {
+    return size();
+  }
+  return index;
+}
+
+Node BasicBlock::node(size_t index) const {
+  DCHECK(index < size());
+  auto iter =
+      std::upper_bound(reil_begins_.begin(), reil_begins_.end(), index);
+  size_t i = iter - reil_begins_.begin() - 1;
+  return Node(addresses_[i], index - reil_begins_[i]);
+}
+
+void BasicBlock::Assign(TranslationBuffer* buffer) {
+  addresses_.clear();
+  reil_begins_.resize(1);
+  end_ = 0;
+
+  for (size_t i = 0; i < buffer->size(); ++i) {
+    NativeInstructionView ni = (*buffer)[i];
+    addresses_.push_back(ni.address);
+    reil_begins_.push_back(reil_begins_.back() + ni.reil.size());
+    end_ = ni.address + ni.size;
+  }
+
+  // swapping rather than moving keeps both vectors' storage for reuse.
+  reil_.clear();
+  reil_.swap(*buffer->reil());
+  buffer->Clear();
+}
+}  // namespace reil
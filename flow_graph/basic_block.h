@@ -0,0 +1,63 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef REIL_FLOW_GRAPH_BASIC_BLOCK_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/types/span.h"
+
+#include "flow_graph/node.h"
+#include "reil/reil.h"
+#include "reil/translation.h"
+
+namespace reil {
+// A run of native instructions translated as a whole, with the REIL
+// instructions of all of them in one contiguous array.
+//
+// Consumers that walk a block node by node can index into reil() directly,
+// instead of looking up (and copying) each native instruction in the
+// translation cache.
+class BasicBlock {
+  uint64_t end_ = 0;
+
+  // the address of each native instruction, and the index of its first REIL
+  // instruction; reil_begins_ has one more entry, the size of reil_.
+  std::vector<uint64_t> addresses_;
+  std::vector<uint32_t> reil_begins_ = {0};
+  std::vector<Instruction> reil_;
+
+ public:
+  uint64_t start() const { return addresses_.empty() ? 0 : addresses_[0]; }
+  uint64_t end() const { return end_; }
+  bool empty() const { return addresses_.empty(); }
+  bool contains(uint64_t address) const;
+
+  absl::Span<const Instruction> reil() const { return reil_; }
+  size_t size() const { return reil_.size(); }
+
+  // returns the index of node in reil(), or size() if node is not in this
+  // block.
+  size_t Index(const Node& node) const;
+  Node node(size_t index) const;
+
+  // takes the translation out of buffer, leaving it empty, so that the same
+  // buffer can be reused to translate the next block.
+  void Assign(TranslationBuffer* buffer);
+};
+}  // namespace reil
+
+#define REIL_FLOW_GRAPH_BASIC_BLOCK_H_
+#endif  // REIL_FLOW_GRAPH_BASIC_BLOCK_H_
@@ -0,0 +1,128 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "flow_graph/basic_block.h"
+#include "flow_graph/instruction_provider.h"
+
+namespace reil {
+namespace flow_graph {
+namespace test {
+// add x0, x1, #1; nop; ret; nop
+static const uint8_t kCode[] = {0x20, 0x04, 0x00, 0x91, 0x1f, 0x20, 0x03, 0xd5,
+                                0xc0, 0x03, 0x5f, 0xd6, 0x1f, 0x20, 0x03, 0xd5};
+
+static void AddCode(MemoryImage* memory_image) {
+  memory_image->AddMapping(
+      0x1000, std::vector<uint8_t>(kCode, kCode + sizeof(kCode)), true, false,
+      true);
+}
+
+TEST(BasicBlock, TranslateBasicBlock) {
+  MemoryImage memory_image("aarch64");
+  AddCode(&memory_image);
+  auto ip = InstructionProvider::Create(memory_image);
+
+  // translation stops after the return.
+  BasicBlock block;
+  ASSERT_TRUE(ip->TranslateBasicBlock(0x1000, &block));
+  EXPECT_EQ(block.start(), 0x1000);
+  EXPECT_EQ(block.end(), 0x100c);
+  EXPECT_TRUE(block.contains(0x1008));
+  EXPECT_FALSE(block.contains(0x100c));
+
+  // the block holds the same instructions as the cache, in order.
+  size_t index = 0;
+  for (uint64_t address = 0x1000; address < 0x100c; address += 4) {
+    auto ni = ip->NativeInstruction(address);
+    for (uint16_t offset = 0; offset < ni->reil.size(); ++offset, ++index) {
+      Node node(address, offset);
+      ASSERT_EQ(block.Index(node), index);
+      ASSERT_EQ(block.node(index), node);
+      EXPECT_EQ(block.reil()[index].opcode, ni->reil[offset].opcode);
+    }
+    EXPECT_EQ(block.Index(Node(address, ni->reil.size())), block.size());
+  }
+  EXPECT_EQ(index, block.size());
+  EXPECT_EQ(block.Index(Node(0x100c)), block.size());
+
+  EXPECT_FALSE(ip->TranslateBasicBlock(0x2000, &block));
+}
+
+TEST(BasicBlock, TranslateRange) {
+  MemoryImage memory_image("aarch64");
+  AddCode(&memory_image);
+  auto ip = InstructionProvider::Create(memory_image);
+
+  // a range is translated up to its end, past the return.
+  BasicBlock block;
+  ASSERT_TRUE(ip->TranslateBasicBlock(0x1004, 0x1010, &block));
+  EXPECT_EQ(block.start(), 0x1004);
+  EXPECT_EQ(block.end(), 0x1010);
+  EXPECT_EQ(block.Index(Node(0x1000)), block.size());
+  EXPECT_EQ(block.node(block.Index(Node(0x100c))), Node(0x100c));
+
+  EXPECT_FALSE(ip->TranslateBasicBlock(0x1008, 0x1020, &block));
+}
+
+// nops, with a return at return_offset, paged in on demand.
+class NopSource : public MappingSource {
+  uint64_t size_;
+  uint64_t return_offset_;
+
+ public:
+  NopSource(uint64_t size, uint64_t return_offset)
+      : size_(size), return_offset_(return_offset) {}
+
+  uint64_t size() const override { return size_; }
+
+  bool Read(uint64_t offset, uint8_t* data, size_t size) const override {
+    for (size_t i = 0; i < size; i += 4) {
+      memcpy(&data[i], offset + i == return_offset_ ? &kCode[8] : &kCode[4],
+             4);
+    }
+    return true;
+  }
+};
+
+TEST(BasicBlock, TranslateAcrossChunks) {
+  const uint64_t kChunkSize = MemoryImage::kChunkSize;
+
+  MemoryImage memory_image("aarch64");
+  memory_image.AddMapping(
+      0x100000, std::make_shared<NopSource>(kChunkSize * 2, kChunkSize + 8),
+      true, false, true);
+  auto ip = InstructionProvider::Create(memory_image);
+
+  // the block runs on into the next chunk, up to the return.
+  BasicBlock block;
+  ASSERT_TRUE(ip->TranslateBasicBlock(0x100000 + kChunkSize - 8, &block));
+  EXPECT_EQ(block.start(), 0x100000 + kChunkSize - 8);
+  EXPECT_EQ(block.end(), 0x100000 + kChunkSize + 12);
+}
+}  // namespace test
+}  // namespace flow_graph
+}  // namespace reil
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
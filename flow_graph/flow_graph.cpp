@@ -93,69 +93,53 @@ Node FlowGraph::Entry() const {
   return zero_edge_iter->second.begin()->target;
 }
 
-Node FlowGraph::BasicBlockStart(const Node& node) const {
-  Node bb_start = 0;
-  Node next_bb_start(0xffffffffffffffffull, 0xfffe);
-
-  for (auto in_edge_riter = incoming_edges_.rbegin();
-       in_edge_riter != incoming_edges_.rend(); ++in_edge_riter) {
-    // check that this incoming edge is at or before node
-    if (in_edge_riter->first <= node) {
-      auto out_edge_iter = outgoing_edges_.lower_bound(in_edge_riter->first);
-      // if there is no outgoing edge after the incoming edge, or the outgoing
-      // edge is after the start of the next basic block then this is an
-      // incomplete basic block
-      if (out_edge_iter == outgoing_edges_.end() ||
-          next_bb_start <= out_edge_iter->first) {
-        break;
-      }
-
-      // if the next outgoing edge is before node, then there is no basic block
-      // containing node
-      if (out_edge_iter->first < node) {
-        break;
-      }
+bool FlowGraph::FindBasicBlock(const Node& node, Node* bb_start,
+                               Node* bb_end) const {
+  // the basic block containing node starts at the last node at or before it
+  // with incoming edges, and ends at the first node after that with outgoing
+  // edges, so both are found by searching the edge maps.
+  auto in_edge_iter = incoming_edges_.upper_bound(node);
+  if (in_edge_iter == incoming_edges_.begin()) {
+    return false;
+  }
 
-      bb_start = in_edge_riter->first;
-      break;
-    }
+  // if there is no outgoing edge after the incoming edge, or the outgoing edge
+  // is at or after the start of the next basic block, then this is an
+  // incomplete basic block
+  auto next_in_edge_iter = in_edge_iter--;
+  auto out_edge_iter = outgoing_edges_.lower_bound(in_edge_iter->first);
+  if (out_edge_iter == outgoing_edges_.end() ||
+      (next_in_edge_iter != incoming_edges_.end() &&
+       next_in_edge_iter->first <= out_edge_iter->first)) {
+    return false;
+  }
 
-    next_bb_start = in_edge_riter->first;
+  // if the next outgoing edge is before node, then there is no basic block
+  // containing node
+  if (out_edge_iter->first < node) {
+    return false;
   }
 
+  *bb_start = in_edge_iter->first;
+  *bb_end = out_edge_iter->first;
+  return true;
+}
+
+Node FlowGraph::BasicBlockStart(const Node& node) const {
+  Node bb_start = 0;
+  Node bb_end = 0;
+  if (!FindBasicBlock(node, &bb_start, &bb_end)) {
+    return 0;
+  }
   return bb_start;
 }
 
 Node FlowGraph::BasicBlockEnd(const Node& node) const {
+  Node bb_start = 0;
   Node bb_end = 0;
-  Node next_bb_start(0xffffffffffffffffull, 0xfffe);
-
-  for (auto in_edge_riter = incoming_edges_.rbegin();
-       in_edge_riter != incoming_edges_.rend(); ++in_edge_riter) {
-    // check that this incoming edge is at or before node
-    if (in_edge_riter->first <= node) {
-      auto out_edge_iter = outgoing_edges_.lower_bound(in_edge_riter->first);
-      // if there is no outgoing edge after the incoming edge, or the outgoing
-      // edge is after the start of the next basic block then this is an
-      // incomplete basic block
-      if (out_edge_iter == outgoing_edges_.end() ||
-          next_bb_start <= out_edge_iter->first) {
-        break;
-      }
-
-      // if the next outgoing edge is before node, then there is no basic block
-      // containing node
-      if (out_edge_iter->first < node) {
-        break;
-      }
-
-      bb_end = out_edge_iter->first;
-      break;
-    }
-
-    next_bb_start = in_edge_riter->first;
+  if (!FindBasicBlock(node, &bb_start, &bb_end)) {
+    return 0;
   }
-
   return bb_end;
 }
 
@@ -164,7 +148,7 @@ std::unique_ptr<FlowGraph> FlowGraph::Create(const MemoryImage& memory_image,
                                              const NativeFlowGraph& nfg,
                                              uint64_t basic_block_limit) {
   std::unique_ptr<FlowGraph> rfg = absl::make_unique<FlowGraph>();
-  std::shared_ptr<NativeInstruction> ni = nullptr;
+  BasicBlock block;
 
   for (auto& in_iter : nfg.incoming_edges()) {
     if (in_iter.first == 0) {
@@ -202,21 +186,27 @@ std::unique_ptr<FlowGraph> FlowGraph::Create(const MemoryImage& memory_image,
 
     VLOG(1) << "basic_block " << bb_start << " - " << bb_end;
 
-    Node next_node = 0;
-    for (Node node = bb_start; node < bb_end; node = next_node) {
-      if (!ni || ni->address != node.address) {
-        ni = ip.NativeInstruction(node.address);
-        VLOG(3) << *ni;
+    // the whole basic block is translated in one batch.
+    if (!ip.TranslateBasicBlock(bb_start.address, bb_end.address, &block)) {
+      LOG(WARNING) << "basic_block_not_executable: " << bb_start << " "
+                   << bb_end;
+      continue;
+    }
+
+    for (size_t i = 0; i < block.size(); ++i) {
+      Node node = block.node(i);
+      if (node.offset == 0) {
+        VLOG(3) << *ip.NativeInstruction(node.address);
       }
 
-      if ((uint64_t)node.offset + 1 < ni->reil.size()) {
-        next_node.address = node.address;
-        next_node.offset = node.offset + 1;
+      Node next_node = 0;
+      if (i + 1 < block.size() && block.node(i + 1).address == node.address) {
+        next_node = block.node(i + 1);
       } else {
         next_node = ip.NextNativeInstruction(node.address);
       }
 
-      auto ri = ni->reil[node.offset];
+      const Instruction& ri = block.reil()[i];
       VLOG(4) << "  " << ri;
       if (ri.opcode == reil::Opcode::Jcc) {
         std::set<NativeEdge> edges;
@@ -228,23 +218,23 @@ std::unique_ptr<FlowGraph> FlowGraph::Create(const MemoryImage& memory_image,
           edges = nfg.outgoing_edges().at(node.address);
         }
 
-        if (ri.output.index() == kOffset) {
-          if (ri.input0.index() == kImmediate &&
-              (bool)absl::get<Immediate>(ri.input0)) {
+        if (ri.output.type() == kOffset) {
+          if (ri.input0.type() == kImmediate &&
+              (bool)ri.input0.immediate()) {
             flow = false;
           }
 
-          Offset offset = absl::get<Offset>(ri.output);
+          Offset offset = ri.output.offset();
           rfg->AddEdge(
               Edge(node, Node(node.address, offset.offset), EdgeKind::kJump));
           //DCHECK(edges.size() == 1);
         } else {
           // all non-local jcc instructions should have a hint.
-          DCHECK(ri.input1.index() == kImmediate);
-          Immediate hint = absl::get<Immediate>(ri.input1);
+          DCHECK(ri.input1.type() == kImmediate);
+          Immediate hint = ri.input1.immediate();
           if (hint == kJump) {
-            if (ri.input0.index() == kImmediate &&
-                (bool)absl::get<Immediate>(ri.input0)) {
+            if (ri.input0.type() == kImmediate &&
+                (bool)ri.input0.immediate()) {
               flow = false;
             }
 
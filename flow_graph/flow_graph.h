@@ -31,6 +31,8 @@ class FlowGraph {
   std::map<Node, std::set<Edge>> outgoing_edges_;
   std::map<Node, std::set<Edge>> incoming_edges_;
 
+  bool FindBasicBlock(const Node& node, Node* bb_start, Node* bb_end) const;
+
  public:
   void AddEdge(const Edge& edge);
   void AddEdge(const Node& source, const Node& target, EdgeKind kind);
@@ -20,6 +20,8 @@
 #include "reil/aarch64.h"
 
 namespace reil {
+constexpr uint64_t InstructionProvider::kBasicBlockLimit;
+
 uint64_t InstructionProvider::NextNativeInstruction(uint64_t address) {
   uint64_t next_address = 0;
 
@@ -31,28 +33,127 @@ uint64_t InstructionProvider::NextNativeInstruction(uint64_t address) {
   return next_address;
 }
 
-std::shared_ptr<reil::NativeInstruction> InstructionProvider::NativeInstruction(
-    uint64_t address) {
-  std::shared_ptr<reil::NativeInstruction> ni = nullptr;
+TranslationStore* InstructionProvider::store() const {
+  TranslationStore* store = cache_->store();
+  return store && store->Matches(flags_) ? store : nullptr;
+}
 
-  auto cache_iter = cache_.find(address);
-  if (cache_iter != cache_.end()) {
-    ni = cache_iter->second.lock();
-  }
+std::shared_ptr<const reil::NativeInstruction>
+InstructionProvider::NativeInstruction(uint64_t address) {
+  std::shared_ptr<const reil::NativeInstruction> ni = cache_->Find(address);
 
   if (!ni) {
     if (memory_image_.executable(address)) {
-      absl::Span<const uint8_t> bytes = memory_image_.Read(address);
-      ni = std::make_shared<reil::NativeInstruction>(
-          NativeInstruction(address, bytes));
-      cache_[address] = ni;
-      cache__[cache__index_++ % cache__.size()] = ni;
+      reil::NativeInstruction translation;
+      TranslationStore* store = this->store();
+      if (!store || !store->Find(address, flags_, &translation)) {
+        absl::Span<const uint8_t> bytes = memory_image_.Read(address);
+        translation = NativeInstruction(address, bytes);
+        if (store) {
+          store->Insert(translation);
+        }
+      }
+      ni = cache_->Insert(std::move(translation));
     }
   }
 
   return ni;
 }
 
+bool InstructionProvider::NativeInstructions(uint64_t start, uint64_t end,
+                                             TranslationBuffer* buffer) {
+  if (end < start || !memory_image_.executable(start, end - start)) {
+    return false;
+  }
+
+  // instructions in the store are taken from it, up to the first that isn't.
+  TranslationStore* store = this->store();
+  if (store) {
+    while (start < end && store->Find(start, buffer)) {
+      start += (*buffer)[buffer->size() - 1].size;
+    }
+  }
+
+  // lazily loaded mappings are read a chunk at a time.
+  size_t translated_begin = buffer->size();
+  while (start < end) {
+    absl::Span<const uint8_t> bytes = memory_image_.Read(start);
+    bytes = bytes.subspan(0, end - start);
+    if (bytes.empty()) {
+      return false;
+    }
+    NativeInstructions(start, bytes, buffer);
+    start += bytes.size();
+  }
+
+  if (store) {
+    for (size_t i = translated_begin; i < buffer->size(); ++i) {
+      store->Insert((*buffer)[i]);
+    }
+  }
+  return true;
+}
+
+bool InstructionProvider::TranslateBasicBlock(uint64_t start, uint64_t end,
+                                              BasicBlock* block) {
+  buffer_.Clear();
+  if (!NativeInstructions(start, end, &buffer_)) {
+    return false;
+  }
+
+  block->Assign(&buffer_);
+  return true;
+}
+
+bool InstructionProvider::TranslateBasicBlock(uint64_t start,
+                                              BasicBlock* block,
+                                              uint64_t limit) {
+  if (!memory_image_.executable(start)) {
+    return false;
+  }
+
+  buffer_.Clear();
+  uint64_t address = start;
+  TranslationStore* store = this->store();
+  if (store) {
+    while (address - start < limit && store->Find(address, &buffer_)) {
+      NativeInstructionView ni = buffer_[buffer_.size() - 1];
+      address += ni.size;
+      if (EndsBasicBlock(ni.reil)) {
+        block->Assign(&buffer_);
+        return true;
+      }
+    }
+  }
+
+  // lazily loaded mappings are read a chunk at a time, so the rest of the
+  // block is translated up to the end of each chunk in turn.
+  size_t translated_begin = buffer_.size();
+  while (address - start < limit && memory_image_.executable(address)) {
+    absl::Span<const uint8_t> bytes = memory_image_.Read(address);
+    size_t chunk_begin = buffer_.size();
+    NativeBasicBlock(address, bytes.subspan(0, limit - (address - start)),
+                     &buffer_);
+    if (buffer_.size() == chunk_begin) {
+      break;
+    }
+
+    NativeInstructionView ni = buffer_[buffer_.size() - 1];
+    address = ni.address + ni.size;
+    if (EndsBasicBlock(ni.reil)) {
+      break;
+    }
+  }
+
+  if (store) {
+    for (size_t i = translated_begin; i < buffer_.size(); ++i) {
+      store->Insert(buffer_[i]);
+    }
+  }
+  block->Assign(&buffer_);
+  return true;
+}
+
 Node InstructionProvider::NextInstruction(const Node& node) {
   auto ni = NativeInstruction(node.address);
   if ((uint64_t)node.offset + 1 < ni->reil.size()) {
@@ -72,8 +173,14 @@ reil::Instruction InstructionProvider::Instruction(const Node& node) {
 }
 
 InstructionProvider::InstructionProvider(const MemoryImage& memory_image,
+                                         TranslationCache* cache,
                                          enum TranslationFlags flags)
-    : memory_image_(memory_image), flags_(flags) {}
+    : memory_image_(memory_image), cache_(cache), flags_(flags) {
+  if (!cache_) {
+    own_cache_ = absl::make_unique<TranslationCache>();
+    cache_ = own_cache_.get();
+  }
+}
 
 InstructionProvider::~InstructionProvider() {}
 
@@ -83,11 +190,16 @@ class AArch64InstructionProvider : public InstructionProvider {
                                  absl::Span<const uint8_t> bytes) override;
   reil::NativeInstruction NativeInstruction(
       uint64_t address, absl::Span<const uint8_t> bytes) override;
+  void NativeInstructions(uint64_t address, absl::Span<const uint8_t> bytes,
+                          TranslationBuffer* buffer) override;
+  void NativeBasicBlock(uint64_t address, absl::Span<const uint8_t> bytes,
+                        TranslationBuffer* buffer) override;
 
  public:
   AArch64InstructionProvider(const MemoryImage& memory_image,
+                             TranslationCache* cache,
                              enum TranslationFlags flags)
-      : InstructionProvider(memory_image, flags) {}
+      : InstructionProvider(memory_image, cache, flags) {}
 };
 
 uint64_t AArch64InstructionProvider::NextNativeInstruction(
@@ -101,10 +213,32 @@ reil::NativeInstruction AArch64InstructionProvider::NativeInstruction(
                                              bytes.size(), flags_);
 }
 
+void AArch64InstructionProvider::NativeInstructions(
+    uint64_t address, absl::Span<const uint8_t> bytes,
+    TranslationBuffer* buffer) {
+  // batches are only used for analysis, so skip formatting the mnemonics.
+  reil::aarch64::TranslateRange(address, bytes.data(), bytes.size(), buffer,
+                                flags_ | kNoMnemonics);
+}
+
+void AArch64InstructionProvider::NativeBasicBlock(
+    uint64_t address, absl::Span<const uint8_t> bytes,
+    TranslationBuffer* buffer) {
+  reil::aarch64::TranslateBlock(address, bytes.data(), bytes.size(), buffer,
+                                flags_ | kNoMnemonics);
+}
+
 std::unique_ptr<InstructionProvider> InstructionProvider::Create(
     const MemoryImage& memory_image, enum TranslationFlags flags) {
+  return Create(memory_image, nullptr, flags);
+}
+
+std::unique_ptr<InstructionProvider> InstructionProvider::Create(
+    const MemoryImage& memory_image, TranslationCache* cache,
+    enum TranslationFlags flags) {
   if (memory_image.architecture_name() == "aarch64") {
-    return absl::make_unique<AArch64InstructionProvider>(memory_image, flags);
+    return absl::make_unique<AArch64InstructionProvider>(memory_image, cache,
+                                                         flags);
   } else {
     LOG(FATAL) << "Unsupported architecture";
   }
@@ -14,13 +14,13 @@
 
 #ifndef REIL_FLOW_GRAPH_INSTRUCTION_PROVIDER_H_
 
-#include <array>
-#include <map>
 #include <memory>
 
 #include "absl/types/span.h"
 
+#include "flow_graph/basic_block.h"
 #include "flow_graph/node.h"
+#include "flow_graph/translation_cache.h"
 #include "memory_image/memory_image.h"
 #include "reil/reil.h"
 #include "reil/translation.h"
@@ -29,9 +29,15 @@ namespace reil {
 class InstructionProvider {
   const MemoryImage& memory_image_;
 
-  std::map<uint64_t, std::weak_ptr<reil::NativeInstruction>> cache_;
-  std::array<std::shared_ptr<reil::NativeInstruction>, 0x100> cache__;
-  int cache__index_ = 0;
+  // the cache is either shared with other providers, or owned by this one.
+  std::unique_ptr<TranslationCache> own_cache_;
+  TranslationCache* cache_;
+
+  // reused between blocks, so that translating one does not allocate.
+  TranslationBuffer buffer_;
+
+  // the cache's store, unless it is for translations with other flags.
+  TranslationStore* store() const;
 
  protected:
   enum TranslationFlags flags_;
@@ -40,8 +46,14 @@ class InstructionProvider {
       uint64_t address, absl::Span<const uint8_t> bytes) = 0;
   virtual uint64_t NextNativeInstruction(uint64_t address,
                                          absl::Span<const uint8_t> bytes) = 0;
+  virtual void NativeInstructions(uint64_t address,
+                                  absl::Span<const uint8_t> bytes,
+                                  TranslationBuffer* buffer) = 0;
+  virtual void NativeBasicBlock(uint64_t address,
+                                absl::Span<const uint8_t> bytes,
+                                TranslationBuffer* buffer) = 0;
 
-  InstructionProvider(const MemoryImage& memory_image,
+  InstructionProvider(const MemoryImage& memory_image, TranslationCache* cache,
                       enum TranslationFlags flags);
 
  public:
@@ -51,14 +63,39 @@ class InstructionProvider {
   virtual ~InstructionProvider();
 
   uint64_t NextNativeInstruction(uint64_t address);
-  std::shared_ptr<reil::NativeInstruction> NativeInstruction(uint64_t address);
+  std::shared_ptr<const reil::NativeInstruction> NativeInstruction(
+      uint64_t address);
+
+  // translates the native instructions from start up to end into buffer in a
+  // single batch, bypassing the cache and without mnemonics. returns false if
+  // the range is not executable.
+  bool NativeInstructions(uint64_t start, uint64_t end,
+                          TranslationBuffer* buffer);
+
+  // translates the native instructions from start up to end into block, as
+  // NativeInstructions. returns false if the range is not executable.
+  bool TranslateBasicBlock(uint64_t start, uint64_t end, BasicBlock* block);
+  // translates the native instructions from start up to and including the
+  // first one that ends a basic block, or at most limit bytes, into block.
+  // returns false if start is not executable.
+  bool TranslateBasicBlock(uint64_t start, BasicBlock* block,
+                           uint64_t limit = kBasicBlockLimit);
 
   Node NextInstruction(const Node& node);
   reil::Instruction Instruction(const Node& address);
 
+  TranslationCache& cache() { return *cache_; }
+
+  static constexpr uint64_t kBasicBlockLimit = 0x1000;
+
   static std::unique_ptr<InstructionProvider> Create(
       const MemoryImage& memory_image,
       enum TranslationFlags flags = kDefaultFlags);
+  // creates a provider that shares cache with other providers for the same
+  // memory image and flags.
+  static std::unique_ptr<InstructionProvider> Create(
+      const MemoryImage& memory_image, TranslationCache* cache,
+      enum TranslationFlags flags = kDefaultFlags);
 };
 }  // namespace reil
 
@@ -106,69 +106,53 @@ uint64_t NativeFlowGraph::Entry() const {
   return zero_edge_iter->second.begin()->target;
 }
 
-uint64_t NativeFlowGraph::BasicBlockStart(uint64_t node) const {
-  uint64_t bb_start = 0;
-  uint64_t next_bb_start = 0xffffffffffffffffull;
-
-  for (auto in_edge_riter = incoming_edges_.rbegin();
-       in_edge_riter != incoming_edges_.rend(); ++in_edge_riter) {
-    // check that this incoming edge is at or before node
-    if (in_edge_riter->first <= node) {
-      auto out_edge_iter = outgoing_edges_.lower_bound(in_edge_riter->first);
-      // if there is no outgoing edge after the incoming edge, or the outgoing
-      // edge is after the start of the next basic block then this is an
-      // incomplete basic block
-      if (out_edge_iter == outgoing_edges_.end() ||
-          next_bb_start <= out_edge_iter->first) {
-        break;
-      }
-
-      // if the next outgoing edge is before node, then there is no basic block
-      // containing node
-      if (out_edge_iter->first < node) {
-        break;
-      }
+bool NativeFlowGraph::FindBasicBlock(uint64_t node, uint64_t* bb_start,
+                                     uint64_t* bb_end) const {
+  // the basic block containing node starts at the last node at or before it
+  // with incoming edges, and ends at the first node after that with outgoing
+  // edges, so both are found by searching the edge maps.
+  auto in_edge_iter = incoming_edges_.upper_bound(node);
+  if (in_edge_iter == incoming_edges_.begin()) {
+    return false;
+  }
 
-      bb_start = in_edge_riter->first;
-      break;
-    }
+  // if there is no outgoing edge after the incoming edge, or the outgoing edge
+  // is at or after the start of the next basic block, then this is an
+  // incomplete basic block
+  auto next_in_edge_iter = in_edge_iter--;
+  auto out_edge_iter = outgoing_edges_.lower_bound(in_edge_iter->first);
+  if (out_edge_iter == outgoing_edges_.end() ||
+      (next_in_edge_iter != incoming_edges_.end() &&
+       next_in_edge_iter->first <= out_edge_iter->first)) {
+    return false;
+  }
 
-    next_bb_start = in_edge_riter->first;
+  // if the next outgoing edge is before node, then there is no basic block
+  // containing node
+  if (out_edge_iter->first < node) {
+    return false;
   }
 
+  *bb_start = in_edge_iter->first;
+  *bb_end = out_edge_iter->first;
+  return true;
+}
+
+uint64_t NativeFlowGraph::BasicBlockStart(uint64_t node) const {
+  uint64_t bb_start = 0;
+  uint64_t bb_end = 0;
+  if (!FindBasicBlock(node, &bb_start, &bb_end)) {
+    return 0;
+  }
   return bb_start;
 }
 
 uint64_t NativeFlowGraph::BasicBlockEnd(uint64_t node) const {
+  uint64_t bb_start = 0;
   uint64_t bb_end = 0;
-  uint64_t next_bb_start = 0xffffffffffffffffull;
-
-  for (auto in_edge_riter = incoming_edges_.rbegin();
-       in_edge_riter != incoming_edges_.rend(); ++in_edge_riter) {
-    // check that this incoming edge is at or before node
-    if (in_edge_riter->first <= node) {
-      auto out_edge_iter = outgoing_edges_.lower_bound(in_edge_riter->first);
-      // if there is no outgoing edge after the incoming edge, or the outgoing
-      // edge is after the start of the next basic block then this is an
-      // incomplete basic block
-      if (out_edge_iter == outgoing_edges_.end() ||
-          next_bb_start <= out_edge_iter->first) {
-        break;
-      }
-
-      // if the next outgoing edge is before node, then there is no basic block
-      // containing node
-      if (out_edge_iter->first < node) {
-        break;
-      }
-
-      bb_end = out_edge_iter->first;
-      break;
-    }
-
-    next_bb_start = in_edge_riter->first;
+  if (!FindBasicBlock(node, &bb_start, &bb_end)) {
+    return 0;
   }
-
   return bb_end;
 }
 
@@ -27,6 +27,9 @@ class NativeFlowGraph {
   std::map<uint64_t, std::set<NativeEdge>> outgoing_edges_;
   std::map<uint64_t, std::set<NativeEdge>> incoming_edges_;
 
+  bool FindBasicBlock(uint64_t node, uint64_t* bb_start,
+                      uint64_t* bb_end) const;
+
  public:
   void AddEdge(const NativeEdge& edge);
   void AddEdge(uint64_t source, uint64_t target, NativeEdgeKind kind);
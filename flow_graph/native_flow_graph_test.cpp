@@ -38,6 +38,37 @@ TEST(NativeFlowGraph, IncompleteBasicBlock) {
   EXPECT_EQ(nfg.BasicBlockStart(0x1008), 0);
   EXPECT_EQ(nfg.BasicBlockEnd(0x1008), 0);
 }
+
+TEST(NativeFlowGraph, ManyBasicBlocks) {
+  NativeFlowGraph nfg;
+
+  // a chain of blocks of four instructions, with a gap after every other one.
+  nfg.AddEdge(0, 0x1000, NativeEdgeKind::kCall);
+  for (uint64_t bb_start = 0x1000; bb_start < 0x11000; bb_start += 0x20) {
+    nfg.AddEdge(bb_start + 0xc, bb_start + 0x20, NativeEdgeKind::kJump);
+  }
+
+  for (uint64_t node = 0x1000; node < 0x11000; node += 4) {
+    uint64_t bb_start = node & ~0x1full;
+    if (node - bb_start < 0x10) {
+      ASSERT_EQ(nfg.BasicBlockStart(node), bb_start);
+      ASSERT_EQ(nfg.BasicBlockEnd(node), bb_start + 0xc);
+    } else {
+      ASSERT_EQ(nfg.BasicBlockStart(node), 0);
+      ASSERT_EQ(nfg.BasicBlockEnd(node), 0);
+    }
+  }
+
+  // the last block is incomplete.
+  EXPECT_EQ(nfg.BasicBlockStart(0x11000), 0);
+  EXPECT_EQ(nfg.BasicBlockStart(0xff0), 0);
+
+  // removing the edge out of a block merges it with the next one.
+  nfg.RemoveEdge(0x100c, 0x1020, NativeEdgeKind::kJump);
+  nfg.AddEdge(0x101c, 0x1020, NativeEdgeKind::kFlow);
+  EXPECT_EQ(nfg.BasicBlockEnd(0x1010), 0x101c);
+  EXPECT_EQ(nfg.BasicBlockStart(0x1024), 0x1020);
+}
 }  // namespace test
 }  // namespace flow_graph
 }  // namespace reil
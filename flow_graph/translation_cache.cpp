@@ -0,0 +1,132 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "flow_graph/translation_cache.h"
+
+#include <utility>
+
+namespace reil {
+constexpr size_t TranslationCache::kShardCount;
+constexpr uint64_t TranslationCache::kDefaultBudget;
+
+// the memory used by a cached instruction, counting the whole of a mnemonic
+// source even if it is shared with other instructions.
+static uint64_t CachedSize(const NativeInstruction& ni) {
+  return sizeof(NativeInstruction) + ni.reil.capacity() * sizeof(Instruction) +
+         ni.mnemonic.memory_size();
+}
+
+TranslationCache::TranslationCache(uint64_t budget)
+    : shard_budget_(budget / kShardCount), hits_(0), misses_(0) {}
+
+TranslationCache::Shard& TranslationCache::shard(uint64_t address) {
+  // instructions are usually aligned, so drop the low bits to spread
+  // consecutive instructions over all the shards.
+  return shards_[(address >> 2) % kShardCount];
+}
+
+void TranslationCache::Evict(Shard& shard) {
+  // two turns of the hand are enough to clear every referenced bit and then
+  // find an entry to evict.
+  size_t steps = 2 * shard.clock.size();
+  while (shard.size > shard_budget_ && steps-- != 0) {
+    if (shard.hand == shard.clock.end()) {
+      shard.hand = shard.clock.begin();
+    }
+
+    auto entry_iter = shard.entries.find(*shard.hand);
+    Entry& entry = entry_iter->second;
+    if (entry.referenced) {
+      entry.referenced = false;
+      ++shard.hand;
+      continue;
+    }
+
+    shard.hand = shard.clock.erase(shard.hand);
+    shard.size -= entry.size;
+    ++shard.evictions;
+    shard.entries.erase(entry_iter);
+  }
+}
+
+std::shared_ptr<const NativeInstruction> TranslationCache::Find(
+    uint64_t address) {
+  Shard& shard = this->shard(address);
+  std::shared_ptr<const NativeInstruction> ni;
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto entry_iter = shard.entries.find(address);
+    if (entry_iter != shard.entries.end()) {
+      Entry& entry = entry_iter->second;
+      entry.referenced = true;
+      ni = entry.ni;
+    }
+  }
+
+  if (ni) {
+    hits_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return ni;
+}
+
+std::shared_ptr<const NativeInstruction> TranslationCache::Insert(
+    NativeInstruction&& ni) {
+  uint64_t address = ni.address;
+  ni.reil.shrink_to_fit();
+  Entry entry;
+  entry.ni = std::make_shared<const NativeInstruction>(std::move(ni));
+  entry.size = CachedSize(*entry.ni);
+  entry.referenced = false;
+
+  Shard& shard = this->shard(address);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto result = shard.entries.emplace(address, entry);
+  Entry& cached_entry = result.first->second;
+  if (!result.second) {
+    cached_entry.referenced = true;
+    return cached_entry.ni;
+  }
+
+  shard.clock.insert(shard.hand, address);
+  shard.size += entry.size;
+
+  // the new entry may itself be evicted, which is harmless since the caller
+  // still holds it.
+  Evict(shard);
+  return entry.ni;
+}
+
+TranslationCache::Stats TranslationCache::stats() {
+  Stats stats;
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    stats.evictions += shard.evictions;
+    stats.instructions += shard.entries.size();
+    stats.size += shard.size;
+  }
+  return stats;
+}
+
+std::ostream& operator<<(std::ostream& stream,
+                         const TranslationCache::Stats& stats) {
+  stream << std::dec << "hits: " << stats.hits << " misses: " << stats.misses
+         << " evictions: " << stats.evictions
+         << " instructions: " << stats.instructions << " size: " << stats.size;
+  return stream;
+}
+}  // namespace reil
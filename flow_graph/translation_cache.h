@@ -0,0 +1,112 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef REIL_FLOW_GRAPH_TRANSLATION_CACHE_H_
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+#include "flow_graph/translation_store.h"
+#include "reil/reil.h"
+
+namespace reil {
+// A cache of translated native instructions, keyed by address, which can be
+// shared by the instruction providers of several threads (as long as they
+// translate the same memory image with the same flags).
+//
+// The cache is split into shards by address, each with its own lock, so that
+// threads rarely contend. Each shard holds at most its share of the memory
+// budget, evicting instructions with the CLOCK algorithm: a hand sweeps over
+// the instructions, evicting the first one that hasn't been used since the
+// hand last passed it. Instructions are reference counted, so evicting one
+// doesn't invalidate it for any user.
+//
+// A cache can be backed by a TranslationStore, which its providers consult
+// before translating an instruction that isn't cached, and add translations
+// to (unless the store is for translations with different flags).
+class TranslationCache {
+ public:
+  static constexpr size_t kShardCount = 16;
+  static constexpr uint64_t kDefaultBudget = 0x4000000;
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t instructions = 0;
+    // the approximate memory used by the cached instructions.
+    uint64_t size = 0;
+  };
+
+ private:
+  struct Entry {
+    std::shared_ptr<const NativeInstruction> ni;
+    uint64_t size;
+    bool referenced;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<uint64_t, Entry> entries;
+    // the addresses of the entries, in the order the hand visits them, which
+    // wraps around from the end to the beginning. entries are added just
+    // behind the hand, so that they are visited last.
+    std::list<uint64_t> clock;
+    std::list<uint64_t>::iterator hand;
+    uint64_t size = 0;
+    uint64_t evictions = 0;
+
+    Shard() : hand(clock.end()) {}
+  };
+
+  std::array<Shard, kShardCount> shards_;
+  uint64_t shard_budget_;
+
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+
+  TranslationStore* store_ = nullptr;
+
+  Shard& shard(uint64_t address);
+  void Evict(Shard& shard);
+
+ public:
+  explicit TranslationCache(uint64_t budget = kDefaultBudget);
+
+  TranslationCache(const TranslationCache&) = delete;
+  TranslationCache& operator=(const TranslationCache&) = delete;
+
+  // returns the cached instruction at address, or nullptr.
+  std::shared_ptr<const NativeInstruction> Find(uint64_t address);
+  // caches ni, and returns the instruction cached at its address, which is an
+  // existing one if another thread cached the same instruction first.
+  std::shared_ptr<const NativeInstruction> Insert(NativeInstruction&& ni);
+
+  TranslationStore* store() const { return store_; }
+  void set_store(TranslationStore* store) { store_ = store; }
+
+  Stats stats();
+};
+
+std::ostream& operator<<(std::ostream& stream,
+                         const TranslationCache::Stats& stats);
+}  // namespace reil
+
+#define REIL_FLOW_GRAPH_TRANSLATION_CACHE_H_
+#endif  // REIL_FLOW_GRAPH_TRANSLATION_CACHE_H_
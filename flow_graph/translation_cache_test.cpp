@@ -0,0 +1,154 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <thread>
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "flow_graph/instruction_provider.h"
+#include "flow_graph/translation_cache.h"
+
+namespace reil {
+namespace flow_graph {
+namespace test {
+static NativeInstruction MakeInstruction(uint64_t address) {
+  NativeInstruction ni;
+  ni.address = address;
+  ni.size = 4;
+  ni.reil.push_back(Nop());
+  return ni;
+}
+
+TEST(TranslationCache, FindInsert) {
+  TranslationCache cache;
+
+  EXPECT_EQ(cache.Find(0x1000), nullptr);
+  auto ni = cache.Insert(MakeInstruction(0x1000));
+  EXPECT_EQ(ni->address, 0x1000);
+  EXPECT_EQ(cache.Find(0x1000), ni);
+  EXPECT_EQ(cache.Find(0x1004), nullptr);
+
+  // inserting an instruction that is already cached returns the cached one.
+  EXPECT_EQ(cache.Insert(MakeInstruction(0x1000)), ni);
+
+  auto stats = cache.stats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 2);
+  EXPECT_EQ(stats.instructions, 1);
+  EXPECT_GT(stats.size, 0);
+}
+
+TEST(TranslationCache, Budget) {
+  const uint64_t kBudget = 0x10000;
+  TranslationCache cache(kBudget);
+
+  for (uint64_t address = 0; address < 0x100000; address += 4) {
+    auto ni = cache.Insert(MakeInstruction(address));
+    EXPECT_LE(cache.stats().size, kBudget);
+  }
+
+  // the oldest instructions have been evicted, and the newest are still
+  // cached.
+  EXPECT_EQ(cache.Find(0), nullptr);
+  EXPECT_NE(cache.Find(0x100000 - 4), nullptr);
+  EXPECT_GT(cache.stats().evictions, 0);
+}
+
+TEST(TranslationCache, TranslatedSize) {
+  // a run of add x0, x1, #1.
+  MemoryImage memory_image("aarch64");
+  std::vector<uint8_t> data;
+  for (int i = 0; i < 0x100; ++i) {
+    data.insert(data.end(), {0x20, 0x04, 0x00, 0x91});
+  }
+  memory_image.AddMapping(0x1000, data, true, false, true);
+
+  // translations keep no spare capacity, and their mnemonics are counted.
+  TranslationCache cache;
+  auto ip = InstructionProvider::Create(memory_image, &cache);
+  uint64_t size = 0;
+  for (uint64_t address = 0x1000; address < 0x1400; address += 4) {
+    auto ni = ip->NativeInstruction(address);
+    ASSERT_EQ(ni->reil.capacity(), ni->reil.size());
+    ASSERT_GT(ni->mnemonic.memory_size(), 0);
+    size += sizeof(NativeInstruction) +
+            ni->reil.size() * sizeof(Instruction) +
+            ni->mnemonic.memory_size();
+  }
+  EXPECT_EQ(cache.stats().size, size);
+}
+
+TEST(TranslationCache, Clock) {
+  // a single instruction per shard.
+  TranslationCache cache(sizeof(NativeInstruction) *
+                         TranslationCache::kShardCount * 2);
+
+  // the instructions in one shard.
+  const uint64_t kStride = 4 * TranslationCache::kShardCount;
+  cache.Insert(MakeInstruction(0));
+  cache.Insert(MakeInstruction(kStride));
+  EXPECT_EQ(cache.stats().instructions, 1);
+
+  // a recently used instruction gets a second chance.
+  cache.Insert(MakeInstruction(kStride * 2));
+  EXPECT_NE(cache.Find(kStride * 2), nullptr);
+  cache.Insert(MakeInstruction(kStride * 3));
+  EXPECT_NE(cache.Find(kStride * 2), nullptr);
+  EXPECT_EQ(cache.Find(kStride * 3), nullptr);
+}
+
+TEST(TranslationCache, SharedByProviders) {
+  // a run of nops.
+  MemoryImage memory_image("aarch64");
+  std::vector<uint8_t> data;
+  for (int i = 0; i < 0x400; ++i) {
+    data.insert(data.end(), {0x1f, 0x20, 0x03, 0xd5});
+  }
+  memory_image.AddMapping(0x1000, data, true, false, true);
+
+  TranslationCache cache;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&memory_image, &cache]() {
+      auto ip = InstructionProvider::Create(memory_image, &cache);
+      for (uint64_t address = 0x1000; address < 0x2000; address += 4) {
+        auto ni = ip->NativeInstruction(address);
+        ASSERT_NE(ni, nullptr);
+        ASSERT_EQ(ni->address, address);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // each instruction is only translated (and missed) once, unless several
+  // threads miss it at the same time.
+  auto stats = cache.stats();
+  EXPECT_EQ(stats.hits + stats.misses, 4 * 0x400);
+  EXPECT_GE(stats.misses, 0x400);
+  EXPECT_LT(stats.misses, 4 * 0x400);
+  EXPECT_EQ(stats.instructions, 0x400);
+}
+}  // namespace test
+}  // namespace flow_graph
+}  // namespace reil
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,515 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "flow_graph/translation_store.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "glog/logging.h"
+
+#include "memory_image/mapped_file.h"
+
+namespace reil {
+// a store file is a header, a table of records sorted by address, the REIL
+// instructions of all of the records, and the data (mnemonics, and immediates
+// wider than 64 bits) that they refer to. all fields are in host byte order,
+// and the tables are 8 byte aligned, so that the file can be used in place.
+static const char kStoreMagic[8] = {'R', 'E', 'I', 'L', 'T', 'R', 'S', 0};
+static constexpr uint32_t kStoreVersion = 2;
+
+struct StoreHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint64_t image_hash;
+  uint64_t record_count;
+  uint64_t instruction_count;
+  uint64_t data_size;
+};
+
+struct TranslationStore::FileRecord {
+  uint64_t address;
+  uint64_t instruction_begin;
+  uint64_t mnemonic_offset;
+  uint32_t mnemonic_size;
+  uint16_t instruction_count;
+  uint8_t size;
+  uint8_t reserved;
+};
+
+// an operand is stored as in Operand, except that immediates wider than 64
+// bits are stored in the data, at offset value.
+struct FileOperand {
+  uint8_t type;
+  uint8_t reserved;
+  uint16_t size;
+  uint32_t index;
+  uint64_t value;
+};
+
+struct TranslationStore::FileInstruction {
+  uint8_t opcode;
+  uint8_t reserved[7];
+  FileOperand operands[4];
+};
+
+// translations are the same with or without mnemonics, so a store can be
+// shared by translations with and without them.
+static uint32_t KeyFlags(uint32_t flags) { return flags & ~kNoMnemonics; }
+
+// FNV-1a.
+static uint64_t Hash(uint64_t hash, const uint8_t* bytes, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3;
+  }
+  return hash;
+}
+
+// translations only depend on the architecture, and the address and contents
+// of the executable mappings.
+static uint64_t ImageHash(const MemoryImage& memory_image) {
+  uint64_t hash = 0xcbf29ce484222325;
+  std::string architecture_name = memory_image.architecture_name();
+  hash = Hash(hash, reinterpret_cast<const uint8_t*>(architecture_name.data()),
+              architecture_name.size());
+
+  for (const auto& mapping : memory_image.mappings()) {
+    if (!mapping.executable) {
+      continue;
+    }
+
+    uint64_t range[2] = {mapping.address, mapping.size()};
+    hash = Hash(hash, reinterpret_cast<const uint8_t*>(range), sizeof(range));
+
+    // lazily loaded mappings are read a chunk at a time.
+    uint64_t offset = 0;
+    while (offset < mapping.size()) {
+      absl::Span<const uint8_t> bytes =
+          memory_image.Read(mapping.address + offset);
+      bytes = bytes.subspan(0, mapping.size() - offset);
+      if (bytes.empty()) {
+        break;
+      }
+      hash = Hash(hash, bytes.data(), bytes.size());
+      offset += bytes.size();
+    }
+  }
+  return hash;
+}
+
+static FileOperand EncodeOperand(const Operand& operand, std::string* data) {
+  FileOperand file_operand = {};
+  file_operand.type = operand.type();
+  file_operand.size = operand.size();
+  switch (operand.type()) {
+    case kNone:
+      break;
+    case kImmediate:
+      if (operand.size() <= 64) {
+        file_operand.value = static_cast<uint64_t>(operand.immediate());
+      } else {
+        Immediate immediate = operand.immediate();
+        absl::Span<uint8_t> bytes = immediate.bytes();
+        file_operand.value = data->size();
+        data->append(reinterpret_cast<const char*>(bytes.data()),
+                     bytes.size());
+      }
+      break;
+    case kOffset:
+      file_operand.index = operand.offset().offset;
+      break;
+    case kRegister:
+      file_operand.index = operand.reg().index;
+      break;
+    case kTemporary:
+      file_operand.index = operand.temporary().index;
+      break;
+    case kLabel:
+      file_operand.index = operand.label().index;
+      break;
+  }
+  return file_operand;
+}
+
+static bool DecodeOperand(const FileOperand& file_operand, const char* data,
+                          uint64_t data_size, Operand* operand) {
+  switch (file_operand.type) {
+    case kNone:
+      *operand = Operand();
+      return true;
+    case kImmediate:
+      if (file_operand.size <= 64) {
+        *operand = Immediate(file_operand.size, file_operand.value);
+        return true;
+      }
+      if (file_operand.size % 8 != 0 || file_operand.value > data_size ||
+          file_operand.size / 8 > data_size - file_operand.value) {
+        return false;
+      }
+      *operand = Immediate(
+          reinterpret_cast<const uint8_t*>(data + file_operand.value),
+          file_operand.size / 8);
+      return true;
+    case kOffset:
+      *operand = Offset(file_operand.index);
+      return true;
+    case kRegister:
+      *operand = Register(file_operand.size, file_operand.index);
+      return true;
+    case kTemporary:
+      *operand = Temporary(file_operand.size, file_operand.index);
+      return true;
+    case kLabel:
+      *operand = Label(file_operand.index);
+      return true;
+  }
+  return false;
+}
+
+TranslationStore::TranslationStore(std::string path, uint64_t image_hash,
+                                   uint32_t flags)
+    : path_(std::move(path)),
+      image_hash_(image_hash),
+      flags_(flags),
+      hits_(0),
+      misses_(0) {}
+
+bool TranslationStore::Map() {
+  size_t file_size = 0;
+  auto file = MapFile(path_, &file_size);
+  if (!file) {
+    return false;
+  }
+
+  StoreHeader header;
+  if (file_size < sizeof(header)) {
+    LOG(WARNING) << "invalid translation store " << path_;
+    return false;
+  }
+  memcpy(&header, file.get(), sizeof(header));
+  if (memcmp(header.magic, kStoreMagic, sizeof(kStoreMagic)) != 0 ||
+      header.version != kStoreVersion ||
+      header.record_count > file_size / sizeof(FileRecord) ||
+      header.instruction_count > file_size / sizeof(FileInstruction) ||
+      header.data_size > file_size ||
+      sizeof(header) + header.record_count * sizeof(FileRecord) +
+              header.instruction_count * sizeof(FileInstruction) +
+              header.data_size !=
+          file_size) {
+    LOG(WARNING) << "invalid translation store " << path_;
+    return false;
+  }
+
+  if (header.image_hash != image_hash_ ||
+      header.flags != KeyFlags(flags_)) {
+    LOG(INFO) << "translation store " << path_
+              << " is for a different image, ignoring it";
+    return false;
+  }
+
+  const uint8_t* table = file.get() + sizeof(header);
+  records_ = reinterpret_cast<const FileRecord*>(table);
+  record_count_ = header.record_count;
+  table += record_count_ * sizeof(FileRecord);
+  instructions_ = reinterpret_cast<const FileInstruction*>(table);
+  instruction_count_ = header.instruction_count;
+  table += instruction_count_ * sizeof(FileInstruction);
+  data_ = reinterpret_cast<const char*>(table);
+  data_size_ = header.data_size;
+  file_ = std::move(file);
+  return true;
+}
+
+std::unique_ptr<TranslationStore> TranslationStore::Open(
+    std::string path, const MemoryImage& memory_image, uint32_t flags) {
+  auto store = absl::WrapUnique(
+      new TranslationStore(std::move(path), ImageHash(memory_image), flags));
+  store->Map();
+  return store;
+}
+
+bool TranslationStore::Matches(uint32_t flags) const {
+  return KeyFlags(flags) == KeyFlags(flags_);
+}
+
+const TranslationStore::FileRecord* TranslationStore::FindRecord(
+    uint64_t address) const {
+  const FileRecord* end = records_ + record_count_;
+  const FileRecord* record = std::lower_bound(
+      records_, end, address, [](const FileRecord& record, uint64_t address) {
+        return record.address < address;
+      });
+  if (record == end || record->address != address) {
+    return nullptr;
+  }
+  return record;
+}
+
+bool TranslationStore::Decode(const FileRecord& record,
+                              std::vector<Instruction>* reil) const {
+  if (record.instruction_begin > instruction_count_ ||
+      record.instruction_count >
+          instruction_count_ - record.instruction_begin ||
+      record.mnemonic_offset > data_size_ ||
+      record.mnemonic_size > data_size_ - record.mnemonic_offset) {
+    LOG(WARNING) << "invalid record in translation store " << path_;
+    return false;
+  }
+
+  size_t reil_begin = reil->size();
+  for (size_t i = 0; i < record.instruction_count; ++i) {
+    const FileInstruction& file_ri =
+        instructions_[record.instruction_begin + i];
+    Instruction ri;
+    ri.opcode = static_cast<Opcode>(file_ri.opcode);
+    if (file_ri.opcode > static_cast<uint8_t>(Opcode::Ite) ||
+        !DecodeOperand(file_ri.operands[0], data_, data_size_, &ri.input0) ||
+        !DecodeOperand(file_ri.operands[1], data_, data_size_, &ri.input1) ||
+        !DecodeOperand(file_ri.operands[2], data_, data_size_, &ri.input2) ||
+        !DecodeOperand(file_ri.operands[3], data_, data_size_, &ri.output)) {
+      LOG(WARNING) << "invalid record in translation store " << path_;
+      reil->resize(reil_begin);
+      return false;
+    }
+    reil->push_back(ri);
+  }
+  return true;
+}
+
+bool TranslationStore::Decode(const FileRecord& record,
+                              NativeInstruction* ni) const {
+  ni->reil.clear();
+  if (!Decode(record, &ni->reil)) {
+    return false;
+  }
+
+  ni->address = record.address;
+  ni->size = record.size;
+  ni->mnemonic = Mnemonic(
+      std::string(data_ + record.mnemonic_offset, record.mnemonic_size));
+  return true;
+}
+
+bool TranslationStore::Find(uint64_t address, uint32_t flags,
+                            NativeInstruction* ni) {
+  bool mnemonic = !(flags & kNoMnemonics);
+  const FileRecord* record = FindRecord(address);
+  if (record && (record->mnemonic_size != 0 || !mnemonic) &&
+      Decode(*record, ni)) {
+    ++hits_;
+    return true;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto added_iter = added_.find(address);
+    if (added_iter != added_.end() &&
+        (!added_iter->second.mnemonic.empty() || !mnemonic)) {
+      *ni = added_iter->second;
+      ++hits_;
+      return true;
+    }
+  }
+
+  ++misses_;
+  return false;
+}
+
+bool TranslationStore::Find(uint64_t address, TranslationBuffer* buffer) {
+  const FileRecord* record = FindRecord(address);
+  if (record && Decode(*record, buffer->reil())) {
+    buffer->mnemonics()->append(data_ + record->mnemonic_offset,
+                                record->mnemonic_size);
+    buffer->Commit(record->address, record->size);
+    ++hits_;
+    return true;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto added_iter = added_.find(address);
+    if (added_iter != added_.end()) {
+      const NativeInstruction& ni = added_iter->second;
+      buffer->reil()->insert(buffer->reil()->end(), ni.reil.begin(),
+                             ni.reil.end());
+      if (!ni.mnemonic.empty()) {
+        buffer->mnemonics()->append(ni.mnemonic.str());
+      }
+      buffer->Commit(ni.address, ni.size);
+      ++hits_;
+      return true;
+    }
+  }
+
+  ++misses_;
+  return false;
+}
+
+void TranslationStore::Add(NativeInstruction&& ni) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto added_iter = added_.find(ni.address);
+  if (added_iter == added_.end()) {
+    added_.emplace(ni.address, std::move(ni));
+  } else if (added_iter->second.mnemonic.empty()) {
+    added_iter->second = std::move(ni);
+  }
+}
+
+void TranslationStore::Insert(const NativeInstruction& ni) {
+  // a stored translation is only replaced to add its mnemonic.
+  const FileRecord* record = FindRecord(ni.address);
+  if (record && (record->mnemonic_size != 0 || ni.mnemonic.empty())) {
+    return;
+  }
+  Add(NativeInstruction(ni));
+}
+
+void TranslationStore::Insert(const NativeInstructionView& ni) {
+  const FileRecord* record = FindRecord(ni.address);
+  if (record && (record->mnemonic_size != 0 || ni.mnemonic.empty())) {
+    return;
+  }
+
+  NativeInstruction added_ni;
+  added_ni.address = ni.address;
+  added_ni.size = ni.size;
+  if (!ni.mnemonic.empty()) {
+    added_ni.mnemonic = Mnemonic(std::string(ni.mnemonic));
+  }
+  added_ni.reil.assign(ni.reil.begin(), ni.reil.end());
+  Add(std::move(added_ni));
+}
+
+bool TranslationStore::Save() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (added_.empty()) {
+    return true;
+  }
+
+  std::vector<FileRecord> records;
+  std::vector<FileInstruction> instructions;
+  std::string data;
+  auto append = [&records, &instructions, &data](const NativeInstruction& ni) {
+    std::string mnemonic = ni.mnemonic.str();
+    CHECK(ni.reil.size() <= UINT16_MAX && mnemonic.size() <= UINT32_MAX)
+        << "translation at 0x" << std::hex << ni.address
+        << " is too large to store";
+
+    FileRecord record = {};
+    record.address = ni.address;
+    record.size = ni.size;
+    record.instruction_begin = instructions.size();
+    record.instruction_count = ni.reil.size();
+    record.mnemonic_offset = data.size();
+    record.mnemonic_size = mnemonic.size();
+    data += mnemonic;
+    records.push_back(record);
+
+    for (const auto& ri : ni.reil) {
+      FileInstruction file_ri = {};
+      file_ri.opcode = static_cast<uint8_t>(ri.opcode);
+      file_ri.operands[0] = EncodeOperand(ri.input0, &data);
+      file_ri.operands[1] = EncodeOperand(ri.input1, &data);
+      file_ri.operands[2] = EncodeOperand(ri.input2, &data);
+      file_ri.operands[3] = EncodeOperand(ri.output, &data);
+      instructions.push_back(file_ri);
+    }
+  };
+
+  // the records in the file and the added translations are merged in address
+  // order; an added translation replaces a record at the same address.
+  auto added_iter = added_.begin();
+  NativeInstruction ni;
+  for (uint64_t i = 0; i < record_count_; ++i) {
+    const FileRecord& record = records_[i];
+    for (; added_iter != added_.end() && added_iter->first < record.address;
+         ++added_iter) {
+      append(added_iter->second);
+    }
+    if (added_iter != added_.end() && added_iter->first == record.address) {
+      continue;
+    }
+    if (Decode(record, &ni)) {
+      append(ni);
+    }
+  }
+  for (; added_iter != added_.end(); ++added_iter) {
+    append(added_iter->second);
+  }
+
+  StoreHeader header;
+  memcpy(header.magic, kStoreMagic, sizeof(kStoreMagic));
+  header.version = kStoreVersion;
+  header.flags = KeyFlags(flags_);
+  header.image_hash = image_hash_;
+  header.record_count = records.size();
+  header.instruction_count = instructions.size();
+  header.data_size = data.size();
+
+  // the new file replaces the old one in a single step, so that the old one
+  // stays intact (and mapped) if writing fails.
+  std::string temporary_path = path_ + ".tmp";
+  {
+    std::fstream output(temporary_path,
+                        std::ios::out | std::ios::trunc | std::ios::binary);
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char*>(records.data()),
+                 records.size() * sizeof(FileRecord));
+    output.write(reinterpret_cast<const char*>(instructions.data()),
+                 instructions.size() * sizeof(FileInstruction));
+    output << data;
+    output.close();
+    if (!output) {
+      LOG(ERROR) << "could not write translation store " << temporary_path;
+      unlink(temporary_path.c_str());
+      return false;
+    }
+  }
+
+  if (rename(temporary_path.c_str(), path_.c_str()) != 0) {
+    LOG(ERROR) << "could not replace translation store " << path_;
+    unlink(temporary_path.c_str());
+    return false;
+  }
+
+  added_.clear();
+  return Map();
+}
+
+TranslationStore::Stats TranslationStore::stats() {
+  Stats stats;
+  stats.hits = hits_;
+  stats.misses = misses_;
+  stats.instructions = record_count_;
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats.added = added_.size();
+  return stats;
+}
+
+std::ostream& operator<<(std::ostream& stream,
+                         const TranslationStore::Stats& stats) {
+  stream << std::dec << "hits: " << stats.hits << " misses: " << stats.misses
+         << " instructions: " << stats.instructions
+         << " added: " << stats.added;
+  return stream;
+}
+}  // namespace reil
@@ -0,0 +1,121 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef REIL_FLOW_GRAPH_TRANSLATION_STORE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "memory_image/memory_image.h"
+#include "reil/reil.h"
+#include "reil/translation.h"
+
+namespace reil {
+// A persistent store of translated native instructions, so that translating
+// the same image again (in a later run) can skip decoding and translation.
+//
+// A store file holds the translations of one memory image, identified by a
+// hash of its architecture and executable mappings, with one set of
+// translation flags; a file for any other image or flags is ignored. The file
+// is mapped read-only and looked up in place, and translations added since it
+// was opened are kept in memory until Save rewrites it.
+//
+// Translations from batches have no mnemonic; these are only returned for
+// single instructions if the caller asks for no mnemonics, and are replaced
+// when the instruction is later translated with one.
+class TranslationStore {
+ public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // the instructions in the file, and those added since it was opened.
+    uint64_t instructions = 0;
+    uint64_t added = 0;
+  };
+
+ private:
+  struct FileRecord;
+  struct FileInstruction;
+
+  std::string path_;
+  uint64_t image_hash_;
+  uint32_t flags_;
+
+  std::shared_ptr<const uint8_t> file_;
+  const FileRecord* records_ = nullptr;
+  uint64_t record_count_ = 0;
+  const FileInstruction* instructions_ = nullptr;
+  uint64_t instruction_count_ = 0;
+  const char* data_ = nullptr;
+  uint64_t data_size_ = 0;
+
+  std::mutex mutex_;
+  std::map<uint64_t, NativeInstruction> added_;
+
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+
+  TranslationStore(std::string path, uint64_t image_hash, uint32_t flags);
+
+  const FileRecord* FindRecord(uint64_t address) const;
+  bool Decode(const FileRecord& record, NativeInstruction* ni) const;
+  bool Decode(const FileRecord& record, std::vector<Instruction>* reil) const;
+  bool Map();
+  void Add(NativeInstruction&& ni);
+
+ public:
+  TranslationStore(const TranslationStore&) = delete;
+  TranslationStore& operator=(const TranslationStore&) = delete;
+
+  // opens the store at path for translations of memory_image with flags. the
+  // store is empty if there is no valid file at path for the same image and
+  // flags.
+  static std::unique_ptr<TranslationStore> Open(
+      std::string path, const MemoryImage& memory_image,
+      uint32_t flags = kDefaultFlags);
+
+  // whether the store holds translations made with flags, which are the only
+  // ones that may be taken from or added to it.
+  bool Matches(uint32_t flags) const;
+
+  // returns the stored translation of the native instruction at address in
+  // ni, or false if there is none. a translation without a mnemonic is only
+  // returned if flags, those of the caller, include kNoMnemonics.
+  bool Find(uint64_t address, uint32_t flags, NativeInstruction* ni);
+  // appends the stored translation of the native instruction at address to
+  // buffer, or returns false if there is none.
+  bool Find(uint64_t address, TranslationBuffer* buffer);
+
+  void Insert(const NativeInstruction& ni);
+  void Insert(const NativeInstructionView& ni);
+
+  // writes the stored translations back to the file, if any were added. this
+  // remaps the file, so it must not be called while the store is in use.
+  bool Save();
+
+  Stats stats();
+};
+
+std::ostream& operator<<(std::ostream& stream,
+                         const TranslationStore::Stats& stats);
+}  // namespace reil
+
+#define REIL_FLOW_GRAPH_TRANSLATION_STORE_H_
+#endif  // REIL_FLOW_GRAPH_TRANSLATION_STORE_H_
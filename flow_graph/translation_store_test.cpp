@@ -0,0 +1,197 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+#include "flow_graph/instruction_provider.h"
+#include "flow_graph/translation_cache.h"
+#include "flow_graph/translation_store.h"
+
+namespace reil {
+namespace flow_graph {
+namespace test {
+// add x0, x1, #1; nop; ret; nop
+static const uint8_t kCode[] = {0x20, 0x04, 0x00, 0x91, 0x1f, 0x20, 0x03, 0xd5,
+                                0xc0, 0x03, 0x5f, 0xd6, 0x1f, 0x20, 0x03, 0xd5};
+
+static void AddCode(MemoryImage* memory_image) {
+  memory_image->AddMapping(
+      0x1000, std::vector<uint8_t>(kCode, kCode + sizeof(kCode)), true, false,
+      true);
+}
+
+static std::string Print(const NativeInstruction& ni) {
+  std::stringstream stream;
+  stream << ni;
+  return stream.str();
+}
+
+static std::string StorePath(const std::string& name) {
+  std::string path = ::testing::TempDir() + "/" + name + ".trs";
+  remove(path.c_str());
+  return path;
+}
+
+TEST(TranslationStore, SaveOpen) {
+  MemoryImage memory_image("aarch64");
+  AddCode(&memory_image);
+  std::string path = StorePath("translation_store_test");
+
+  auto store = TranslationStore::Open(path, memory_image);
+  EXPECT_EQ(store->stats().instructions, 0);
+
+  TranslationCache cache;
+  cache.set_store(store.get());
+  auto ip = InstructionProvider::Create(memory_image, &cache);
+  std::vector<std::string> expected;
+  for (uint64_t address = 0x1000; address < 0x1010; address += 4) {
+    expected.push_back(Print(*ip->NativeInstruction(address)));
+  }
+  EXPECT_EQ(store->stats().misses, 4);
+  EXPECT_EQ(store->stats().added, 4);
+  ASSERT_TRUE(store->Save());
+  EXPECT_EQ(store->stats().instructions, 4);
+  EXPECT_EQ(store->stats().added, 0);
+
+  // a later run takes the translations from the store.
+  auto warm_store = TranslationStore::Open(path, memory_image);
+  EXPECT_EQ(warm_store->stats().instructions, 4);
+  TranslationCache warm_cache;
+  warm_cache.set_store(warm_store.get());
+  auto warm_ip = InstructionProvider::Create(memory_image, &warm_cache);
+  for (uint64_t address = 0x1000; address < 0x1010; address += 4) {
+    EXPECT_EQ(Print(*warm_ip->NativeInstruction(address)),
+              expected[(address - 0x1000) / 4]);
+  }
+  EXPECT_EQ(warm_store->stats().hits, 4);
+  EXPECT_EQ(warm_store->stats().misses, 0);
+
+  // and so do batches.
+  BasicBlock block;
+  ASSERT_TRUE(warm_ip->TranslateBasicBlock(0x1000, &block));
+  EXPECT_EQ(block.end(), 0x100c);
+  EXPECT_EQ(warm_store->stats().hits, 7);
+
+  // a store for a different image, or different flags, is ignored.
+  MemoryImage other_image("aarch64");
+  other_image.AddMapping(0x2000,
+                         std::vector<uint8_t>(kCode, kCode + sizeof(kCode)),
+                         true, false, true);
+  EXPECT_EQ(TranslationStore::Open(path, other_image)->stats().instructions,
+            0);
+  EXPECT_EQ(TranslationStore::Open(path, memory_image, kPureReil)
+                ->stats()
+                .instructions,
+            0);
+  EXPECT_EQ(TranslationStore::Open(path, memory_image, kNoMnemonics)
+                ->stats()
+                .instructions,
+            4);
+
+  // and providers translating with different flags don't use the store.
+  EXPECT_TRUE(warm_store->Matches(kNoMnemonics));
+  EXPECT_FALSE(warm_store->Matches(kPureReil));
+  TranslationCache other_cache;
+  other_cache.set_store(warm_store.get());
+  auto other_ip =
+      InstructionProvider::Create(memory_image, &other_cache, kPureReil);
+  ASSERT_NE(other_ip->NativeInstruction(0x1000), nullptr);
+  ASSERT_TRUE(other_ip->TranslateBasicBlock(0x1000, &block));
+  EXPECT_EQ(warm_store->stats().hits, 7);
+  EXPECT_EQ(warm_store->stats().misses, 0);
+  EXPECT_EQ(warm_store->stats().added, 0);
+}
+
+TEST(TranslationStore, Mnemonics) {
+  MemoryImage memory_image("aarch64");
+  AddCode(&memory_image);
+  std::string path = StorePath("translation_store_test_mnemonics");
+
+  auto store = TranslationStore::Open(path, memory_image);
+  TranslationCache cache;
+  cache.set_store(store.get());
+  auto ip = InstructionProvider::Create(memory_image, &cache);
+
+  // batches are translated without mnemonics, so their translations aren't
+  // used for single instructions, which need one.
+  BasicBlock block;
+  ASSERT_TRUE(ip->TranslateBasicBlock(0x1000, 0x1010, &block));
+  EXPECT_EQ(store->stats().added, 4);
+  NativeInstruction ni;
+  EXPECT_FALSE(store->Find(0x1000, kDefaultFlags, &ni));
+
+  auto cached = ip->NativeInstruction(0x1000);
+  ASSERT_TRUE(store->Find(0x1000, kDefaultFlags, &ni));
+  EXPECT_EQ(Print(ni), Print(*cached));
+  EXPECT_FALSE(ni.mnemonic.empty());
+
+  ASSERT_TRUE(store->Save());
+  auto warm_store = TranslationStore::Open(path, memory_image);
+  ASSERT_TRUE(warm_store->Find(0x1000, kDefaultFlags, &ni));
+  EXPECT_EQ(Print(ni), Print(*cached));
+  EXPECT_FALSE(warm_store->Find(0x1004, kDefaultFlags, &ni));
+  auto no_mnemonics_store =
+      TranslationStore::Open(path, memory_image, kNoMnemonics);
+  EXPECT_TRUE(no_mnemonics_store->Find(0x1004, kNoMnemonics, &ni));
+
+  // what is acceptable depends on the caller's flags, not the store's.
+  EXPECT_FALSE(no_mnemonics_store->Find(0x1004, kDefaultFlags, &ni));
+  TranslationCache no_mnemonics_cache;
+  no_mnemonics_cache.set_store(no_mnemonics_store.get());
+  auto mnemonics_ip =
+      InstructionProvider::Create(memory_image, &no_mnemonics_cache);
+  auto translated = mnemonics_ip->NativeInstruction(0x1004);
+  ASSERT_NE(translated, nullptr);
+  EXPECT_FALSE(translated->mnemonic.empty());
+}
+
+TEST(TranslationStore, WideImmediates) {
+  MemoryImage memory_image("aarch64");
+  AddCode(&memory_image);
+  std::string path = StorePath("translation_store_test_wide");
+
+  Immediate wide = Immediate(128, 0x1234) << 100;
+  NativeInstruction ni;
+  ni.address = 0x1000;
+  ni.size = 4;
+  ni.mnemonic = Mnemonic(std::string("wide"));
+  ni.reil.push_back(Str(wide, Temporary(128, 0)));
+  ni.reil.push_back(Jcc(Imm8(1), Offset(0)));
+
+  auto store = TranslationStore::Open(path, memory_image);
+  store->Insert(ni);
+  ASSERT_TRUE(store->Save());
+
+  NativeInstruction stored_ni;
+  ASSERT_TRUE(
+      TranslationStore::Open(path, memory_image)
+          ->Find(0x1000, kDefaultFlags, &stored_ni));
+  EXPECT_EQ(Print(stored_ni), Print(ni));
+  EXPECT_EQ(stored_ni.reil[0].input0.immediate(), wide);
+}
+}  // namespace test
+}  // namespace flow_graph
+}  // namespace reil
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
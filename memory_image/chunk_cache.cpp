@@ -0,0 +1,69 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "memory_image/chunk_cache.h"
+
+#include <utility>
+
+namespace reil {
+ChunkCache::ChunkCache(uint64_t limit) : size_(0), limit_(limit) {}
+
+void ChunkCache::Evict() {
+  // the most recently used chunk is always kept, even if it alone is over the
+  // limit.
+  while (size_ > limit_ && lru_.size() > 1) {
+    auto entry_iter = entries_.find(lru_.back());
+    size_ -= entry_iter->second.chunk->size();
+    entries_.erase(entry_iter);
+    lru_.pop_back();
+  }
+}
+
+ChunkCache::Chunk ChunkCache::Find(uint64_t address) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto entry_iter = entries_.find(address);
+  if (entry_iter == entries_.end()) {
+    return nullptr;
+  }
+
+  lru_.splice(lru_.begin(), lru_, entry_iter->second.lru_iter);
+  return entry_iter->second.chunk;
+}
+
+ChunkCache::Chunk ChunkCache::Insert(uint64_t address, Chunk chunk) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto entry_iter = entries_.find(address);
+  if (entry_iter != entries_.end()) {
+    lru_.splice(lru_.begin(), lru_, entry_iter->second.lru_iter);
+    return entry_iter->second.chunk;
+  }
+
+  lru_.push_front(address);
+  size_ += chunk->size();
+  entries_.emplace(address, Entry({chunk, lru_.begin()}));
+  Evict();
+  return chunk;
+}
+
+uint64_t ChunkCache::size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+void ChunkCache::set_limit(uint64_t limit) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  limit_ = limit;
+  Evict();
+}
+}  // namespace reil
@@ -0,0 +1,61 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef REIL_MEMORY_IMAGE_CHUNK_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace reil {
+// An LRU cache of the chunks paged in from lazily loaded mappings, bounded by
+// their total size. Chunks are freed once evicted and no longer in use.
+class ChunkCache {
+ public:
+  typedef std::shared_ptr<const std::vector<uint8_t>> Chunk;
+
+ private:
+  struct Entry {
+    Chunk chunk;
+    std::list<uint64_t>::iterator lru_iter;
+  };
+
+  std::mutex mutex_;
+  std::unordered_map<uint64_t, Entry> entries_;
+  // addresses of the cached chunks, most recently used first.
+  std::list<uint64_t> lru_;
+  uint64_t size_;
+  uint64_t limit_;
+
+  void Evict();
+
+ public:
+  explicit ChunkCache(uint64_t limit);
+
+  // returns the chunk at address, or nullptr if it isn't cached.
+  Chunk Find(uint64_t address);
+  // caches chunk at address, and returns the chunk cached there, which is an
+  // existing one if another thread cached the same chunk first.
+  Chunk Insert(uint64_t address, Chunk chunk);
+
+  uint64_t size();
+  void set_limit(uint64_t limit);
+};
+}  // namespace reil
+
+#define REIL_MEMORY_IMAGE_CHUNK_CACHE_H_
+#endif  // REIL_MEMORY_IMAGE_CHUNK_CACHE_H_
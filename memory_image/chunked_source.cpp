@@ -0,0 +1,137 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "memory_image/chunked_source.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "glog/logging.h"
+#include "zlib.h"
+
+namespace reil {
+ChunkEncoding EncodeChunk(absl::Span<const uint8_t> chunk,
+                          std::vector<uint8_t>* encoded) {
+  encoded->clear();
+  if (std::all_of(chunk.begin(), chunk.end(),
+                  [](uint8_t byte) { return byte == 0; })) {
+    return kChunkZero;
+  }
+
+  uLongf encoded_size = compressBound(chunk.size());
+  encoded->resize(encoded_size);
+  if (compress2(encoded->data(), &encoded_size, chunk.data(), chunk.size(),
+                Z_DEFAULT_COMPRESSION) == Z_OK &&
+      encoded_size < chunk.size()) {
+    encoded->resize(encoded_size);
+    return kChunkDeflate;
+  }
+
+  encoded->assign(chunk.begin(), chunk.end());
+  return kChunkStored;
+}
+
+ChunkedSource::ChunkedSource(std::shared_ptr<const MappingSource> file,
+                             std::vector<FileChunk> chunks, uint64_t size)
+    : file_(std::move(file)), chunks_(std::move(chunks)), size_(size) {}
+
+std::shared_ptr<const ChunkedSource> ChunkedSource::Create(
+    std::shared_ptr<const MappingSource> file, uint64_t offset,
+    uint64_t size) {
+  const uint64_t kChunkSize = MemoryImage::kChunkSize;
+  uint64_t chunk_count = (size + kChunkSize - 1) / kChunkSize;
+  uint64_t file_size = file->size();
+  if (offset > file_size ||
+      chunk_count > (file_size - offset) / sizeof(FileChunk)) {
+    return nullptr;
+  }
+
+  std::vector<FileChunk> chunks(chunk_count);
+  if (!file->Read(offset, reinterpret_cast<uint8_t*>(chunks.data()),
+                  chunks.size() * sizeof(FileChunk))) {
+    return nullptr;
+  }
+
+  for (size_t index = 0; index < chunks.size(); ++index) {
+    const FileChunk& chunk = chunks[index];
+    uint64_t chunk_size = std::min(kChunkSize, size - index * kChunkSize);
+    if (chunk.offset > file_size || chunk.size > file_size - chunk.offset ||
+        chunk.encoding > kChunkDeflate ||
+        (chunk.encoding == kChunkStored && chunk.size != chunk_size)) {
+      return nullptr;
+    }
+  }
+
+  return std::shared_ptr<const ChunkedSource>(
+      new ChunkedSource(std::move(file), std::move(chunks), size));
+}
+
+bool ChunkedSource::ReadChunk(size_t index, uint8_t* data,
+                              size_t size) const {
+  const FileChunk& chunk = chunks_[index];
+  switch (chunk.encoding) {
+    case kChunkZero:
+      memset(data, 0, size);
+      return true;
+
+    case kChunkStored:
+      return file_->Read(chunk.offset, data, size);
+
+    case kChunkDeflate: {
+      std::vector<uint8_t> encoded(chunk.size);
+      uLongf decoded_size = size;
+      return file_->Read(chunk.offset, encoded.data(), encoded.size()) &&
+             uncompress(data, &decoded_size, encoded.data(),
+                        encoded.size()) == Z_OK &&
+             decoded_size == size;
+    }
+  }
+  return false;
+}
+
+bool ChunkedSource::Read(uint64_t offset, uint8_t* data, size_t size) const {
+  const uint64_t kChunkSize = MemoryImage::kChunkSize;
+  if (offset > size_ || size > size_ - offset) {
+    return false;
+  }
+
+  std::vector<uint8_t> chunk;
+  while (size != 0) {
+    size_t index = offset / kChunkSize;
+    uint64_t chunk_offset = offset % kChunkSize;
+    uint64_t chunk_size = std::min(kChunkSize, size_ - index * kChunkSize);
+    uint64_t read_size = std::min<uint64_t>(size, chunk_size - chunk_offset);
+
+    // whole chunks (which is how MemoryImage reads them) are decoded in place,
+    // and anything else through a copy.
+    if (read_size == chunk_size) {
+      if (!ReadChunk(index, data, chunk_size)) {
+        return false;
+      }
+    } else {
+      chunk.resize(chunk_size);
+      if (!ReadChunk(index, chunk.data(), chunk_size)) {
+        return false;
+      }
+      memcpy(data, &chunk[chunk_offset], read_size);
+    }
+
+    offset += read_size;
+    data += read_size;
+    size -= read_size;
+  }
+  return true;
+}
+}  // namespace reil
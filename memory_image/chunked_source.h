@@ -0,0 +1,70 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef REIL_MEMORY_IMAGE_CHUNKED_SOURCE_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/types/span.h"
+
+#include "memory_image/memory_image.h"
+
+namespace reil {
+enum ChunkEncoding : uint32_t {
+  // an all zero chunk, which takes no space in the file.
+  kChunkZero = 0,
+  kChunkStored = 1,
+  kChunkDeflate = 2,
+};
+
+// an entry in the chunk table of a chunked mapping in a native format file.
+struct FileChunk {
+  uint64_t offset;
+  uint32_t size;
+  uint32_t encoding;
+};
+
+// encodes a chunk, returning the encoding used and setting encoded to the
+// data to store for it. chunks that don't compress are stored as they are.
+ChunkEncoding EncodeChunk(absl::Span<const uint8_t> chunk,
+                          std::vector<uint8_t>* encoded);
+
+// Reads a mapping stored in the native format as separately encoded chunks,
+// decoding each chunk when it is read.
+class ChunkedSource : public MappingSource {
+  std::shared_ptr<const MappingSource> file_;
+  std::vector<FileChunk> chunks_;
+  uint64_t size_;
+
+  ChunkedSource(std::shared_ptr<const MappingSource> file,
+                std::vector<FileChunk> chunks, uint64_t size);
+
+  bool ReadChunk(size_t index, uint8_t* data, size_t size) const;
+
+ public:
+  // reads and checks the chunk table at offset in file, for a mapping of size
+  // bytes.
+  static std::shared_ptr<const ChunkedSource> Create(
+      std::shared_ptr<const MappingSource> file, uint64_t offset,
+      uint64_t size);
+
+  uint64_t size() const override { return size_; }
+  bool Read(uint64_t offset, uint8_t* data, size_t size) const override;
+};
+}  // namespace reil
+
+#define REIL_MEMORY_IMAGE_CHUNKED_SOURCE_H_
+#endif  // REIL_MEMORY_IMAGE_CHUNKED_SOURCE_H_
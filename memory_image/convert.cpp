@@ -0,0 +1,54 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Converts a memory image to the native format, so that it can be mapped
+// rather than parsed when it is loaded, or with --chunked to the chunked form
+// of it, which is compressed and paged in on demand:
+//
+//   convert [--chunked] input.mem output.mem
+
+#include <cstring>
+#include <iostream>
+
+#include "glog/logging.h"
+
+#include "memory_image/memory_image.h"
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+
+  bool chunked = argc == 4 && strcmp(argv[1], "--chunked") == 0;
+  if (argc != 3 && !chunked) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--chunked] input_memory_image output_memory_image"
+              << std::endl;
+    return -1;
+  }
+  const char* input_path = argv[argc - 2];
+  const char* output_path = argv[argc - 1];
+
+  // a chunked input is paged in as it is written out, rather than loaded
+  // whole.
+  auto memory_image = reil::MemoryImage::LoadLazy(input_path);
+  if (!memory_image) {
+    std::cerr << "Could not load " << input_path << std::endl;
+    return -1;
+  }
+
+  if (!memory_image->Save(output_path, chunked)) {
+    std::cerr << "Could not save " << output_path << std::endl;
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,46 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "memory_image/mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace reil {
+std::shared_ptr<const uint8_t> MapFile(const std::string& path, size_t* size) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat file_stat;
+  void* address = MAP_FAILED;
+  if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+    *size = file_stat.st_size;
+    address = mmap(nullptr, *size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+
+  if (address == MAP_FAILED) {
+    return nullptr;
+  }
+  return std::shared_ptr<const uint8_t>(
+      static_cast<const uint8_t*>(address),
+      [size = *size](const uint8_t* data) {
+        munmap(const_cast<uint8_t*>(data), size);
+      });
+}
+}  // namespace reil
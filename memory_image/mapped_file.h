@@ -0,0 +1,29 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef REIL_MEMORY_IMAGE_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace reil {
+// maps the whole of the file at path read-only, setting size to its size, or
+// returns nullptr. the file is unmapped when the last reference is dropped.
+std::shared_ptr<const uint8_t> MapFile(const std::string& path, size_t* size);
+}  // namespace reil
+
+#define REIL_MEMORY_IMAGE_MAPPED_FILE_H_
+#endif  // REIL_MEMORY_IMAGE_MAPPED_FILE_H_
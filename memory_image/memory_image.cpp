@@ -14,16 +14,95 @@
 
 #include "memory_image/memory_image.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <utility>
 
 #include "absl/memory/memory.h"
 #include "glog/logging.h"
 
+#include "memory_image/chunked_source.h"
+#include "memory_image/mapped_file.h"
 #include "memory_image/memory_image.pb.h"
 
 namespace reil {
+// the native format is a header, a table of mappings and the architecture
+// name, followed by the data of each mapping at a page aligned offset, so that
+// mapping the file maps each mapping's data onto whole pages. all fields are
+// in host byte order.
+//
+// mappings can instead be stored chunked, as a table of chunks followed by the
+// chunks, each compressed or elided separately (see chunked_source.h); these
+// are decoded a chunk at a time when they are read.
+static const char kFileMagic[8] = {'R', 'E', 'I', 'L', 'M', 'E', 'M', 0};
+static constexpr uint32_t kFileVersion = 1;
+static constexpr uint64_t kFileAlignment = 0x1000;
+
+enum MappingEncoding : uint32_t {
+  kMappingStored = 0,
+  kMappingChunked = 1,
+};
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t mapping_count;
+  uint64_t architecture_name_offset;
+  uint64_t architecture_name_size;
+};
+
+struct FileMapping {
+  uint64_t address;
+  uint64_t offset;
+  uint64_t size;
+  uint32_t permissions;
+  uint32_t encoding;
+};
+
+constexpr uint64_t MemoryImage::kChunkSize;
+constexpr uint64_t MemoryImage::kDefaultResidentLimit;
+
 MemoryImage::MemoryImage(std::string architecture_name)
-    : architecture_name_(architecture_name) {}
+    : architecture_name_(architecture_name),
+      last_index_(0),
+      chunk_cache_(kDefaultResidentLimit) {}
+
+size_t MemoryImage::UpperBound(uint64_t address) const {
+  auto interval_iter = std::upper_bound(
+      intervals_.begin(), intervals_.end(), address,
+      [](uint64_t address, const Interval& interval) {
+        return address < interval.start;
+      });
+  return interval_iter - intervals_.begin();
+}
+
+bool MemoryImage::FindMapping(uint64_t address, size_t* index) const {
+  size_t last_index = last_index_.load(std::memory_order_relaxed);
+  if (last_index < intervals_.size() &&
+      intervals_[last_index].start <= address &&
+      address < intervals_[last_index].end) {
+    *index = last_index;
+    return true;
+  }
+
+  // the mapping containing address can only be the last one starting at or
+  // before it.
+  size_t next_index = UpperBound(address);
+  if (next_index == 0 || address >= intervals_[next_index - 1].end) {
+    return false;
+  }
+
+  *index = next_index - 1;
+  last_index_.store(*index, std::memory_order_relaxed);
+  return true;
+}
 
 bool MemoryImage::readable(uint64_t address, uint64_t size) const {
   return AccessOk(address, size, true, false, false);
@@ -39,77 +118,489 @@ bool MemoryImage::executable(uint64_t address, uint64_t size) const {
 
 bool MemoryImage::AccessOk(uint64_t address, uint64_t size, bool read,
                            bool write, bool execute) const {
-  bool found = false;
-  bool readable = read;
-  bool writable = write;
-  bool executable = execute;
-  for (const auto& mapping : mappings()) {
-    if (mapping.address <= address &&
-        address + size <= mapping.address + mapping.data.size()) {
-      found = true;
-      readable &= mapping.readable;
-      writable &= mapping.writable;
-      executable &= mapping.executable;
+  size_t index;
+  if (!FindMapping(address, &index) ||
+      intervals_[index].end - address < size) {
+    return false;
+  }
+
+  uint8_t permissions = intervals_[index].permissions;
+  return (!read || (permissions & kReadable)) &&
+         (!write || (permissions & kWritable)) &&
+         (!execute || (permissions & kExecutable));
+}
+
+absl::Span<const uint8_t> MemoryImage::Read(uint64_t address) const {
+  size_t index;
+  if (!FindMapping(address, &index)) {
+    return absl::Span<const uint8_t>();
+  }
+
+  const Mapping& mapping = mappings_[index];
+  uint64_t offset = address - mapping.address;
+  if (mapping.source) {
+    return ReadSource(mapping, offset);
+  }
+  return absl::Span<const uint8_t>(&mapping.data[offset],
+                                   mapping.data.size() - offset);
+}
+
+bool MemoryImage::Read(uint64_t address, uint8_t* data, uint64_t size) const {
+  while (size != 0) {
+    absl::Span<const uint8_t> bytes = Read(address);
+    if (bytes.empty()) {
+      return false;
     }
+    size_t read_size = std::min<uint64_t>(bytes.size(), size);
+    memcpy(data, bytes.data(), read_size);
+    data += read_size;
+    address += read_size;
+    size -= read_size;
   }
+  return true;
+}
 
-  if (found) {
-    return (read == readable) && (write == writable) && (execute == executable);
+absl::Span<const uint8_t> MemoryImage::ReadSource(const Mapping& mapping,
+                                                  uint64_t offset) const {
+  // chunks are cached by address, which is unique since mappings can't
+  // overlap.
+  uint64_t chunk_offset = offset & ~(kChunkSize - 1);
+  uint64_t chunk_address = mapping.address + chunk_offset;
+  ChunkCache::Chunk chunk = chunk_cache_.Find(chunk_address);
+  if (!chunk) {
+    auto data = std::make_shared<std::vector<uint8_t>>(
+        std::min(kChunkSize, mapping.size() - chunk_offset));
+    if (!mapping.source->Read(chunk_offset, data->data(), data->size())) {
+      LOG(ERROR) << "could not read mapping at 0x" << std::hex
+                 << mapping.address << " offset 0x" << chunk_offset;
+      return absl::Span<const uint8_t>();
+    }
+    chunk = chunk_cache_.Insert(chunk_address, std::move(data));
   }
 
-  return false;
+  {
+    std::lock_guard<std::mutex> lock(last_chunks_mutex_);
+    last_chunks_[std::this_thread::get_id()] = chunk;
+  }
+  return absl::Span<const uint8_t>(&(*chunk)[offset - chunk_offset],
+                                   chunk->size() - (offset - chunk_offset));
 }
 
-absl::Span<const uint8_t> MemoryImage::Read(uint64_t address) const {
-  absl::Span<const uint8_t> result;
-  for (auto& mapping : mappings_) {
-    if (mapping.address <= address) {
-      uint64_t offset = address - mapping.address;
-      if (offset < mapping.data.size()) {
-        result = absl::Span<const uint8_t>(&mapping.data[offset],
-                                           mapping.data.size() - offset);
+bool MemoryImage::Overlaps(uint64_t address, uint64_t size) const {
+  size_t next_index = UpperBound(address);
+  if (next_index < intervals_.size() &&
+      intervals_[next_index].start - address < size) {
+    return true;
+  }
+  return next_index != 0 && address < intervals_[next_index - 1].end;
+}
+
+void MemoryImage::AddMapping(uint64_t address, std::vector<uint8_t> data,
+                             bool readable, bool writable, bool executable) {
+  auto storage = std::make_shared<const std::vector<uint8_t>>(std::move(data));
+  AddMapping(
+      Mapping({address, *storage, readable, writable, executable, nullptr}));
+  storage_.push_back(std::move(storage));
+}
+
+void MemoryImage::AddMapping(uint64_t address,
+                             std::shared_ptr<const MappingSource> source,
+                             bool readable, bool writable, bool executable) {
+  AddMapping(Mapping({address, absl::Span<const uint8_t>(), readable, writable,
+                      executable, std::move(source)}));
+}
+
+void MemoryImage::AddMapping(const Mapping& mapping) {
+  CHECK(!Overlaps(mapping.address, mapping.size()))
+      << "overlapping mapping at 0x" << std::hex << mapping.address;
+
+  Interval interval;
+  interval.start = mapping.address;
+  interval.end = mapping.address + mapping.size();
+  interval.permissions = (mapping.readable ? kReadable : 0) |
+                         (mapping.writable ? kWritable : 0) |
+                         (mapping.executable ? kExecutable : 0);
+
+  size_t index = UpperBound(interval.start);
+  intervals_.insert(intervals_.begin() + index, interval);
+  mappings_.insert(mappings_.begin() + index, mapping);
+}
+
+const std::vector<Mapping>& MemoryImage::mappings() const { return mappings_; }
+
+uint64_t MemoryImage::resident_size() const { return chunk_cache_.size(); }
+
+void MemoryImage::set_resident_limit(uint64_t limit) {
+  chunk_cache_.set_limit(limit);
+}
+
+// an open file, closed when the last reference to it is dropped.
+struct File {
+  int fd;
+
+  explicit File(int fd) : fd(fd) {}
+  ~File() { close(fd); }
+};
+
+// reads the data of a mapping from its offset in a native format file.
+class FileSource : public MappingSource {
+  std::shared_ptr<const File> file_;
+  uint64_t offset_;
+  uint64_t size_;
+
+ public:
+  FileSource(std::shared_ptr<const File> file, uint64_t offset, uint64_t size)
+      : file_(std::move(file)), offset_(offset), size_(size) {}
+
+  uint64_t size() const override { return size_; }
+
+  bool Read(uint64_t offset, uint8_t* data, size_t size) const override {
+    offset += offset_;
+    while (size != 0) {
+      ssize_t read_size = pread(file_->fd, data, size, offset);
+      if (read_size <= 0) {
+        if (read_size < 0 && errno == EINTR) {
+          continue;
+        }
+        return false;
       }
+      data += read_size;
+      offset += read_size;
+      size -= read_size;
     }
+    return true;
+  }
+};
+
+// reads from a file mapped into memory.
+class MappedFileSource : public MappingSource {
+  std::shared_ptr<const uint8_t> data_;
+  uint64_t size_;
+
+ public:
+  MappedFileSource(std::shared_ptr<const uint8_t> data, uint64_t size)
+      : data_(std::move(data)), size_(size) {}
+
+  uint64_t size() const override { return size_; }
+
+  bool Read(uint64_t offset, uint8_t* data, size_t size) const override {
+    memcpy(data, &data_.get()[offset], size);
+    return true;
   }
-  return result;
+};
+
+static bool InFile(uint64_t offset, uint64_t size, uint64_t file_size) {
+  return offset <= file_size && size <= file_size - offset;
 }
 
-void MemoryImage::AddMapping(const Mapping& mapping) {
-  mappings_.push_back(mapping);
+// reads and checks the header and mapping table of a native format file.
+static bool ReadFileTable(const std::string& path, const MappingSource& file,
+                          std::string* architecture_name,
+                          std::vector<FileMapping>* file_mappings) {
+  uint64_t file_size = file.size();
+  FileHeader header;
+  if (file_size < sizeof(header) ||
+      !file.Read(0, reinterpret_cast<uint8_t*>(&header), sizeof(header)) ||
+      memcmp(header.magic, kFileMagic, sizeof(kFileMagic)) != 0 ||
+      header.version != kFileVersion ||
+      !InFile(sizeof(header),
+              static_cast<uint64_t>(header.mapping_count) * sizeof(FileMapping),
+              file_size) ||
+      !InFile(header.architecture_name_offset, header.architecture_name_size,
+              file_size)) {
+    LOG(ERROR) << "invalid header in " << path;
+    return false;
+  }
+
+  architecture_name->resize(header.architecture_name_size);
+  file_mappings->resize(header.mapping_count);
+  if (!file.Read(header.architecture_name_offset,
+                 reinterpret_cast<uint8_t*>(&(*architecture_name)[0]),
+                 architecture_name->size()) ||
+      !file.Read(sizeof(header),
+                 reinterpret_cast<uint8_t*>(file_mappings->data()),
+                 file_mappings->size() * sizeof(FileMapping))) {
+    LOG(ERROR) << "could not read " << path;
+    return false;
+  }
+
+  std::sort(file_mappings->begin(), file_mappings->end(),
+            [](const FileMapping& lhs, const FileMapping& rhs) {
+              return lhs.address < rhs.address;
+            });
+  uint64_t end = 0;
+  for (const auto& file_mapping : *file_mappings) {
+    // the chunk tables of chunked mappings are checked when they're read.
+    if (file_mapping.encoding > kMappingChunked ||
+        (file_mapping.encoding == kMappingStored &&
+         !InFile(file_mapping.offset, file_mapping.size, file_size)) ||
+        file_mapping.address + file_mapping.size < file_mapping.address) {
+      LOG(ERROR) << "invalid mapping at 0x" << std::hex << file_mapping.address
+                 << " in " << path;
+      return false;
+    }
+    if (file_mapping.address < end) {
+      LOG(ERROR) << "overlapping mapping at 0x" << std::hex
+                 << file_mapping.address << " in " << path;
+      return false;
+    }
+    end = file_mapping.address + file_mapping.size;
+  }
+  return true;
 }
 
-void MemoryImage::AddMapping(Mapping&& mapping) {
-  mappings_.emplace_back(std::move(mapping));
+std::unique_ptr<MemoryImage> MemoryImage::LoadNative(
+    const std::string& path, std::shared_ptr<const uint8_t> file,
+    size_t file_size) {
+  const uint8_t* data = file.get();
+  auto file_source = std::make_shared<MappedFileSource>(file, file_size);
+  std::string architecture_name;
+  std::vector<FileMapping> file_mappings;
+  if (!ReadFileTable(path, *file_source, &architecture_name,
+                     &file_mappings)) {
+    return nullptr;
+  }
+
+  auto memory_image = absl::make_unique<MemoryImage>(architecture_name);
+  for (const auto& file_mapping : file_mappings) {
+    bool readable = (file_mapping.permissions & kReadable) != 0;
+    bool writable = (file_mapping.permissions & kWritable) != 0;
+    bool executable = (file_mapping.permissions & kExecutable) != 0;
+    if (file_mapping.encoding == kMappingStored) {
+      memory_image->AddMapping(Mapping({
+          file_mapping.address,
+          absl::Span<const uint8_t>(&data[file_mapping.offset],
+                                    file_mapping.size),
+          readable,
+          writable,
+          executable,
+          nullptr,
+      }));
+      continue;
+    }
+
+    auto source = ChunkedSource::Create(file_source, file_mapping.offset,
+                                        file_mapping.size);
+    if (!source) {
+      LOG(ERROR) << "invalid chunks for mapping at 0x" << std::hex
+                 << file_mapping.address << " in " << path;
+      return nullptr;
+    }
+    memory_image->AddMapping(file_mapping.address, std::move(source),
+                             readable, writable, executable);
+  }
+  memory_image->storage_.push_back(std::move(file));
+  return memory_image;
 }
 
-const std::vector<Mapping>& MemoryImage::mappings() const { return mappings_; }
+std::unique_ptr<MemoryImage> MemoryImage::LoadLazy(std::string path,
+                                                   uint64_t resident_limit) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  auto file = std::make_shared<const File>(fd);
+
+  struct stat file_stat;
+  char magic[sizeof(kFileMagic)];
+  if (fstat(fd, &file_stat) != 0 ||
+      pread(fd, magic, sizeof(magic), 0) != sizeof(magic) ||
+      memcmp(magic, kFileMagic, sizeof(kFileMagic)) != 0) {
+    auto memory_image = Load(path);
+    if (memory_image) {
+      memory_image->set_resident_limit(resident_limit);
+    }
+    return memory_image;
+  }
+
+  auto file_source = std::make_shared<FileSource>(file, 0, file_stat.st_size);
+  std::string architecture_name;
+  std::vector<FileMapping> file_mappings;
+  if (!ReadFileTable(path, *file_source, &architecture_name,
+                     &file_mappings)) {
+    return nullptr;
+  }
+
+  auto memory_image = absl::make_unique<MemoryImage>(architecture_name);
+  memory_image->set_resident_limit(resident_limit);
+  for (const auto& file_mapping : file_mappings) {
+    std::shared_ptr<const MappingSource> source;
+    if (file_mapping.encoding == kMappingStored) {
+      source = std::make_shared<FileSource>(file, file_mapping.offset,
+                                            file_mapping.size);
+    } else {
+      source = ChunkedSource::Create(file_source, file_mapping.offset,
+                                     file_mapping.size);
+      if (!source) {
+        LOG(ERROR) << "invalid chunks for mapping at 0x" << std::hex
+                   << file_mapping.address << " in " << path;
+        return nullptr;
+      }
+    }
+
+    memory_image->AddMapping(file_mapping.address, std::move(source),
+                             (file_mapping.permissions & kReadable) != 0,
+                             (file_mapping.permissions & kWritable) != 0,
+                             (file_mapping.permissions & kExecutable) != 0);
+  }
+  return memory_image;
+}
 
 std::unique_ptr<MemoryImage> MemoryImage::Load(std::string path) {
+  size_t file_size = 0;
+  auto file = MapFile(path, &file_size);
+  if (file && file_size >= sizeof(FileHeader) &&
+      memcmp(file.get(), kFileMagic, sizeof(kFileMagic)) == 0) {
+    return LoadNative(path, std::move(file), file_size);
+  }
+  file = nullptr;
+
   GOOGLE_PROTOBUF_VERIFY_VERSION;
 
   std::unique_ptr<MemoryImage> memory_image = nullptr;
-  proto::MemoryImage proto_memory_image;
+  auto proto_memory_image = std::make_shared<proto::MemoryImage>();
 
   std::fstream input(path, std::ios::in | std::ios::binary);
-  if (input && proto_memory_image.ParseFromIstream(&input)) {
+  if (input && proto_memory_image->ParseFromIstream(&input)) {
     memory_image = absl::make_unique<MemoryImage>(
-        proto_memory_image.architecture_name().data());
-    for (int i = 0; i < proto_memory_image.mappings_size(); ++i) {
+        proto_memory_image->architecture_name().data());
+    for (int i = 0; i < proto_memory_image->mappings_size(); ++i) {
       const proto::MemoryImage::Mapping& proto_mapping =
-          proto_memory_image.mappings(i);
+          proto_memory_image->mappings(i);
+      if (memory_image->Overlaps(proto_mapping.address(),
+                                 proto_mapping.data().size())) {
+        LOG(ERROR) << "overlapping mapping at 0x" << std::hex
+                   << proto_mapping.address() << " in " << path;
+        return nullptr;
+      }
 
-      Mapping mapping({
+      // the mapping data is left in the parsed proto, which the image keeps.
+      memory_image->AddMapping(Mapping({
           proto_mapping.address(),
-          std::vector<uint8_t>(proto_mapping.data().begin(),
-                               proto_mapping.data().end()),
+          absl::Span<const uint8_t>(
+              reinterpret_cast<const uint8_t*>(proto_mapping.data().data()),
+              proto_mapping.data().size()),
           proto_mapping.readable(),
           proto_mapping.writable(),
           proto_mapping.executable(),
-      });
-
-      memory_image->AddMapping(std::move(mapping));
+          nullptr,
+      }));
     }
+    memory_image->storage_.push_back(std::move(proto_memory_image));
   }
   return memory_image;
 }
+
+bool MemoryImage::Write(std::ostream* output, bool chunked) const {
+  FileHeader header;
+  memcpy(header.magic, kFileMagic, sizeof(kFileMagic));
+  header.version = kFileVersion;
+  header.mapping_count = mappings_.size();
+  header.architecture_name_offset =
+      sizeof(header) + mappings_.size() * sizeof(FileMapping);
+  header.architecture_name_size = architecture_name_.size();
+
+  // the mapping table (and the chunk table of each chunked mapping) is written
+  // once the offsets in it are known.
+  std::vector<FileMapping> file_mappings(mappings_.size());
+  output->write(reinterpret_cast<const char*>(&header), sizeof(header));
+  output->write(reinterpret_cast<const char*>(file_mappings.data()),
+               file_mappings.size() * sizeof(FileMapping));
+  *output << architecture_name_;
+  uint64_t offset =
+      header.architecture_name_offset + header.architecture_name_size;
+
+  std::vector<uint8_t> buffer;
+  std::vector<uint8_t> encoded;
+  for (size_t i = 0; i < mappings_.size(); ++i) {
+    const Mapping& mapping = mappings_[i];
+    uint64_t size = mapping.size();
+    uint64_t aligned_offset =
+        (offset + kFileAlignment - 1) & ~(kFileAlignment - 1);
+    *output << std::string(aligned_offset - offset, '\0');
+    offset = aligned_offset;
+
+    FileMapping& file_mapping = file_mappings[i];
+    file_mapping.address = mapping.address;
+    file_mapping.offset = offset;
+    file_mapping.size = size;
+    file_mapping.permissions = (mapping.readable ? kReadable : 0) |
+                               (mapping.writable ? kWritable : 0) |
+                               (mapping.executable ? kExecutable : 0);
+    file_mapping.encoding = chunked ? kMappingChunked : kMappingStored;
+
+    std::vector<FileChunk> chunks;
+    if (chunked) {
+      chunks.resize((size + kChunkSize - 1) / kChunkSize);
+      output->write(reinterpret_cast<const char*>(chunks.data()),
+                   chunks.size() * sizeof(FileChunk));
+      offset += chunks.size() * sizeof(FileChunk);
+    }
+
+    for (uint64_t chunk_offset = 0; chunk_offset < size;
+         chunk_offset += kChunkSize) {
+      size_t chunk_size = std::min(kChunkSize, size - chunk_offset);
+      absl::Span<const uint8_t> chunk;
+      if (mapping.source) {
+        // copy mappings paged in on demand straight from their source, rather
+        // than through the cache.
+        buffer.resize(chunk_size);
+        if (!mapping.source->Read(chunk_offset, buffer.data(), chunk_size)) {
+          LOG(ERROR) << "could not read mapping at 0x" << std::hex
+                     << mapping.address << " offset 0x" << chunk_offset;
+          return false;
+        }
+        chunk = buffer;
+      } else {
+        chunk = mapping.data.subspan(chunk_offset, chunk_size);
+      }
+
+      if (chunked) {
+        FileChunk& file_chunk = chunks[chunk_offset / kChunkSize];
+        file_chunk.encoding = EncodeChunk(chunk, &encoded);
+        file_chunk.offset = offset;
+        file_chunk.size = encoded.size();
+        chunk = encoded;
+      }
+      output->write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+      offset += chunk.size();
+    }
+
+    if (chunked) {
+      output->seekp(file_mapping.offset);
+      output->write(reinterpret_cast<const char*>(chunks.data()),
+                   chunks.size() * sizeof(FileChunk));
+      output->seekp(offset);
+    }
+  }
+
+  output->seekp(sizeof(header));
+  output->write(reinterpret_cast<const char*>(file_mappings.data()),
+               file_mappings.size() * sizeof(FileMapping));
+  return static_cast<bool>(*output);
+}
+
+bool MemoryImage::Save(std::string path, bool chunked) const {
+  // the image may be backed by the file at path, so the new file replaces it
+  // in a single step once it has been written.
+  std::string temporary_path = path + ".tmp";
+  {
+    std::fstream output(temporary_path,
+                        std::ios::out | std::ios::trunc | std::ios::binary);
+    bool written = Write(&output, chunked);
+    output.close();
+    if (!written || !output) {
+      LOG(ERROR) << "could not write memory image " << temporary_path;
+      unlink(temporary_path.c_str());
+      return false;
+    }
+  }
+
+  if (rename(temporary_path.c_str(), path.c_str()) != 0) {
+    LOG(ERROR) << "could not replace memory image " << path;
+    unlink(temporary_path.c_str());
+    return false;
+  }
+  return true;
+}
 }  // namespace reil
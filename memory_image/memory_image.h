@@ -14,25 +14,109 @@
 
 #ifndef REIL_MEMORY_IMAGE_MEMORY_IMAGE_H_
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <ostream>
 #include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "absl/types/span.h"
 
+#include "memory_image/chunk_cache.h"
+
 namespace reil {
+// Supplies the data of a mapping that is paged in on demand. Sources may be
+// read from several threads at once.
+class MappingSource {
+ public:
+  virtual ~MappingSource() = default;
+
+  virtual uint64_t size() const = 0;
+  // reads size bytes at offset into the mapping.
+  virtual bool Read(uint64_t offset, uint8_t* data, size_t size) const = 0;
+};
+
+// the data of a mapping is a view of storage held by the MemoryImage (or, for
+// mappings added by reference, by the caller). mappings paged in on demand
+// have a source instead, and no data.
 struct Mapping {
   uint64_t address;
-  std::vector<uint8_t> data;
+  absl::Span<const uint8_t> data;
   bool readable;
   bool writable;
   bool executable;
+  std::shared_ptr<const MappingSource> source;
+
+  uint64_t size() const { return source ? source->size() : data.size(); }
 };
 
+// A snapshot of the memory of a process.
+//
+// Mappings are kept sorted by address and may not overlap. Lookups binary
+// search a compact index of the mapping bounds and permissions, and check the
+// mapping found by the previous lookup first, since consecutive lookups are
+// usually in the same mapping.
+//
+// Images are stored either as a memory_image.proto, or in a native format that
+// is mapped into memory and used in place, so that loading it doesn't copy the
+// mapping data and its pages are shared with the page cache (and so with any
+// other process using the same image).
+//
+// Alternatively, mappings can be paged in a chunk at a time when they are
+// first read, from a MappingSource (such as a chunked, compressed mapping in
+// the native format); the chunks are kept in a cache that is
+// bounded by the number of resident bytes, so that images larger than memory
+// can be used.
 class MemoryImage {
+ public:
+  static constexpr uint64_t kChunkSize = 0x10000;
+  static constexpr uint64_t kDefaultResidentLimit = 0x10000000;
+
+ private:
+  enum Permissions : uint8_t {
+    kReadable = 1,
+    kWritable = 1 << 1,
+    kExecutable = 1 << 2,
+  };
+
+  struct Interval {
+    uint64_t start;
+    uint64_t end;
+    uint8_t permissions;
+  };
+
   std::vector<Mapping> mappings_;
+  std::vector<Interval> intervals_;
   std::string architecture_name_;
 
+  // keeps alive the storage that mapping data points into.
+  std::vector<std::shared_ptr<const void>> storage_;
+
+  mutable std::atomic<size_t> last_index_;
+  mutable ChunkCache chunk_cache_;
+  // the chunk last read by each thread, which is kept alive for it until its
+  // next read, since other reads may evict the chunk from the cache.
+  mutable std::mutex last_chunks_mutex_;
+  mutable std::unordered_map<std::thread::id, ChunkCache::Chunk> last_chunks_;
+
+  // returns the index of the first mapping starting after address.
+  size_t UpperBound(uint64_t address) const;
+  // finds the index of the mapping containing address, if there is one.
+  bool FindMapping(uint64_t address, size_t* index) const;
+  absl::Span<const uint8_t> ReadSource(const Mapping& mapping,
+                                       uint64_t offset) const;
+
+  // writes the image to output in the native format.
+  bool Write(std::ostream* output, bool chunked) const;
+
+  static std::unique_ptr<MemoryImage> LoadNative(
+      const std::string& path, std::shared_ptr<const uint8_t> file,
+      size_t file_size);
+
  public:
   MemoryImage(std::string architecture_name);
 
@@ -44,13 +128,42 @@ class MemoryImage {
 
   bool AccessOk(uint64_t address, uint64_t size, bool read, bool write,
                 bool execute) const;
+  // returns the data from address to the end of its mapping or, for a mapping
+  // paged in on demand, to the end of its chunk. the data of such a chunk is
+  // only guaranteed to remain valid until the calling thread's next Read from
+  // the image.
   absl::Span<const uint8_t> Read(uint64_t address) const;
+  // copies the size bytes at address into data, which may span chunks (and
+  // adjacent mappings), and returns false if any of them aren't mapped.
+  bool Read(uint64_t address, uint8_t* data, uint64_t size) const;
 
+  // mappings must not overlap any mapping already in the image.
+  bool Overlaps(uint64_t address, uint64_t size) const;
+  // adds a mapping by reference; its data must outlive the image.
   void AddMapping(const Mapping& mapping);
-  void AddMapping(Mapping&& mapping);
+  // adds a mapping of data owned by the image.
+  void AddMapping(uint64_t address, std::vector<uint8_t> data, bool readable,
+                  bool writable, bool executable);
+  // adds a mapping that is paged in from source on demand.
+  void AddMapping(uint64_t address,
+                  std::shared_ptr<const MappingSource> source, bool readable,
+                  bool writable, bool executable);
   const std::vector<Mapping>& mappings() const;
 
+  // the number of bytes paged in on demand that are resident, and the limit
+  // on them.
+  uint64_t resident_size() const;
+  void set_resident_limit(uint64_t limit);
+
+  // loads an image in either format.
   static std::unique_ptr<MemoryImage> Load(std::string path);
+  // loads an image in the native format with its mappings paged in from the
+  // file on demand; images in other formats are loaded in full.
+  static std::unique_ptr<MemoryImage> LoadLazy(
+      std::string path, uint64_t resident_limit = kDefaultResidentLimit);
+  // saves the image in the native format, optionally with the mappings
+  // chunked, so that zero chunks are elided and the rest compressed.
+  bool Save(std::string path, bool chunked = false) const;
 };
 }  // namespace reil
 
@@ -0,0 +1,352 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "memory_image/memory_image.h"
+
+namespace reil {
+namespace test {
+
+static void AddMapping(MemoryImage* memory_image, uint64_t address,
+                       size_t size, uint8_t fill, bool writable,
+                       bool executable) {
+  memory_image->AddMapping(address, std::vector<uint8_t>(size, fill), true,
+                           writable, executable);
+}
+
+// a source of counting bytes, which records the number of reads from it.
+class CountingSource : public MappingSource {
+  uint64_t size_;
+
+ public:
+  mutable int read_count = 0;
+
+  explicit CountingSource(uint64_t size) : size_(size) {}
+
+  uint64_t size() const override { return size_; }
+
+  bool Read(uint64_t offset, uint8_t* data, size_t size) const override {
+    ++read_count;
+    for (size_t i = 0; i < size; ++i) {
+      data[i] = offset + i;
+    }
+    return true;
+  }
+};
+
+TEST(MemoryImage, Lookup) {
+  MemoryImage memory_image("aarch64");
+  AddMapping(&memory_image, 0x3000, 0x1000, 3, true, false);
+  AddMapping(&memory_image, 0x1000, 0x1000, 1, false, true);
+  AddMapping(&memory_image, 0x2000, 0x800, 2, false, false);
+
+  // mappings are kept in address order.
+  ASSERT_EQ(memory_image.mappings().size(), 3);
+  ASSERT_EQ(memory_image.mappings()[0].address, 0x1000);
+  ASSERT_EQ(memory_image.mappings()[1].address, 0x2000);
+  ASSERT_EQ(memory_image.mappings()[2].address, 0x3000);
+
+  ASSERT_TRUE(memory_image.Read(0xfff).empty());
+  ASSERT_EQ(memory_image.Read(0x1000).size(), 0x1000);
+  ASSERT_EQ(memory_image.Read(0x1fff).size(), 1);
+  ASSERT_EQ(memory_image.Read(0x1fff)[0], 1);
+  ASSERT_EQ(memory_image.Read(0x2004).size(), 0x7fc);
+  ASSERT_EQ(memory_image.Read(0x2004)[0], 2);
+  ASSERT_TRUE(memory_image.Read(0x2800).empty());
+  ASSERT_EQ(memory_image.Read(0x3000)[0], 3);
+  ASSERT_TRUE(memory_image.Read(0x4000).empty());
+
+  ASSERT_TRUE(memory_image.executable(0x1000, 0x1000));
+  ASSERT_FALSE(memory_image.executable(0x1000, 0x1001));
+  ASSERT_FALSE(memory_image.writable(0x1800));
+  ASSERT_TRUE(memory_image.readable(0x2000, 0x800));
+  ASSERT_FALSE(memory_image.readable(0x2800));
+  ASSERT_FALSE(memory_image.executable(0x2000));
+  ASSERT_TRUE(memory_image.writable(0x3ffc, 4));
+  ASSERT_TRUE(memory_image.AccessOk(0x3000, 8, true, true, false));
+  ASSERT_FALSE(memory_image.AccessOk(0x3000, 8, true, true, true));
+
+  // a range can't span two mappings, even if they are adjacent.
+  ASSERT_FALSE(memory_image.readable(0x1ffc, 8));
+}
+
+TEST(MemoryImage, Overlaps) {
+  MemoryImage memory_image("aarch64");
+  AddMapping(&memory_image, 0x2000, 0x1000, 0, false, false);
+
+  ASSERT_FALSE(memory_image.Overlaps(0x1000, 0x1000));
+  ASSERT_TRUE(memory_image.Overlaps(0x1000, 0x1001));
+  ASSERT_TRUE(memory_image.Overlaps(0x2800, 0x10));
+  ASSERT_TRUE(memory_image.Overlaps(0x2fff, 0x10));
+  ASSERT_FALSE(memory_image.Overlaps(0x3000, 0x10));
+}
+
+TEST(MemoryImage, ManyMappings) {
+  MemoryImage memory_image("aarch64");
+  for (uint64_t i = 0; i < 0x1000; ++i) {
+    // add the mappings out of order, with gaps between them.
+    uint64_t index = (i * 0x9e5) % 0x1000;
+    AddMapping(&memory_image, index * 0x2000, 0x1000, index & 0xff, index & 1,
+               false);
+  }
+
+  for (uint64_t index = 0; index < 0x1000; ++index) {
+    uint64_t address = index * 0x2000;
+    ASSERT_EQ(memory_image.Read(address + 0x10)[0], index & 0xff);
+    ASSERT_EQ(memory_image.writable(address, 0x1000), (bool)(index & 1));
+    ASSERT_TRUE(memory_image.Read(address + 0x1000).empty());
+  }
+}
+
+TEST(MemoryImage, SaveLoad) {
+  MemoryImage memory_image("aarch64");
+  AddMapping(&memory_image, 0x1000, 0x1000, 1, false, true);
+  AddMapping(&memory_image, 0x4000, 0x123, 2, true, false);
+  // a mapping by reference, of data not owned by the image.
+  std::vector<uint8_t> data(0x10);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = i;
+  }
+  memory_image.AddMapping(Mapping({0x8000, data, true, false, false, nullptr}));
+
+  std::string path = ::testing::TempDir() + "/memory_image_test.mem";
+  ASSERT_TRUE(memory_image.Save(path));
+  auto loaded = MemoryImage::Load(path);
+  ASSERT_NE(loaded, nullptr);
+  ASSERT_EQ(loaded->architecture_name(), "aarch64");
+  ASSERT_EQ(loaded->mappings().size(), 3);
+  for (size_t i = 0; i < 3; ++i) {
+    const Mapping& expected = memory_image.mappings()[i];
+    const Mapping& mapping = loaded->mappings()[i];
+    ASSERT_EQ(mapping.address, expected.address);
+    ASSERT_EQ(mapping.data, expected.data);
+    ASSERT_EQ(mapping.readable, expected.readable);
+    ASSERT_EQ(mapping.writable, expected.writable);
+    ASSERT_EQ(mapping.executable, expected.executable);
+    // the data is used in place, at a page aligned offset in the file.
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(mapping.data.data()) & 0xfff, 0);
+  }
+  ASSERT_EQ(loaded->Read(0x8004)[0], 4);
+  ASSERT_TRUE(loaded->executable(0x1000, 0x1000));
+  ASSERT_FALSE(loaded->readable(0x4123));
+}
+
+TEST(MemoryImage, Lazy) {
+  const uint64_t kChunkSize = MemoryImage::kChunkSize;
+
+  MemoryImage memory_image("aarch64");
+  auto source = std::make_shared<CountingSource>(kChunkSize * 4 + 0x10);
+  memory_image.AddMapping(0x100000, source, true, false, true);
+  memory_image.set_resident_limit(kChunkSize * 2);
+
+  // nothing is read until it is needed.
+  ASSERT_EQ(memory_image.mappings()[0].size(), kChunkSize * 4 + 0x10);
+  ASSERT_TRUE(memory_image.executable(0x100000, kChunkSize * 4 + 0x10));
+  ASSERT_EQ(source->read_count, 0);
+  ASSERT_EQ(memory_image.resident_size(), 0);
+
+  // reads return the rest of the chunk.
+  auto bytes = memory_image.Read(0x100004);
+  ASSERT_EQ(bytes.size(), kChunkSize - 4);
+  ASSERT_EQ(bytes[0], 4);
+  ASSERT_EQ(memory_image.Read(0x100000 + kChunkSize * 4 + 0xf).size(), 1);
+  ASSERT_EQ(memory_image.Read(0x100000 + kChunkSize * 4 + 0xf)[0], 0xf);
+  ASSERT_EQ(source->read_count, 2);
+  ASSERT_EQ(memory_image.resident_size(), kChunkSize + 0x10);
+
+  // cached chunks aren't read again.
+  ASSERT_EQ(memory_image.Read(0x100100)[0], 0);
+  ASSERT_EQ(source->read_count, 2);
+
+  // reading more than the limit evicts the least recently used chunks.
+  ASSERT_EQ(memory_image.Read(0x100000 + kChunkSize)[0], 0);
+  ASSERT_EQ(memory_image.Read(0x100000 + kChunkSize * 2)[0], 0);
+  ASSERT_EQ(source->read_count, 4);
+  ASSERT_EQ(memory_image.resident_size(), kChunkSize * 2);
+  ASSERT_EQ(memory_image.Read(0x100000)[1], 1);
+  ASSERT_EQ(source->read_count, 5);
+}
+
+TEST(MemoryImage, ReadAcrossChunks) {
+  const uint64_t kChunkSize = MemoryImage::kChunkSize;
+
+  MemoryImage memory_image("aarch64");
+  memory_image.AddMapping(
+      0x100000, std::make_shared<CountingSource>(kChunkSize * 2), true, true,
+      false);
+  AddMapping(&memory_image, 0x100000 + kChunkSize * 2, 0x10, 0xaa, true,
+             false);
+
+  // a load straddling a chunk boundary is copied from both chunks.
+  uint64_t address = 0x100000 + kChunkSize - 4;
+  ASSERT_EQ(memory_image.Read(address).size(), 4);
+  uint8_t bytes[8];
+  ASSERT_TRUE(memory_image.Read(address, bytes, sizeof(bytes)));
+  for (size_t i = 0; i < sizeof(bytes); ++i) {
+    ASSERT_EQ(bytes[i], static_cast<uint8_t>(kChunkSize - 4 + i));
+  }
+
+  // and one straddling adjacent mappings from both mappings.
+  address = 0x100000 + kChunkSize * 2 - 4;
+  ASSERT_TRUE(memory_image.Read(address, bytes, sizeof(bytes)));
+  ASSERT_EQ(bytes[3], 0xff);
+  ASSERT_EQ(bytes[4], 0xaa);
+
+  // but not past the end of the mapped memory.
+  address = 0x100000 + kChunkSize * 2 + 0xc;
+  ASSERT_FALSE(memory_image.Read(address, bytes, sizeof(bytes)));
+}
+
+TEST(MemoryImage, LastChunkPerImage) {
+  const uint64_t kChunkSize = MemoryImage::kChunkSize;
+
+  MemoryImage memory_image("aarch64");
+  memory_image.AddMapping(
+      0x100000, std::make_shared<CountingSource>(kChunkSize * 2), true, false,
+      false);
+  memory_image.set_resident_limit(kChunkSize);
+  MemoryImage other_image("aarch64");
+  other_image.AddMapping(0x100000, std::make_shared<CountingSource>(kChunkSize),
+                         true, false, false);
+
+  // reads from another image don't release the chunk this thread last read,
+  // so it survives being evicted by a read from another thread.
+  auto bytes = memory_image.Read(0x100010);
+  ASSERT_EQ(other_image.Read(0x100020)[0], 0x20);
+  std::thread([&memory_image, kChunkSize]() {
+    memory_image.Read(0x100000 + kChunkSize);
+  }).join();
+  ASSERT_EQ(memory_image.resident_size(), kChunkSize);
+  ASSERT_EQ(bytes[0], 0x10);
+  ASSERT_EQ(bytes[0x10], 0x20);
+}
+
+TEST(MemoryImage, LoadLazy) {
+  MemoryImage memory_image("aarch64");
+  std::vector<uint8_t> data(MemoryImage::kChunkSize * 3);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = i * 7;
+  }
+  memory_image.AddMapping(0x10000, data, true, true, false);
+  AddMapping(&memory_image, 0x1000, 0x800, 1, false, true);
+
+  std::string path = ::testing::TempDir() + "/memory_image_test_lazy.mem";
+  ASSERT_TRUE(memory_image.Save(path));
+  auto loaded = MemoryImage::LoadLazy(path, MemoryImage::kChunkSize);
+  ASSERT_NE(loaded, nullptr);
+  ASSERT_EQ(loaded->mappings().size(), 2);
+  ASSERT_TRUE(loaded->mappings()[1].data.empty());
+  ASSERT_EQ(loaded->mappings()[1].size(), data.size());
+  ASSERT_TRUE(loaded->writable(0x10000, data.size()));
+  ASSERT_TRUE(loaded->executable(0x1000, 0x800));
+
+  for (size_t i = 0; i < data.size(); i += 0x1001) {
+    ASSERT_EQ(loaded->Read(0x10000 + i)[0], data[i]);
+    ASSERT_LE(loaded->resident_size(), MemoryImage::kChunkSize);
+  }
+  ASSERT_EQ(loaded->Read(0x17ff)[0], 1);
+
+  // saving a lazily loaded image reads it from its source.
+  ASSERT_TRUE(loaded->Save(path + ".copy"));
+  auto copy = MemoryImage::Load(path + ".copy");
+  ASSERT_NE(copy, nullptr);
+  ASSERT_EQ(copy->mappings()[1].data, absl::MakeConstSpan(data));
+}
+
+TEST(MemoryImage, SaveInPlace) {
+  MemoryImage memory_image("aarch64");
+  std::vector<uint8_t> data(MemoryImage::kChunkSize * 2);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = i * 7;
+  }
+  memory_image.AddMapping(0x10000, data, true, false, false);
+
+  // an image can be saved over the file it was loaded from, in either format,
+  // however it was loaded.
+  std::string path = ::testing::TempDir() + "/memory_image_test_in_place.mem";
+  ASSERT_TRUE(memory_image.Save(path));
+  for (bool chunked : {true, false}) {
+    ASSERT_TRUE(MemoryImage::LoadLazy(path)->Save(path, chunked));
+    ASSERT_TRUE(MemoryImage::Load(path)->Save(path, !chunked));
+    auto loaded = MemoryImage::Load(path);
+    ASSERT_NE(loaded, nullptr);
+    std::vector<uint8_t> loaded_data(data.size());
+    ASSERT_TRUE(loaded->Read(0x10000, loaded_data.data(), loaded_data.size()));
+    ASSERT_EQ(loaded_data, data);
+  }
+}
+
+TEST(MemoryImage, Chunked) {
+  const uint64_t kChunkSize = MemoryImage::kChunkSize;
+
+  // a zero chunk, a compressible chunk, an incompressible chunk and part of a
+  // zero chunk.
+  std::vector<uint8_t> data(kChunkSize * 3 + 0x100);
+  for (size_t i = kChunkSize; i < kChunkSize * 2; ++i) {
+    data[i] = i & 0xf;
+  }
+  std::mt19937_64 prng;
+  for (size_t i = kChunkSize * 2; i < kChunkSize * 3; ++i) {
+    data[i] = prng();
+  }
+
+  MemoryImage memory_image("aarch64");
+  memory_image.AddMapping(0x100000, data, true, false, true);
+  AddMapping(&memory_image, 0x1000, 0x10, 1, false, false);
+
+  std::string path = ::testing::TempDir() + "/memory_image_test_chunked.mem";
+  ASSERT_TRUE(memory_image.Save(path, true));
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  ASSERT_LT(file.tellg(), kChunkSize * 2);
+
+  for (bool lazy : {false, true}) {
+    auto loaded =
+        lazy ? MemoryImage::LoadLazy(path) : MemoryImage::Load(path);
+    ASSERT_NE(loaded, nullptr);
+    ASSERT_EQ(loaded->mappings().size(), 2);
+    ASSERT_EQ(loaded->Read(0x1000)[0], 1);
+    ASSERT_EQ(loaded->mappings()[1].size(), data.size());
+    ASSERT_TRUE(loaded->executable(0x100000, data.size()));
+    for (size_t i = 0; i < data.size(); i += kChunkSize / 4 + 1) {
+      auto bytes = loaded->Read(0x100000 + i);
+      ASSERT_EQ(bytes.size(), std::min(kChunkSize - i % kChunkSize,
+                                       data.size() - i));
+      ASSERT_TRUE(std::equal(bytes.begin(), bytes.end(), &data[i]));
+    }
+
+    // sources can read across chunks.
+    std::vector<uint8_t> bytes(kChunkSize * 2);
+    ASSERT_TRUE(loaded->mappings()[1].source->Read(0x10, bytes.data(),
+                                                   bytes.size()));
+    ASSERT_TRUE(std::equal(bytes.begin(), bytes.end(), &data[0x10]));
+  }
+}
+
+}  // namespace test
+}  // namespace reil
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
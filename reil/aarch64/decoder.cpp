@@ -14,8 +14,12 @@
 
 #include "reil/aarch64/decoder.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <tuple>
+#include <vector>
+
+#include "glog/logging.h"
 
 namespace reil {
 namespace aarch64 {
@@ -107,32 +111,6 @@ static Instruction UnallocatedEncoding() {
   return insn;
 }
 
-static Instruction DecodePcRelativeAddressing(uint32_t opcode);
-static Instruction DecodeAddSubtractImmediate(uint32_t opcode);
-static Instruction DecodeLogicalImmediate(uint32_t opcode);
-static Instruction DecodeMoveWideImmediate(uint32_t opcode);
-static Instruction DecodeBitfield(uint32_t opcode);
-static Instruction DecodeExtract(uint32_t opcode);
-
-inline Instruction DecodeDataProcessingImmediate(uint32_t opcode) {
-  uint32_t op0 = bits(opcode, 23, 25);
-  if ((op0 & 0b110) == 0b000) {
-    return DecodePcRelativeAddressing(opcode);
-  } else if ((op0 & 0b110) == 0b010) {
-    return DecodeAddSubtractImmediate(opcode);
-  } else if (op0 == 0b100) {
-    return DecodeLogicalImmediate(opcode);
-  } else if (op0 == 0b101) {
-    return DecodeMoveWideImmediate(opcode);
-  } else if (op0 == 0b110) {
-    return DecodeBitfield(opcode);
-  } else if (op0 == 0b111) {
-    return DecodeExtract(opcode);
-  }
-
-  return UnallocatedEncoding();
-}
-
 static Instruction DecodePcRelativeAddressing(uint32_t opcode) {
   Instruction insn;
 
@@ -312,42 +290,6 @@ static Instruction DecodeExtract(uint32_t opcode) {
   return insn;
 }
 
-static Instruction DecodeConditionalBranch(uint32_t opcode);
-static Instruction DecodeExceptionGeneration(uint32_t opcode);
-static Instruction DecodeSystem(uint32_t opcode);
-static Instruction DecodeBranchRegister(uint32_t opcode);
-static Instruction DecodeBranchImmediate(uint32_t opcode);
-static Instruction DecodeCompareAndBranch(uint32_t opcode);
-static Instruction DecodeTestAndBranch(uint32_t opcode);
-
-static Instruction DecodeBranchExceptionGeneratingSystem(uint32_t opcode) {
-  uint32_t op0 = bits(opcode, 29, 31);
-  uint32_t op1 = bits(opcode, 22, 25);
-  if (op0 == 0b010) {
-    if ((op1 & 0b1000) == 0b0000) {
-      return DecodeConditionalBranch(opcode);
-    }
-  } else if (op0 == 0b110) {
-    if ((op1 & 0b1100) == 0b0000) {
-      return DecodeExceptionGeneration(opcode);
-    } else if (op1 == 0b0100) {
-      return DecodeSystem(opcode);
-    } else if ((op1 & 0b1000) == 0b1000) {
-      return DecodeBranchRegister(opcode);
-    }
-  } else if ((op0 & 0b011) == 0b000) {
-    return DecodeBranchImmediate(opcode);
-  } else if ((op0 & 0b011) == 0b001) {
-    if ((op1 & 0b1000) == 0b0000) {
-      return DecodeCompareAndBranch(opcode);
-    } else {
-      return DecodeTestAndBranch(opcode);
-    }
-  }
-
-  return UnallocatedEncoding();
-}
-
 static Instruction DecodeConditionalBranch(uint32_t opcode) {
   Instruction insn;
 
@@ -733,68 +675,6 @@ static Instruction DecodeTestAndBranch(uint32_t opcode) {
   return insn;
 }
 
-static Instruction DecodeSIMDLoadLiteral(uint32_t opcode);
-static Instruction DecodeSIMDLoadStorePair(uint32_t opcode);
-static Instruction DecodeSIMDLoadStoreUnscaledImmediate(uint32_t opcode);
-static Instruction DecodeSIMDLoadStoreRegisterOffset(uint32_t opcode);
-static Instruction DecodeSIMDLoadStoreUnsignedImmediate(uint32_t opcode);
-
-static Instruction DecodeLoadStoreExclusive(uint32_t opcode);
-static Instruction DecodeLoadLiteral(uint32_t opcode);
-static Instruction DecodeLoadStorePair(uint32_t opcode);
-static Instruction DecodeLoadStoreUnscaledImmediate(uint32_t opcode);
-static Instruction DecodeLoadStoreRegisterOffset(uint32_t opcode);
-static Instruction DecodeLoadStoreUnsignedImmediate(uint32_t opcode);
-
-static Instruction DecodeLoadStore(uint32_t opcode) {
-  // uint8_t op0 = bit(opcode, 31);
-  uint8_t op1 = bits(opcode, 28, 29);
-  uint8_t op2 = bit(opcode, 26);
-  uint8_t op3 = bits(opcode, 23, 24);
-  uint8_t op4 = bits(opcode, 16, 21);
-  uint8_t op5 = bits(opcode, 10, 11);
-
-  if (op2 == 0b1) {
-    // SIMD instructions
-    if (op1 == 0b01 && ((op3 & 0b10) == 0b00)) {
-      return DecodeSIMDLoadLiteral(opcode);
-    } else if (op1 == 0b10) {
-      return DecodeSIMDLoadStorePair(opcode);
-    } else if (op1 == 0b11) {
-      if ((op3 & 0b10) == 0b00) {
-        if ((op4 & 0b100000) == 0b000000) {
-          return DecodeSIMDLoadStoreUnscaledImmediate(opcode);
-        } else if ((op4 & 0b100000) == 0b100000 && op5 == 0b10) {
-          return DecodeSIMDLoadStoreRegisterOffset(opcode);
-        }
-      } else {
-        return DecodeSIMDLoadStoreUnsignedImmediate(opcode);
-      }
-    }
-  } else {
-    // Scalar instructions
-    if (op1 == 0b00 && op2 == 0b0 && ((op3 & 0b10) == 0b00)) {
-      return DecodeLoadStoreExclusive(opcode);
-    } else if (op1 == 0b01 && ((op3 & 0b10) == 0b00)) {
-      return DecodeLoadLiteral(opcode);
-    } else if (op1 == 0b10) {
-      return DecodeLoadStorePair(opcode);
-    } else if (op1 == 0b11) {
-      if ((op3 & 0b10) == 0b00) {
-        if ((op4 & 0b100000) == 0b000000) {
-          return DecodeLoadStoreUnscaledImmediate(opcode);
-        } else if ((op4 & 0b100000) == 0b100000 && op5 == 0b10) {
-          return DecodeLoadStoreRegisterOffset(opcode);
-        }
-      } else {
-        return DecodeLoadStoreUnsignedImmediate(opcode);
-      }
-    }
-  }
-
-  return UnallocatedEncoding();
-}
-
 static Instruction DecodeSIMDLoadLiteral(uint32_t opcode) {
   Instruction insn;
   insn.opcode = kSimdLdrLiteral;
@@ -1356,51 +1236,6 @@ static Instruction DecodeLoadStoreUnsignedImmediate(uint32_t opcode) {
   return insn;
 }
 
-static Instruction DecodeDataProcessingTwoSource(uint32_t opcode);
-static Instruction DecodeDataProcessingOneSource(uint32_t opcode);
-static Instruction DecodeLogicalShiftedRegister(uint32_t opcode);
-static Instruction DecodeAddSubtractShiftedRegister(uint32_t opcode);
-static Instruction DecodeAddSubtractExtendedRegister(uint32_t opcode);
-static Instruction DecodeAddSubtractWithCarry(uint32_t opcode);
-static Instruction DecodeConditionalCompare(uint32_t opcode);
-static Instruction DecodeConditionalSelect(uint32_t opcode);
-static Instruction DecodeDataProcessingThreeSource(uint32_t opcode);
-
-static Instruction DecodeDataProcessingRegister(uint32_t opcode) {
-  uint8_t op0 = bit(opcode, 30);
-  uint8_t op1 = bit(opcode, 28);
-  uint8_t op2 = bits(opcode, 21, 24);
-  // uint8_t op3 = bit(opcode, 11);
-
-  if (op1) {
-    if (op2 == 0b0000) {
-      return DecodeAddSubtractWithCarry(opcode);
-    } else if (op2 == 0b0010) {
-      return DecodeConditionalCompare(opcode);
-    } else if (op2 == 0b0100) {
-      return DecodeConditionalSelect(opcode);
-    } else if (op2 == 0b0110) {
-      if (!op0) {
-        return DecodeDataProcessingTwoSource(opcode);
-      } else {
-        return DecodeDataProcessingOneSource(opcode);
-      }
-    } else if ((op2 & 0b1000) == 0b1000) {
-      return DecodeDataProcessingThreeSource(opcode);
-    }
-  } else {
-    if ((op2 & 0b1000) == 0b0000) {
-      return DecodeLogicalShiftedRegister(opcode);
-    } else if ((op2 & 0b1001) == 0b1000) {
-      return DecodeAddSubtractShiftedRegister(opcode);
-    } else {
-      return DecodeAddSubtractExtendedRegister(opcode);
-    }
-  }
-
-  return UnallocatedEncoding();
-}
-
 static Instruction DecodeDataProcessingTwoSource(uint32_t opcode) {
   Instruction insn;
   uint8_t size = 32 << bit(opcode, 31);
@@ -1947,29 +1782,189 @@ static Instruction DecodeDataProcessingThreeSource(uint32_t opcode) {
   return insn;
 }
 
+typedef Instruction (*DecodeFunction)(uint32_t opcode);
+
+static Instruction DecodeUnallocated(uint32_t opcode) {
+  return UnallocatedEncoding();
+}
+
+static constexpr uint32_t pattern_bits(const char *pattern, char bit) {
+  uint32_t result = 0;
+  for (int i = 0; i < 32; ++i) {
+    result = (result << 1) | (pattern[i] == bit);
+  }
+  return result;
+}
+
+// an encoding class, written as in the architecture reference manual: a 32
+// character pattern from bit 31 down to bit 0, where 'x' marks bits that are
+// not needed to select the class.
+struct Encoding {
+  uint32_t mask;
+  uint32_t value;
+  DecodeFunction decode;
+
+  constexpr Encoding(const char (&pattern)[33], DecodeFunction decode_)
+      : mask(pattern_bits(pattern, '0') | pattern_bits(pattern, '1')),
+        value(pattern_bits(pattern, '1')),
+        decode(decode_) {}
+
+  bool Matches(uint32_t opcode) const { return (opcode & mask) == value; }
+};
+
+// every encoding class that we decode. the classes are disjoint, and any
+// opcode that matches none of them is unallocated (or not yet supported).
+static constexpr Encoding kEncodings[] = {
+    // data processing - immediate
+    {"xxx10000xxxxxxxxxxxxxxxxxxxxxxxx", DecodePcRelativeAddressing},
+    {"xxx10001xxxxxxxxxxxxxxxxxxxxxxxx", DecodeAddSubtractImmediate},
+    {"xxx100100xxxxxxxxxxxxxxxxxxxxxxx", DecodeLogicalImmediate},
+    {"xxx100101xxxxxxxxxxxxxxxxxxxxxxx", DecodeMoveWideImmediate},
+    {"xxx100110xxxxxxxxxxxxxxxxxxxxxxx", DecodeBitfield},
+    {"xxx100111xxxxxxxxxxxxxxxxxxxxxxx", DecodeExtract},
+
+    // branches, exception generating and system instructions
+    {"0101010xxxxxxxxxxxxxxxxxxxxxxxxx", DecodeConditionalBranch},
+    {"11010100xxxxxxxxxxxxxxxxxxxxxxxx", DecodeExceptionGeneration},
+    {"1101010100xxxxxxxxxxxxxxxxxxxxxx", DecodeSystem},
+    {"1101011xxxxxxxxxxxxxxxxxxxxxxxxx", DecodeBranchRegister},
+    {"x00101xxxxxxxxxxxxxxxxxxxxxxxxxx", DecodeBranchImmediate},
+    {"x011010xxxxxxxxxxxxxxxxxxxxxxxxx", DecodeCompareAndBranch},
+    {"x011011xxxxxxxxxxxxxxxxxxxxxxxxx", DecodeTestAndBranch},
+
+    // loads and stores
+    {"xx011100xxxxxxxxxxxxxxxxxxxxxxxx", DecodeSIMDLoadLiteral},
+    {"xx10110xxxxxxxxxxxxxxxxxxxxxxxxx", DecodeSIMDLoadStorePair},
+    {"xx111100xx0xxxxxxxxxxxxxxxxxxxxx", DecodeSIMDLoadStoreUnscaledImmediate},
+    {"xx111100xx1xxxxxxxxx10xxxxxxxxxx", DecodeSIMDLoadStoreRegisterOffset},
+    {"xx111101xxxxxxxxxxxxxxxxxxxxxxxx", DecodeSIMDLoadStoreUnsignedImmediate},
+    {"xx001000xxxxxxxxxxxxxxxxxxxxxxxx", DecodeLoadStoreExclusive},
+    {"xx011000xxxxxxxxxxxxxxxxxxxxxxxx", DecodeLoadLiteral},
+    {"xx10100xxxxxxxxxxxxxxxxxxxxxxxxx", DecodeLoadStorePair},
+    {"xx111000xx0xxxxxxxxxxxxxxxxxxxxx", DecodeLoadStoreUnscaledImmediate},
+    {"xx111000xx1xxxxxxxxx10xxxxxxxxxx", DecodeLoadStoreRegisterOffset},
+    {"xx111001xxxxxxxxxxxxxxxxxxxxxxxx", DecodeLoadStoreUnsignedImmediate},
+
+    // data processing - register
+    {"xxx11010000xxxxxxxxxxxxxxxxxxxxx", DecodeAddSubtractWithCarry},
+    {"xxx11010010xxxxxxxxxxxxxxxxxxxxx", DecodeConditionalCompare},
+    {"xxx11010100xxxxxxxxxxxxxxxxxxxxx", DecodeConditionalSelect},
+    {"x0x11010110xxxxxxxxxxxxxxxxxxxxx", DecodeDataProcessingTwoSource},
+    {"x1x11010110xxxxxxxxxxxxxxxxxxxxx", DecodeDataProcessingOneSource},
+    {"xxx11011xxxxxxxxxxxxxxxxxxxxxxxx", DecodeDataProcessingThreeSource},
+    {"xxx01010xxxxxxxxxxxxxxxxxxxxxxxx", DecodeLogicalShiftedRegister},
+    {"xxx01011xx0xxxxxxxxxxxxxxxxxxxxx", DecodeAddSubtractShiftedRegister},
+    {"xxx01011xx1xxxxxxxxxxxxxxxxxxxxx", DecodeAddSubtractExtendedRegister},
+};
+
+// kEncodings compiled into a table indexed by the top bits of the opcode.
+// almost every entry selects a single encoding class outright; the rest hold
+// the short list of classes that still need to be checked against the low
+// bits of the opcode.
+class DispatchTable {
+  static constexpr int kShift = 21;
+  static constexpr size_t kSize = 1 << (32 - kShift);
+  static constexpr uint32_t kMask = 0xffffffffu << kShift;
+
+  struct Entry {
+    DecodeFunction decode;
+    uint8_t begin;
+    uint8_t end;
+  };
+
+  Entry entries_[kSize];
+  std::vector<const Encoding *> candidates_;
+
+  DispatchTable();
+
+ public:
+  static const DispatchTable &Get() {
+    static const DispatchTable table;
+    return table;
+  }
+
+  DecodeFunction Lookup(uint32_t opcode) const {
+    const Entry &entry = entries_[opcode >> kShift];
+    if (entry.decode) {
+      return entry.decode;
+    }
+    for (uint8_t i = entry.begin; i < entry.end; ++i) {
+      if (candidates_[i]->Matches(opcode)) {
+        return candidates_[i]->decode;
+      }
+    }
+    return DecodeUnallocated;
+  }
+};
+
+DispatchTable::DispatchTable() {
+  for (size_t index = 0; index < kSize; ++index) {
+    uint32_t prefix = index << kShift;
+    std::vector<const Encoding *> matches;
+    for (const Encoding &encoding : kEncodings) {
+      if (((prefix ^ encoding.value) & encoding.mask & kMask) == 0) {
+        matches.push_back(&encoding);
+      }
+    }
+
+    Entry &entry = entries_[index];
+    entry.decode = nullptr;
+    entry.begin = entry.end = 0;
+    if (matches.empty()) {
+      entry.decode = DecodeUnallocated;
+    } else if (matches.size() == 1 && (matches[0]->mask & ~kMask) == 0) {
+      entry.decode = matches[0]->decode;
+    } else {
+      // the same list of candidates is usually shared by many entries.
+      auto iter = std::search(candidates_.begin(), candidates_.end(),
+                              matches.begin(), matches.end());
+      if (iter == candidates_.end()) {
+        iter = candidates_.insert(candidates_.end(), matches.begin(),
+                                  matches.end());
+      }
+      entry.begin = iter - candidates_.begin();
+      entry.end = entry.begin + matches.size();
+      CHECK_LE(candidates_.size(), UINT8_MAX)
+          << "too many dispatch candidates for the table entries";
+    }
+  }
+}
+
 std::tuple<uint64_t, uint64_t> DecodeBitMasks(uint8_t size, Immediate imms,
                                               Immediate immr) {
   return decode_bit_masks(size == 64 ? 1 : 0, imms.value, immr.value, false);
 }
 
-Instruction DecodeInstruction(uint64_t address, uint32_t opcode) {
-  Instruction insn;
+Group DecodeGroup(uint32_t opcode) {
   uint32_t op0 = bits(opcode, 25, 28);
   if ((op0 & 0b1110) == 0b1000) {
-    insn = DecodeDataProcessingImmediate(opcode);
+    return Group::kDataProcessingImmediate;
   } else if ((op0 & 0b1110) == 0b1010) {
-    insn = DecodeBranchExceptionGeneratingSystem(opcode);
+    return Group::kBranchExceptionGeneratingSystem;
   } else if ((op0 & 0b0101) == 0b0100) {
-    insn = DecodeLoadStore(opcode);
+    return Group::kLoadStore;
   } else if ((op0 & 0b0111) == 0b0101) {
-    insn = DecodeDataProcessingRegister(opcode);
+    return Group::kDataProcessingRegister;
   } /* else if (op0 == 0b0111 || op0 == 0b1111) {
     // Data processing - SIMD and floating point
   } */
-  else {
-    insn = UnallocatedEncoding();
-  }
+  return Group::kUnallocated;
+}
 
+Instruction DecodeInstruction(uint64_t address, uint32_t opcode) {
+  Instruction insn = DispatchTable::Get().Lookup(opcode)(opcode);
+  insn.address = address;
+  return insn;
+}
+
+Instruction DecodeInstructionLinear(uint64_t address, uint32_t opcode) {
+  Instruction insn = UnallocatedEncoding();
+  for (const Encoding &encoding : kEncodings) {
+    if (encoding.Matches(opcode)) {
+      insn = encoding.decode(opcode);
+      break;
+    }
+  }
   insn.address = address;
   return insn;
 }
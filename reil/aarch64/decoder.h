@@ -14,12 +14,16 @@
 
 #ifndef REIL_AARCH64_DECODER_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
+#include <new>
+#include <string>
 #include <tuple>
-#include <vector>
+#include <type_traits>
 
 #include "absl/types/variant.h"
+#include "glog/logging.h"
 
 namespace reil {
 namespace aarch64 {
@@ -486,11 +490,45 @@ typedef absl::variant<Immediate, Register, SystemRegister, Shift, Extend,
                       ImmediateOffset, RegisterOffset>
     Operand;
 
+// a fixed capacity list of operands, held inline so that decoding (and
+// copying) an Instruction never allocates. no aarch64 encoding currently
+// decodes to more than kMaxOperands operands.
+class Operands {
+ public:
+  static constexpr size_t kMaxOperands = 5;
+
+ private:
+  std::aligned_storage<sizeof(Operand), alignof(Operand)>::type
+      storage_[kMaxOperands];
+  uint8_t size_ = 0;
+
+ public:
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  void push_back(const Operand &operand) {
+    // checked in release builds too, since an overflow would write past the
+    // end of storage_.
+    CHECK(size_ < kMaxOperands) << "too many operands";
+    new (&storage_[size_++]) Operand(operand);
+  }
+
+  Operand &operator[](size_t index) {
+    return *reinterpret_cast<Operand *>(&storage_[index]);
+  }
+  const Operand &operator[](size_t index) const {
+    return *reinterpret_cast<const Operand *>(&storage_[index]);
+  }
+
+  const Operand *begin() const { return &(*this)[0]; }
+  const Operand *end() const { return begin() + size_; }
+};
+
 struct Instruction {
   uint64_t address;
   enum Opcode opcode;
 
-  std::vector<Operand> operands;
+  Operands operands;
 
   ConditionCode cc;
   bool set_flags;
@@ -498,12 +536,39 @@ struct Instruction {
   Instruction() : address(0), opcode(kUnallocated), set_flags(false) {}
 };
 
+static_assert(std::is_trivially_copyable<Instruction>::value,
+              "decoder::Instruction should be trivially copyable");
+
+// the top level encoding groups, selected by bits 25 to 28 of the opcode.
+enum class Group {
+  kUnallocated,
+  kDataProcessingImmediate,
+  kBranchExceptionGeneratingSystem,
+  kLoadStore,
+  kDataProcessingRegister,
+};
+
 std::tuple<uint64_t, uint64_t> DecodeBitMasks(uint8_t size, Immediate imms,
                                               Immediate immr);
+Group DecodeGroup(uint32_t opcode);
 Instruction DecodeInstruction(uint64_t address, uint32_t opcode);
 
+// DecodeInstruction selects the encoding class of an opcode through a dispatch
+// table; this does the same by checking each class in turn, and is only kept
+// to check the dispatch table against.
+Instruction DecodeInstructionLinear(uint64_t address, uint32_t opcode);
+
 std::ostream &operator<<(std::ostream &stream, const Operand &opnd);
 std::ostream &operator<<(std::ostream &stream, const Instruction &insn);
+
+// formats insn as operator<< does, but without iostreams or allocation. at
+// most buffer_len - 1 characters and a terminating nul are written, and the
+// length of the whole mnemonic is returned, as by snprintf.
+size_t PrintInstruction(const Instruction &insn, char *buffer,
+                        size_t buffer_len);
+
+// appends the mnemonic of insn to output.
+void PrintInstruction(const Instruction &insn, std::string *output);
 }  // namespace decoder
 }  // namespace aarch64
 }  // namespace reil
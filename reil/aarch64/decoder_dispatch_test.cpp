@@ -0,0 +1,160 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "reil/aarch64/decoder.h"
+
+namespace reil {
+namespace test {
+
+std::mt19937_64 prng;
+
+static std::string Print(const aarch64::decoder::Instruction &insn) {
+  std::stringstream stream;
+  stream << insn;
+  return stream.str();
+}
+
+TEST(AArch64DecoderDispatch, Sweep) {
+  // the encoding classes are selected by bits 21 to 31, and bits 10 and 11;
+  // sweep every combination of those, with the remaining bits random.
+  const uint32_t kSelectMask = 0xffe00c00;
+  for (uint32_t select = 0; select < (1 << 13); ++select) {
+    uint32_t select_bits = ((select >> 2) << 21) | ((select & 0b11) << 10);
+    for (int i = 0; i < 8; ++i) {
+      uint32_t opcode = (prng() & ~kSelectMask) | select_bits;
+
+      auto insn = aarch64::decoder::DecodeInstruction(0x1000, opcode);
+      auto expected = aarch64::decoder::DecodeInstructionLinear(0x1000, opcode);
+      ASSERT_EQ(insn.opcode, expected.opcode) << std::hex << opcode;
+      ASSERT_EQ(insn.address, expected.address);
+      ASSERT_EQ(insn.operands.size(), expected.operands.size());
+      ASSERT_EQ(insn.set_flags, expected.set_flags);
+      if (insn.opcode != aarch64::decoder::kUnallocated) {
+        ASSERT_EQ(Print(insn), Print(expected)) << std::hex << opcode;
+      }
+    }
+  }
+}
+
+TEST(AArch64DecoderDispatch, Golden) {
+  // instructions from each encoding class, decoded by the decoder as it was
+  // before dispatch went through a table, so that a wrong pattern in the
+  // table can't pass by matching itself. an empty text is unallocated.
+  struct Golden {
+    uint32_t opcode;
+    size_t operand_count;
+    const char *text;
+  };
+  const Golden kGolden[] = {
+      // data processing - immediate
+      {0xf0fb51e2, 3, "adrp x2, #0xfffffffff6a3f000"},
+      {0xf0e12de5, 3, "adrp x5, #0xffffffffc25bf000"},
+      {0x51fdfd1d, 4, "sub w29, w8, #0xf7f"},
+      {0x31760881, 4, "adds w1, w4, #0xd82, lsl #0xc"},
+      {0x32154da4, 3, "orr w4, w13, #0x7ffff800"},
+      {0x122dada9, 3, "and w9, w13, #0x7ff87ff8"},
+      {0xd291517e, 3, "mov x30, #0x8a8b"},
+      {0x92d66d65, 3, "mov x5, #0xffff4c94ffffffff"},
+      {0x93759e1d, 4, "sbfiz x29, x16, #11, #40"},
+      {0xb3505af7, 4, "bfxil x23, x23, #48, #23"},
+      {0x33ac5576, 4, "extr w22, w11, w12, #21"},
+      {0xb3ea3cd0, 4, "extr x16, x6, x10, #15"},
+      // branches, exception generating and system instructions
+      {0x541832c9, 1, "b.ls #0x31658"},
+      {0x54dbb10b, 1, "b.lt #0xfffffffffffb8620"},
+      {0xd4b49183, 1, "dcps3"},
+      {0xd419bd03, 1, "smc #52712"},
+      {0xd51c95c0, 2, "msr S3_4_C9_C5_6, x0"},
+      {0xd53c4206, 2, "mrs x6, S3_4_C4_C2_0"},
+      {0x94830b55, 1, "bl #0x20c3d54"},
+      {0x971e88e9, 1, "bl #0xfffffffffc7a33a4"},
+      {0xb4c960ca, 2, "cbz x10, #0xfffffffffff93c18"},
+      {0x3449e00d, 2, "cbz w13, #0x94c00"},
+      {0xb7499a55, 3, "tbnz x21, #41, #0x4348"},
+      {0xb69f946e, 3, "tbz x14, #51, #0x28c"},
+      {0xd65f03c0, 1, "ret"},
+      {0xd61f0020, 1, "br x1"},
+      {0xd63f0040, 1, "blr x2"},
+      // loads and stores
+      {0x9c4023d3, 2, "ldr q19, #0x80478"},
+      {0x1c8da0a5, 2, "ldr s5, #-0xe4bec"},
+      {0x2c3cdce4, 3, "stnp s4, s23, [x7, #-0x1c]"},
+      {0xadb42fb2, 3, "stp q18, q11, [x29, #-0xc0]!"},
+      {0xbc0c2561, 2, "str s1, [x11], #0xc2"},
+      {0x3c0858df, 2, "str b31, [x6, #0x85]"},
+      {0x3cfee98f, 2, "ldr q15, [x12, x30, sxtx]"},
+      {0x3ce3cbf1, 2, "ldr q17, [sp, x3, sxtw]"},
+      {0x7d5b4fd2, 2, "ldr h18, [x30, #0xda6]"},
+      {0xbd79ac71, 2, "ldr s17, [x3, #0x39ac]"},
+      {0xc8f678dc, 3, "casa x22, x28, [x6]"},
+      {0x88f92774, 3, "casa w25, w20, [x27]"},
+      {0x9853aa10, 2, "ldrsw x16, #0xa7540"},
+      {0xa840ee93, 3, "ldnp x19, x27, [x20, #0x8]"},
+      {0x29f0c422, 3, "ldp w2, w17, [x1, #-0x7c]!"},
+      {0x38d67ff2, 2, "ldrsb w18, [sp, #-0x99]!"},
+      {0x3855cd19, 2, "ldrb w25, [x8, #-0xa4]!"},
+      {0xb8aaeb06, 2, "ldrsw x6, [x24, x10, sxtx]"},
+      {0xf915bef5, 2, "str x21, [x23, #0x2b78]"},
+      // data processing - register
+      {0x7a070258, 3, "sbcs w24, w18, w7"},
+      {0x7a110052, 3, "sbcs w18, w2, w17"},
+      {0x3a57ae93, 3, "ccmp w20, #0x17, #0x3, ge"},
+      {0xba5331df, 3, "ccmp x14, x19, #0xf, cc"},
+      {0x5a978349, 3, "csinv w9, w26, w23, hi"},
+      {0x1a8440db, 3, "csel w27, w6, w4, mi"},
+      {0x9ad15e3e, 3, "crc32cx x30, x17, x17"},
+      {0x9ad65f73, 3, "crc32cx x19, x27, x22"},
+      {0xdac109bf, 2, "pacda xzr, x13"},
+      {0xdac1129c, 2, "autia x28, x20"},
+      {0x1b38cfd0, 4, "smsubl x16, w30, w24, x19"},
+      {0x9bae0c66, 4, "umaddl x6, w3, w14, x3"},
+      {0x4a541111, 4, "eor w17, w8, w20, lsr #0x4"},
+      {0x4af889e2, 4, "eon w2, w15, w24, ror #0x22"},
+      {0x0b024ce2, 4, "add w2, w7, w2, lsl #0x13"},
+      {0x4b140771, 4, "sub w17, w27, w20, lsl #0x1"},
+      {0x2b20e732, 4, "adds w18, w25, w0, sxtx, #1"},
+      {0xeb29c995, 4, "subs x21, x12, w9, sxtw, #2"},
+      // unallocated
+      {0x00000000, 0, ""},
+      {0xffffffff, 0, ""},
+  };
+
+  for (const Golden &golden : kGolden) {
+    auto insn = aarch64::decoder::DecodeInstruction(0x1000, golden.opcode);
+    if (!*golden.text) {
+      ASSERT_EQ(insn.opcode, aarch64::decoder::kUnallocated)
+          << std::hex << golden.opcode;
+      continue;
+    }
+    ASSERT_NE(insn.opcode, aarch64::decoder::kUnallocated)
+        << std::hex << golden.opcode;
+    ASSERT_EQ(insn.operands.size(), golden.operand_count)
+        << std::hex << golden.opcode;
+    ASSERT_EQ(Print(insn), golden.text) << std::hex << golden.opcode;
+  }
+}
+
+}  // namespace test
+}  // namespace reil
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
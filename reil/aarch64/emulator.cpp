@@ -14,9 +14,11 @@
 
 #include "reil/aarch64/emulator.h"
 
+#include <utility>
+
 namespace reil {
 namespace aarch64 {
-Emulator::Emulator(uint32_t flags) : flags_(flags) {
+Emulator::Emulator(uint32_t flags) : flags_(flags), interpreter_(kV31 + 1) {
   interpreter_.SetRegister(kX0, Immediate(64, 0));
   interpreter_.SetRegister(kX1, Immediate(64, 0));
   interpreter_.SetRegister(kX2, Immediate(64, 0));
@@ -95,24 +97,204 @@ Emulator::Emulator(uint32_t flags) : flags_(flags) {
 
 Emulator::~Emulator() {}
 
-void Emulator::Run() {}
+const Emulator::CachedInstruction *Emulator::Cache(NativeInstruction &&ni) {
+  CachedInstruction &ci = instructions_[ni.address];
+  ci.ni = std::move(ni);
+  ci.bytecode = CompileBytecode(ci.ni);
+  ci.ends_block = false;
+  ci.sys = false;
+  ci.unknown = false;
+  for (const auto &ri : ci.ni.reil) {
+    if (ri.opcode == Opcode::Jcc && ri.output.type() != kOffset) {
+      ci.ends_block = true;
+    } else if (ri.opcode == Opcode::Sys) {
+      ci.ends_block = ci.sys = true;
+    } else if (ri.opcode == Opcode::Unkn) {
+      ci.ends_block = ci.unknown = true;
+    }
+  }
+  return &ci;
+}
+
+const Emulator::CachedInstruction *Emulator::Translate(uint64_t address) {
+  auto instruction_iter = instructions_.find(address);
+  if (instruction_iter != instructions_.end()) {
+    return &instruction_iter->second;
+  }
+
+  Memory &memory = interpreter_.memory();
+  if (!memory.Mapped(address, 4)) {
+    return nullptr;
+  }
+
+  uint8_t bytes[4];
+  memory.Read(address, bytes, sizeof(bytes));
+  memory.Watch(address);
+
+  return Cache(TranslateInstruction(address, bytes, sizeof(bytes), flags_));
+}
+
+const Emulator::Block *Emulator::TranslateBlock(uint64_t address) {
+  auto block_iter = blocks_.find(address);
+  if (block_iter != blocks_.end()) {
+    return &block_iter->second;
+  }
+
+  Memory &memory = interpreter_.memory();
+  if (!memory.Mapped(address, 4)) {
+    return nullptr;
+  }
+
+  // the block runs to the end of the page, or up to the next breakpoint.
+  uint64_t block_end = (address & ~Memory::kPageMask) + Memory::kPageSize;
+  for (uint64_t breakpoint : breakpoints_) {
+    if (address < breakpoint && breakpoint < block_end) {
+      block_end = breakpoint;
+    }
+  }
+
+  // instructions that are already cached are reused, and each run of
+  // uncached instructions between them is translated in one go, up to the
+  // first instruction that leaves the block.
+  Block block;
+  uint8_t bytes[Memory::kPageSize];
+  uint64_t next_address = address;
+  bool ends_block = false;
+  while (!ends_block && next_address < block_end) {
+    auto instruction_iter = instructions_.find(next_address);
+    if (instruction_iter != instructions_.end()) {
+      block.push_back(&instruction_iter->second);
+      ends_block = instruction_iter->second.ends_block;
+      next_address += 4;
+      continue;
+    }
+
+    if (!memory.Mapped(next_address, 4)) {
+      break;
+    }
+
+    uint64_t run_end = next_address + 4;
+    while (run_end < block_end && !instructions_.count(run_end)) {
+      run_end += 4;
+    }
+
+    memory.Read(next_address, bytes, run_end - next_address);
+    memory.Watch(next_address);
+
+    // nothing reads the mnemonics of cached instructions.
+    block_buffer_.Clear();
+    aarch64::TranslateBlock(next_address, bytes, run_end - next_address,
+                            &block_buffer_, flags_ | kNoMnemonics);
+    for (size_t i = 0; i < block_buffer_.size() && !ends_block; ++i) {
+      const CachedInstruction *ci = Cache(block_buffer_.Get(i));
+      block.push_back(ci);
+      ends_block = ci->ends_block;
+    }
+    next_address = run_end;
+  }
+
+  return &(blocks_[address] = std::move(block));
+}
+
+bool Emulator::InvalidateWrittenCode() {
+  Memory &memory = interpreter_.memory();
+  if (memory.written_pages().empty()) {
+    return false;
+  }
+
+  for (uint64_t page_address : memory.written_pages()) {
+    for (uint64_t address = page_address;
+         address < page_address + Memory::kPageSize; address += 4) {
+      instructions_.erase(address);
+      blocks_.erase(address);
+    }
+  }
+  memory.ClearWrittenPages();
+  return true;
+}
+
+uint64_t Emulator::Execute(const CachedInstruction *ci) {
+  // the bytecode can't be traced, so tracing falls back to the reference
+  // interpreter.
+  if (interpreter_.trace_sink()) {
+    return interpreter_.Execute(ci->ni);
+  }
+  return interpreter_.Execute(ci->bytecode);
+}
+
+StopReason Emulator::Run(uint64_t max_instructions) {
+  InvalidateWrittenCode();
 
-bool Emulator::SingleStep() {
   uint64_t pc = static_cast<uint64_t>(GetRegister(kPc));
-  auto bytes = GetMemory(pc, 4);
+  uint64_t instruction_count = 0;
+  bool resumed = true;
+  for (;;) {
+    if (instruction_count >= max_instructions) {
+      return StopReason::kInstructionLimit;
+    }
 
-  if (bytes.size() == 4) {
-    NativeInstruction ni = TranslateInstruction(pc, bytes, flags_);
-    if (ni.reil.size()) {
-      pc = interpreter_.Execute(ni);
-      SetRegister(kPc, Immediate(64, pc));
+    if (!resumed && breakpoints_.count(pc)) {
+      return StopReason::kBreakpoint;
+    }
+    resumed = false;
 
-      return true;
+    const Block *block = TranslateBlock(pc);
+    if (!block) {
+      return StopReason::kUnmappedFetch;
+    }
+
+    for (const CachedInstruction *ci : *block) {
+      if (ci->unknown) {
+        return StopReason::kUnknownInstruction;
+      }
+
+      pc = Execute(ci);
+      SetRegister(kPc, Immediate(64, pc));
+      ++instruction_count;
+
+      if (ci->sys) {
+        return StopReason::kSys;
+      }
+
+      // the block (and ci) may have been freed if the instruction wrote to a
+      // code page, so we have to leave it before touching either again.
+      if (InvalidateWrittenCode() || instruction_count >= max_instructions ||
+          pc != ci->ni.address + ci->ni.size) {
+        break;
+      }
     }
   }
+}
+
+bool Emulator::SingleStep() {
+  InvalidateWrittenCode();
+
+  uint64_t pc = static_cast<uint64_t>(GetRegister(kPc));
+  const CachedInstruction *ci = Translate(pc);
+  if (ci && ci->ni.reil.size()) {
+    pc = Execute(ci);
+    SetRegister(kPc, Immediate(64, pc));
+
+    return true;
+  }
   return false;
 }
 
+void Emulator::AddBreakpoint(uint64_t address) {
+  breakpoints_.insert(address);
+
+  // blocks that run through the breakpoint need to be split at it.
+  uint64_t page_address = address & ~Memory::kPageMask;
+  for (uint64_t block_address = page_address; block_address < address;
+       block_address += 4) {
+    blocks_.erase(block_address);
+  }
+}
+
+void Emulator::RemoveBreakpoint(uint64_t address) {
+  breakpoints_.erase(address);
+}
+
 Immediate Emulator::GetRegister(uint32_t index) const {
   return interpreter_.GetRegister(index);
 }
@@ -125,6 +307,10 @@ std::vector<uint8_t> Emulator::GetMemory(uint64_t address, size_t size) {
   return interpreter_.GetMemory(address, size);
 }
 
+void Emulator::MapMemory(uint64_t address, absl::Span<const uint8_t> bytes) {
+  interpreter_.MapMemory(address, bytes);
+}
+
 void Emulator::SetMemory(uint64_t address, const absl::Span<uint8_t> &bytes) {
   interpreter_.SetMemory(address, bytes);
 }
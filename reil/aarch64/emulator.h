@@ -14,6 +14,10 @@
 
 #ifndef REIL_AARCH64_EMULATOR_H_
 
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 #include "reil/emulator.h"
 #include "reil/interpreter.h"
 #include "reil/aarch64/translator.h"
@@ -24,20 +28,57 @@ namespace reil {
 namespace aarch64 {
 class Emulator : public reil::Emulator {
  private:
+  struct CachedInstruction {
+    NativeInstruction ni;
+    Bytecode bytecode;
+    // ni leaves the straight-line path through its block (contains a branch
+    // to another native instruction, a Sys or an Unkn).
+    bool ends_block;
+    bool sys;
+    bool unknown;
+  };
+
+  typedef std::vector<const CachedInstruction *> Block;
+
   uint32_t flags_;
   reil::Interpreter interpreter_;
 
+  // translations are cached by address, along with the basic blocks built from
+  // them. the pages they were translated from are watched, and both caches are
+  // invalidated a page at a time when those pages are written; blocks never
+  // cross a page boundary so that this is sufficient.
+  std::unordered_map<uint64_t, CachedInstruction> instructions_;
+  std::unordered_map<uint64_t, Block> blocks_;
+  std::unordered_set<uint64_t> breakpoints_;
+
+  // reused for translating each block.
+  TranslationBuffer block_buffer_;
+
+  const CachedInstruction *Cache(NativeInstruction &&ni);
+  const CachedInstruction *Translate(uint64_t address);
+  const Block *TranslateBlock(uint64_t address);
+  bool InvalidateWrittenCode();
+  uint64_t Execute(const CachedInstruction *ci);
+
  public:
   explicit Emulator(uint32_t flags = kDefaultFlags);
   ~Emulator();
 
   uint32_t flags() const { return flags_; }
 
-  void Run() override;
+  TraceSink *trace_sink() const { return interpreter_.trace_sink(); }
+  void set_trace_sink(TraceSink *trace_sink) {
+    interpreter_.set_trace_sink(trace_sink);
+  }
+
+  StopReason Run(uint64_t max_instructions) override;
   bool SingleStep() override;
+  void AddBreakpoint(uint64_t address) override;
+  void RemoveBreakpoint(uint64_t address) override;
   Immediate GetRegister(uint32_t index) const override;
   void SetRegister(uint32_t index, Immediate value) override;
   std::vector<uint8_t> GetMemory(uint64_t address, size_t size) override;
+  void MapMemory(uint64_t address, absl::Span<const uint8_t> bytes) override;
   void SetMemory(uint64_t address, const absl::Span<uint8_t> &bytes) override;
   void SetMemory(uint64_t address, uint8_t *bytes, size_t bytes_len) override;
 };
@@ -0,0 +1,158 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "reil/aarch64.h"
+
+namespace reil {
+namespace test {
+
+void SetCode(aarch64::Emulator& emu, uint64_t address,
+             const std::vector<uint32_t>& opcodes) {
+  for (uint32_t opcode : opcodes) {
+    uint8_t bytes[4] = {
+        static_cast<uint8_t>(opcode), static_cast<uint8_t>(opcode >> 8),
+        static_cast<uint8_t>(opcode >> 16), static_cast<uint8_t>(opcode >> 24),
+    };
+    emu.SetMemory(address, bytes, sizeof(bytes));
+    address += sizeof(bytes);
+  }
+}
+
+TEST(AArch64Emulator, RunInstructionLimit) {
+  aarch64::Emulator emu;
+  SetCode(emu, 0x1000, {
+                           0xd2800000,  // mov x0, #0
+                           0x91000400,  // add x0, x0, #1
+                           0x17ffffff,  // b 0x1004
+                       });
+  emu.SetRegister(aarch64::kPc, Imm64(0x1000));
+
+  EXPECT_EQ(emu.Run(10), StopReason::kInstructionLimit);
+  EXPECT_EQ(emu.GetRegister(aarch64::kX0), Imm64(5));
+  EXPECT_EQ(emu.GetRegister(aarch64::kPc), Imm64(0x1008));
+
+  EXPECT_EQ(emu.Run(2), StopReason::kInstructionLimit);
+  EXPECT_EQ(emu.GetRegister(aarch64::kX0), Imm64(6));
+  EXPECT_EQ(emu.GetRegister(aarch64::kPc), Imm64(0x1008));
+}
+
+TEST(AArch64Emulator, RunBreakpoint) {
+  aarch64::Emulator emu;
+  SetCode(emu, 0x1000, {
+                           0xd2800000,  // mov x0, #0
+                           0x91000400,  // add x0, x0, #1
+                           0x17ffffff,  // b 0x1004
+                       });
+  emu.SetRegister(aarch64::kPc, Imm64(0x1000));
+
+  // translate the loop before setting the breakpoint, so that it has to be
+  // split out of the cached block.
+  EXPECT_EQ(emu.Run(5), StopReason::kInstructionLimit);
+  EXPECT_EQ(emu.GetRegister(aarch64::kX0), Imm64(2));
+
+  emu.AddBreakpoint(0x1008);
+  EXPECT_EQ(emu.Run(100), StopReason::kBreakpoint);
+  EXPECT_EQ(emu.GetRegister(aarch64::kX0), Imm64(3));
+  EXPECT_EQ(emu.GetRegister(aarch64::kPc), Imm64(0x1008));
+
+  // resuming from the breakpoint executes it.
+  EXPECT_EQ(emu.Run(100), StopReason::kBreakpoint);
+  EXPECT_EQ(emu.GetRegister(aarch64::kX0), Imm64(4));
+  EXPECT_EQ(emu.GetRegister(aarch64::kPc), Imm64(0x1008));
+
+  emu.RemoveBreakpoint(0x1008);
+  EXPECT_EQ(emu.Run(10), StopReason::kInstructionLimit);
+  EXPECT_EQ(emu.GetRegister(aarch64::kX0), Imm64(9));
+}
+
+TEST(AArch64Emulator, RunSys) {
+  aarch64::Emulator emu;
+  SetCode(emu, 0x1000, {
+                           0xd2800020,  // mov x0, #1
+                           0xd4000001,  // svc #0
+                           0xd2800040,  // mov x0, #2
+                       });
+  emu.SetRegister(aarch64::kPc, Imm64(0x1000));
+
+  EXPECT_EQ(emu.Run(100), StopReason::kSys);
+  EXPECT_EQ(emu.GetRegister(aarch64::kX0), Imm64(1));
+  EXPECT_EQ(emu.GetRegister(aarch64::kPc), Imm64(0x1008));
+}
+
+TEST(AArch64Emulator, RunCachedInstructions) {
+  aarch64::Emulator emu;
+  SetCode(emu, 0x1000, {
+                           0xd2800020,  // mov x0, #1
+                           0x91000400,  // add x0, x0, #1
+                           0x91000400,  // add x0, x0, #1
+                           0xd4000001,  // svc #0
+                       });
+
+  // single stepping caches the instruction in the middle of the block, which
+  // the block is then translated around.
+  emu.SetRegister(aarch64::kPc, Imm64(0x1004));
+  EXPECT_TRUE(emu.SingleStep());
+  EXPECT_EQ(emu.GetRegister(aarch64::kX0), Imm64(1));
+
+  emu.SetRegister(aarch64::kPc, Imm64(0x1000));
+  EXPECT_EQ(emu.Run(100), StopReason::kSys);
+  EXPECT_EQ(emu.GetRegister(aarch64::kX0), Imm64(3));
+  EXPECT_EQ(emu.GetRegister(aarch64::kPc), Imm64(0x1010));
+}
+
+TEST(AArch64Emulator, RunUnmappedFetch) {
+  aarch64::Emulator emu;
+  SetCode(emu, 0x1ff8, {
+                           0xd2800020,  // mov x0, #1
+                           0xd2800040,  // mov x0, #2
+                       });
+  emu.SetRegister(aarch64::kPc, Imm64(0x1ff8));
+
+  EXPECT_EQ(emu.Run(100), StopReason::kUnmappedFetch);
+  EXPECT_EQ(emu.GetRegister(aarch64::kX0), Imm64(2));
+  EXPECT_EQ(emu.GetRegister(aarch64::kPc), Imm64(0x2000));
+}
+
+TEST(AArch64Emulator, RunSelfModifyingCode) {
+  aarch64::Emulator emu;
+  SetCode(emu, 0x1000, {
+                           0xd2800020,  // mov x0, #1
+                           0xb9000041,  // str w1, [x2]
+                           0x17fffffe,  // b 0x1000
+                       });
+  emu.SetRegister(aarch64::kX1, Imm64(0xd2800040));  // mov x0, #2
+  emu.SetRegister(aarch64::kX2, Imm64(0x1000));
+  emu.SetRegister(aarch64::kPc, Imm64(0x1000));
+
+  EXPECT_EQ(emu.Run(4), StopReason::kInstructionLimit);
+  EXPECT_EQ(emu.GetRegister(aarch64::kX0), Imm64(2));
+
+  // writes from outside the emulator invalidate cached code too.
+  SetCode(emu, 0x1000, {0xd2800060});  // mov x0, #3
+  emu.SetRegister(aarch64::kPc, Imm64(0x1000));
+  EXPECT_TRUE(emu.SingleStep());
+  EXPECT_EQ(emu.GetRegister(aarch64::kX0), Imm64(3));
+}
+
+}  // namespace test
+}  // namespace reil
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
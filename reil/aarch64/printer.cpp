@@ -14,17 +14,115 @@
 
 #include "reil/aarch64/decoder.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <ios>
+#include <string>
+#include <type_traits>
 
 namespace reil {
 namespace aarch64 {
 namespace decoder {
 
-static void PrintImmediate(std::ostream& stream, const Immediate& opnd) {
+// The output of the allocation-free printer: either a fixed-size buffer, which
+// is truncated and nul-terminated as by snprintf, or a string to append to.
+//
+// The printing functions below are templates over their output, so that they
+// can write to either this or an ostream. Integers are formatted here directly,
+// in the base last selected with std::hex or std::dec, so the output is the
+// same as an ostream's.
+class Writer {
+  char* buffer_ = nullptr;
+  size_t capacity_ = 0;
+  std::string* string_ = nullptr;
+  size_t length_ = 0;
+  bool hex_ = false;
+
+  void Write(const char* data, size_t size) {
+    if (string_) {
+      string_->append(data, size);
+    } else if (length_ + 1 < capacity_) {
+      memcpy(buffer_ + length_, data,
+             std::min(size, capacity_ - 1 - length_));
+    }
+    length_ += size;
+  }
+
+  template <typename T>
+  void WriteUnsigned(T value) {
+    char digits[20];
+    char* end = digits + sizeof(digits);
+    char* digit = end;
+    if (hex_) {
+      do {
+        *--digit = "0123456789abcdef"[value & 0xf];
+        value >>= 4;
+      } while (value);
+    } else {
+      do {
+        *--digit = '0' + value % 10;
+        value /= 10;
+      } while (value);
+    }
+    Write(digit, end - digit);
+  }
+
+ public:
+  Writer(char* buffer, size_t capacity)
+      : buffer_(buffer), capacity_(capacity) {}
+  explicit Writer(std::string* string) : string_(string) {}
+
+  // terminates the buffer, and returns the length of the whole output.
+  size_t Finish() {
+    if (capacity_) {
+      buffer_[std::min(length_, capacity_ - 1)] = '\0';
+    }
+    return length_;
+  }
+
+  Writer& operator<<(const char* string) {
+    Write(string, strlen(string));
+    return *this;
+  }
+
+  Writer& operator<<(char c) {
+    Write(&c, 1);
+    return *this;
+  }
+
+  Writer& operator<<(bool value) { return *this << (value ? "1" : "0"); }
+
+  // only std::hex and std::dec are used.
+  Writer& operator<<(std::ios_base& (*manipulator)(std::ios_base&)) {
+    hex_ = manipulator == static_cast<std::ios_base& (*)(std::ios_base&)>(
+                              std::hex);
+    return *this;
+  }
+
+  template <typename T, typename std::enable_if<std::is_integral<T>::value,
+                                                int>::type = 0>
+  Writer& operator<<(T value) {
+    typedef typename std::make_unsigned<T>::type Unsigned;
+    if (!hex_ && std::is_signed<T>::value && value < 0) {
+      Write("-", 1);
+      WriteUnsigned(static_cast<Unsigned>(0) - static_cast<Unsigned>(value));
+    } else {
+      WriteUnsigned(static_cast<Unsigned>(value));
+    }
+    return *this;
+  }
+
+  Writer& operator<<(const Operand& opnd);
+};
+
+template <typename Stream>
+static void PrintImmediate(Stream& stream, const Immediate& opnd) {
   stream << "#0x" << std::hex << opnd.value;
 }
 
-static void PrintSignedImmediate(std::ostream& stream, const Immediate& opnd) {
+template <typename Stream>
+static void PrintSignedImmediate(Stream& stream, const Immediate& opnd) {
   if (opnd.value & (1ull << (opnd.size - 1))) {
     stream << "#-0x" << std::hex << (~opnd.value) + 1ull;
   } else {
@@ -32,7 +130,8 @@ static void PrintSignedImmediate(std::ostream& stream, const Immediate& opnd) {
   }
 }
 
-static void PrintPcRelativeOffset(std::ostream& stream, const Instruction& insn,
+template <typename Stream>
+static void PrintPcRelativeOffset(Stream& stream, const Instruction& insn,
                                   const Immediate& opnd) {
   if (opnd.value & (1ull << (opnd.size - 1))) {
     stream << "#0x" << std::hex << insn.address - ((~opnd.value) + 1ull);
@@ -41,7 +140,8 @@ static void PrintPcRelativeOffset(std::ostream& stream, const Instruction& insn,
   }
 }
 
-static void PrintRegister(std::ostream& stream, const Register& opnd) {
+template <typename Stream>
+static void PrintRegister(Stream& stream, const Register& opnd) {
   if (Register::kX0 <= opnd.name && opnd.name <= Register::kXzr) {
     if (opnd.size <= 32) {
       stream << "w";
@@ -81,7 +181,8 @@ static void PrintRegister(std::ostream& stream, const Register& opnd) {
   }
 }
 
-static void PrintSystemRegister(std::ostream& stream,
+template <typename Stream>
+static void PrintSystemRegister(Stream& stream,
                                 const SystemRegister& opnd) {
   if (opnd.name == SystemRegister::kUnknown) {
     stream << "S" << std::dec << (int)opnd.op0;
@@ -102,7 +203,8 @@ static void PrintSystemRegister(std::ostream& stream,
   }
 }
 
-static void PrintShift(std::ostream& stream, const Shift& opnd) {
+template <typename Stream>
+static void PrintShift(Stream& stream, const Shift& opnd) {
   if (opnd.type != Shift::kNone) {
     switch (opnd.type) {
       case Shift::kLsl: {
@@ -133,7 +235,8 @@ static void PrintShift(std::ostream& stream, const Shift& opnd) {
   }
 }
 
-static void PrintExtend(std::ostream& stream, const Extend& opnd) {
+template <typename Stream>
+static void PrintExtend(Stream& stream, const Extend& opnd) {
   if (opnd.type != Extend::kNone) {
     switch (opnd.type) {
       case Extend::kUxtb: {
@@ -184,7 +287,8 @@ static void PrintExtend(std::ostream& stream, const Extend& opnd) {
   }
 }
 
-static void PrintImmediateOffset(std::ostream& stream,
+template <typename Stream>
+static void PrintImmediateOffset(Stream& stream,
                                  const ImmediateOffset& opnd) {
   stream << "[" << opnd.base;
   if (opnd.writeback && opnd.post_index) {
@@ -205,7 +309,8 @@ static void PrintImmediateOffset(std::ostream& stream,
   }
 }
 
-static void PrintRegisterOffset(std::ostream& stream,
+template <typename Stream>
+static void PrintRegisterOffset(Stream& stream,
                                 const RegisterOffset& opnd) {
   stream << "[" << opnd.base;
   if (opnd.writeback && opnd.post_index) {
@@ -222,8 +327,8 @@ static void PrintRegisterOffset(std::ostream& stream,
   }
 }
 
-static void PrintOperands(std::ostream& stream,
-                          const std::vector<Operand>& opnds) {
+template <typename Stream>
+static void PrintOperands(Stream& stream, const Operands& opnds) {
   for (size_t i = 0; i < opnds.size(); ++i) {
     if (i != 0 && !absl::holds_alternative<Shift>(opnds[i])) {
       stream << ", ";
@@ -232,15 +337,17 @@ static void PrintOperands(std::ostream& stream,
   }
 }
 
-static void PrintConditionCode(std::ostream& stream, ConditionCode cc) {
-  static std::vector<std::string> condition_codes = {
+template <typename Stream>
+static void PrintConditionCode(Stream& stream, ConditionCode cc) {
+  static const char* const condition_codes[] = {
       "eq", "ne", "cs", "cc", "mi", "pl", "vs", "vc",
       "hi", "ls", "ge", "lt", "gt", "le", "al", "al"};
 
   stream << condition_codes[cc];
 }
 
-static void PrintPrefetchOp(std::ostream& stream, uint8_t prfop) {
+template <typename Stream>
+static void PrintPrefetchOp(Stream& stream, uint8_t prfop) {
   if (((prfop & 0b11000) == 0b11000) || ((prfop & 0b00110) == 0b00110)) {
     stream << "#" << std::dec << (int)prfop;
   } else {
@@ -290,7 +397,8 @@ static void PrintPrefetchOp(std::ostream& stream, uint8_t prfop) {
   }
 }
 
-static void PrintBarrierType(std::ostream& stream, uint8_t option) {
+template <typename Stream>
+static void PrintBarrierType(Stream& stream, uint8_t option) {
   if (((option & 0b10) >> 1) == (option & 0b01)) {
     stream << "#" << std::dec << (int)option;
   } else {
@@ -329,7 +437,8 @@ static void PrintBarrierType(std::ostream& stream, uint8_t option) {
   }
 }
 
-static void PrintPcRelativeAddressing(std::ostream& stream,
+template <typename Stream>
+static void PrintPcRelativeAddressing(Stream& stream,
                                       const Instruction& insn) {
   assert(insn.operands.size() == 3);
 
@@ -351,7 +460,8 @@ static void PrintPcRelativeAddressing(std::ostream& stream,
   stream << rd << ", " << imm;
 }
 
-static void PrintAddSubtractImmediate(std::ostream& stream,
+template <typename Stream>
+static void PrintAddSubtractImmediate(Stream& stream,
                                       const Instruction& insn) {
   assert(insn.operands.size() == 4);
 
@@ -388,7 +498,8 @@ static void PrintAddSubtractImmediate(std::ostream& stream,
   }
 }
 
-static void PrintLogicalImmediate(std::ostream& stream,
+template <typename Stream>
+static void PrintLogicalImmediate(Stream& stream,
                                   const Instruction& insn) {
   assert(insn.operands.size() == 3);
 
@@ -434,7 +545,8 @@ static void PrintLogicalImmediate(std::ostream& stream,
   stream << imm;
 }
 
-static void PrintMoveWideImmediate(std::ostream& stream,
+template <typename Stream>
+static void PrintMoveWideImmediate(Stream& stream,
                                    const Instruction& insn) {
   assert(insn.operands.size() == 3);
 
@@ -471,7 +583,8 @@ static void PrintMoveWideImmediate(std::ostream& stream,
   }
 }
 
-static void PrintBitfield(std::ostream& stream, const Instruction& insn) {
+template <typename Stream>
+static void PrintBitfield(Stream& stream, const Instruction& insn) {
   assert(insn.operands.size() == 4);
 
   Register rd = absl::get<Register>(insn.operands[0]);
@@ -528,7 +641,8 @@ static void PrintBitfield(std::ostream& stream, const Instruction& insn) {
   }
 }
 
-static void PrintExtract(std::ostream& stream, const Instruction& insn) {
+template <typename Stream>
+static void PrintExtract(Stream& stream, const Instruction& insn) {
   assert(insn.operands.size() == 4);
 
   Register rd = absl::get<Register>(insn.operands[0]);
@@ -547,7 +661,8 @@ static void PrintExtract(std::ostream& stream, const Instruction& insn) {
   stream << ", #" << std::dec << imm.value;
 }
 
-static void PrintConditionalBranch(std::ostream& stream,
+template <typename Stream>
+static void PrintConditionalBranch(Stream& stream,
                                    const Instruction& insn) {
   assert(insn.operands.size() == 1);
 
@@ -558,7 +673,8 @@ static void PrintConditionalBranch(std::ostream& stream,
   PrintPcRelativeOffset(stream, insn, offset);
 }
 
-static void PrintExceptionGeneration(std::ostream& stream,
+template <typename Stream>
+static void PrintExceptionGeneration(Stream& stream,
                                      const Instruction& insn) {
   assert(insn.operands.size() == 1);
 
@@ -601,7 +717,8 @@ static void PrintExceptionGeneration(std::ostream& stream,
   }
 }
 
-static void PrintSystem(std::ostream& stream, const Instruction& insn) {
+template <typename Stream>
+static void PrintSystem(Stream& stream, const Instruction& insn) {
   switch (insn.opcode) {
     case kNop: {
       stream << "nop";
@@ -763,7 +880,8 @@ static void PrintSystem(std::ostream& stream, const Instruction& insn) {
   }
 }
 
-static void PrintBranchRegister(std::ostream& stream, const Instruction& insn) {
+template <typename Stream>
+static void PrintBranchRegister(Stream& stream, const Instruction& insn) {
   assert(insn.operands.size() >= 1);
 
   Register rn = absl::get<Register>(insn.operands[0]);
@@ -845,7 +963,8 @@ static void PrintBranchRegister(std::ostream& stream, const Instruction& insn) {
   }
 }
 
-static void PrintBranchImmediate(std::ostream& stream,
+template <typename Stream>
+static void PrintBranchImmediate(Stream& stream,
                                  const Instruction& insn) {
   assert(insn.operands.size() == 1);
 
@@ -860,7 +979,8 @@ static void PrintBranchImmediate(std::ostream& stream,
   PrintPcRelativeOffset(stream, insn, offset);
 }
 
-static void PrintCompareAndBranch(std::ostream& stream,
+template <typename Stream>
+static void PrintCompareAndBranch(Stream& stream,
                                   const Instruction& insn) {
   assert(insn.operands.size() == 2);
 
@@ -876,7 +996,8 @@ static void PrintCompareAndBranch(std::ostream& stream,
   PrintPcRelativeOffset(stream, insn, offset);
 }
 
-static void PrintTestAndBranch(std::ostream& stream, const Instruction& insn) {
+template <typename Stream>
+static void PrintTestAndBranch(Stream& stream, const Instruction& insn) {
   assert(insn.operands.size() == 3);
 
   Immediate bit = absl::get<Immediate>(insn.operands[1]);
@@ -892,7 +1013,8 @@ static void PrintTestAndBranch(std::ostream& stream, const Instruction& insn) {
   PrintPcRelativeOffset(stream, insn, offset);
 }
 
-static void PrintLoadStoreExclusive(std::ostream& stream,
+template <typename Stream>
+static void PrintLoadStoreExclusive(Stream& stream,
                                     const Instruction& insn) {
   bool pair = false;
   uint8_t size = 64;
@@ -972,7 +1094,8 @@ static void PrintLoadStoreExclusive(std::ostream& stream,
   PrintOperands(stream, insn.operands);
 }
 
-static void PrintLoadLiteral(std::ostream& stream, const Instruction& insn) {
+template <typename Stream>
+static void PrintLoadLiteral(Stream& stream, const Instruction& insn) {
   assert(insn.operands.size() == 2);
 
   ImmediateOffset imm_off = absl::get<ImmediateOffset>(insn.operands[1]);
@@ -996,7 +1119,8 @@ static void PrintLoadLiteral(std::ostream& stream, const Instruction& insn) {
   PrintSignedImmediate(stream, imm_off.offset);
 }
 
-static void PrintLoadStorePair(std::ostream& stream, const Instruction& insn) {
+template <typename Stream>
+static void PrintLoadStorePair(Stream& stream, const Instruction& insn) {
   assert(insn.operands.size() == 3);
 
   if (insn.opcode == kSimdLdp || insn.opcode == kLdp) {
@@ -1016,7 +1140,8 @@ static void PrintLoadStorePair(std::ostream& stream, const Instruction& insn) {
   PrintOperands(stream, insn.operands);
 }
 
-static void PrintLoadStore(std::ostream& stream, const Instruction& insn) {
+template <typename Stream>
+static void PrintLoadStore(Stream& stream, const Instruction& insn) {
   assert(insn.operands.size() == 2);
   uint8_t size = 0;
 
@@ -1077,7 +1202,8 @@ static void PrintLoadStore(std::ostream& stream, const Instruction& insn) {
   }
 }
 
-static void PrintDataProcessingTwoSource(std::ostream& stream,
+template <typename Stream>
+static void PrintDataProcessingTwoSource(Stream& stream,
                                          const Instruction& insn) {
   assert(insn.operands.size() == 3);
 
@@ -1149,7 +1275,8 @@ static void PrintDataProcessingTwoSource(std::ostream& stream,
   PrintOperands(stream, insn.operands);
 }
 
-static void PrintDataProcessingOneSource(std::ostream& stream,
+template <typename Stream>
+static void PrintDataProcessingOneSource(Stream& stream,
                                          const Instruction& insn) {
   assert(insn.operands.size() == 2);
 
@@ -1258,7 +1385,8 @@ static void PrintDataProcessingOneSource(std::ostream& stream,
   }
 }
 
-static void PrintLogicalShiftedRegister(std::ostream& stream,
+template <typename Stream>
+static void PrintLogicalShiftedRegister(Stream& stream,
                                         const Instruction& insn) {
   assert(insn.operands.size() == 4);
 
@@ -1317,7 +1445,8 @@ static void PrintLogicalShiftedRegister(std::ostream& stream,
   PrintOperands(stream, insn.operands);
 }
 
-static void PrintAddSubtractShiftedRegister(std::ostream& stream,
+template <typename Stream>
+static void PrintAddSubtractShiftedRegister(Stream& stream,
                                             const Instruction& insn) {
   assert(insn.operands.size() == 4);
 
@@ -1355,7 +1484,8 @@ static void PrintAddSubtractShiftedRegister(std::ostream& stream,
   }
 }
 
-static void PrintAddSubtractExtendedRegister(std::ostream& stream,
+template <typename Stream>
+static void PrintAddSubtractExtendedRegister(Stream& stream,
                                              const Instruction& insn) {
   assert(insn.operands.size() == 4);
 
@@ -1387,7 +1517,8 @@ static void PrintAddSubtractExtendedRegister(std::ostream& stream,
   }
 }
 
-static void PrintAddSubtractWithCarry(std::ostream& stream,
+template <typename Stream>
+static void PrintAddSubtractWithCarry(Stream& stream,
                                       const Instruction& insn) {
   assert(insn.operands.size() == 3);
 
@@ -1418,7 +1549,8 @@ static void PrintAddSubtractWithCarry(std::ostream& stream,
   }
 }
 
-static void PrintConditionalCompare(std::ostream& stream,
+template <typename Stream>
+static void PrintConditionalCompare(Stream& stream,
                                     const Instruction& insn) {
   assert(insn.operands.size() == 3);
 
@@ -1433,7 +1565,8 @@ static void PrintConditionalCompare(std::ostream& stream,
   PrintConditionCode(stream, insn.cc);
 }
 
-static void PrintConditionalSelect(std::ostream& stream,
+template <typename Stream>
+static void PrintConditionalSelect(Stream& stream,
                                    const Instruction& insn) {
   assert(insn.operands.size() == 3);
 
@@ -1473,7 +1606,8 @@ static void PrintConditionalSelect(std::ostream& stream,
   PrintConditionCode(stream, insn.cc);
 }
 
-static void PrintDataProcessingThreeSource(std::ostream& stream,
+template <typename Stream>
+static void PrintDataProcessingThreeSource(Stream& stream,
                                            const Instruction& insn) {
   assert(insn.operands.size() == 4);
 
@@ -1544,7 +1678,8 @@ static void PrintDataProcessingThreeSource(std::ostream& stream,
   }
 }
 
-std::ostream& operator<<(std::ostream& stream, const Instruction& insn) {
+template <typename Stream>
+static void Print(Stream& stream, const Instruction& insn) {
   if (insn.opcode <= kAdrp) {
     PrintPcRelativeAddressing(stream, insn);
   } else if (insn.opcode <= kSubImmediate) {
@@ -1600,11 +1735,10 @@ std::ostream& operator<<(std::ostream& stream, const Instruction& insn) {
   } else {
     stream << "invalid";
   }
-
-  return stream;
 }
 
-std::ostream& operator<<(std::ostream& stream, const Operand& opnd) {
+template <typename Stream>
+static void Print(Stream& stream, const Operand& opnd) {
   switch (opnd.index()) {
     case kImmediate: {
       PrintImmediate(stream, absl::get<Immediate>(opnd));
@@ -1637,9 +1771,34 @@ std::ostream& operator<<(std::ostream& stream, const Operand& opnd) {
     default:
       stream << "invalid";
   }
+}
+
+Writer& Writer::operator<<(const Operand& opnd) {
+  Print(*this, opnd);
+  return *this;
+}
+
+std::ostream& operator<<(std::ostream& stream, const Instruction& insn) {
+  Print(stream, insn);
+  return stream;
+}
 
+std::ostream& operator<<(std::ostream& stream, const Operand& opnd) {
+  Print(stream, opnd);
   return stream;
 }
+
+size_t PrintInstruction(const Instruction& insn, char* buffer,
+                        size_t buffer_len) {
+  Writer writer(buffer, buffer_len);
+  Print(writer, insn);
+  return writer.Finish();
+}
+
+void PrintInstruction(const Instruction& insn, std::string* output) {
+  Writer writer(output);
+  Print(writer, insn);
+}
 }  // namespace decoder
 }  // namespace aarch64
 }  // namespace reil
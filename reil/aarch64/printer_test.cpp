@@ -0,0 +1,80 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "reil/aarch64/decoder.h"
+
+namespace reil {
+namespace test {
+
+std::mt19937_64 prng;
+
+static std::string Print(const aarch64::decoder::Instruction &insn) {
+  std::stringstream stream;
+  stream << insn;
+  return stream.str();
+}
+
+TEST(AArch64Printer, MatchesStream) {
+  std::string appended;
+  std::string expected_appended;
+  for (int i = 0; i < 0x40000; ++i) {
+    uint64_t address = prng() & ~0b11ull;
+    uint32_t opcode = prng();
+    auto insn = aarch64::decoder::DecodeInstruction(address, opcode);
+    if (insn.opcode == aarch64::decoder::kUnallocated) {
+      continue;
+    }
+
+    std::string expected = Print(insn);
+    char buffer[128];
+    ASSERT_EQ(aarch64::decoder::PrintInstruction(insn, buffer, sizeof(buffer)),
+              expected.size());
+    ASSERT_EQ(std::string(buffer), expected) << std::hex << opcode;
+
+    aarch64::decoder::PrintInstruction(insn, &appended);
+    expected_appended += expected;
+  }
+  ASSERT_EQ(appended, expected_appended);
+}
+
+TEST(AArch64Printer, Truncates) {
+  // add x0, x1, #0x10
+  auto insn = aarch64::decoder::DecodeInstruction(0x1000, 0x91004020);
+  std::string expected = Print(insn);
+  ASSERT_EQ(expected, "add x0, x1, #0x10");
+
+  char buffer[8];
+  memset(buffer, 'z', sizeof(buffer));
+  ASSERT_EQ(aarch64::decoder::PrintInstruction(insn, buffer, sizeof(buffer)),
+            expected.size());
+  ASSERT_EQ(std::string(buffer), expected.substr(0, 7));
+
+  ASSERT_EQ(aarch64::decoder::PrintInstruction(insn, nullptr, 0),
+            expected.size());
+}
+
+}  // namespace test
+}  // namespace reil
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,163 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "reil/aarch64/translator.h"
+
+namespace reil {
+namespace test {
+
+std::mt19937_64 prng;
+
+template <typename Instructions>
+static std::string Print(const Instructions &reil) {
+  std::stringstream stream;
+  for (const auto &ri : reil) {
+    stream << ri << std::endl;
+  }
+  return stream.str();
+}
+
+static void ExpectSameTranslation(const TranslationBuffer &buffer,
+                                  const std::vector<uint8_t> &bytes,
+                                  uint32_t flags) {
+  ASSERT_EQ(buffer.size(), bytes.size() / 4);
+  for (size_t i = 0; i < buffer.size(); ++i) {
+    auto expected = aarch64::TranslateInstruction(0x1000 + i * 4,
+                                                  &bytes[i * 4], 4, flags);
+    auto view = buffer[i];
+    ASSERT_EQ(view.address, expected.address);
+    ASSERT_EQ(view.size, expected.size);
+    ASSERT_EQ(view.mnemonic, expected.mnemonic.str());
+    ASSERT_EQ(Print(view.reil), Print(expected.reil)) << expected.mnemonic;
+
+    auto ni = buffer.Get(i);
+    ASSERT_EQ(ni.mnemonic.str(), expected.mnemonic.str());
+    ASSERT_EQ(Print(ni.reil), Print(expected.reil));
+  }
+}
+
+TEST(AArch64TranslateRange, MatchesTranslateInstruction) {
+  std::vector<uint8_t> bytes(4 * 4096);
+  for (auto &byte : bytes) {
+    byte = prng();
+  }
+
+  for (uint32_t flags : std::vector<uint32_t>{
+           aarch64::kDefaultFlags, aarch64::kDefaultFlags | kNoMnemonics}) {
+    TranslationBuffer buffer;
+    ASSERT_EQ(aarch64::TranslateRange(0x1000, bytes.data(), bytes.size(),
+                                      &buffer, flags),
+              bytes.size());
+    ExpectSameTranslation(buffer, bytes, flags);
+  }
+}
+
+TEST(AArch64TranslateRange, AppendsAndClears) {
+  // add x0, x0, #1; b.ne #-4, with a trailing partial instruction.
+  std::vector<uint8_t> bytes = {0x00, 0x04, 0x00, 0x91,
+                                0xe1, 0xff, 0xff, 0x54, 0x00};
+
+  TranslationBuffer buffer;
+  ASSERT_EQ(aarch64::TranslateRange(0x1000, bytes.data(), 4, &buffer), 4);
+  ASSERT_EQ(aarch64::TranslateRange(0x1004, bytes.data() + 4, 5, &buffer),
+            4);
+  bytes.pop_back();
+  ExpectSameTranslation(buffer, bytes, aarch64::kDefaultFlags);
+
+  buffer.Clear();
+  ASSERT_TRUE(buffer.empty());
+  ASSERT_EQ(aarch64::TranslateRange(0x1000, bytes.data(), 4, &buffer), 4);
+  ASSERT_EQ(buffer.size(), 1);
+  ASSERT_EQ(buffer[0].address, 0x1000);
+}
+
+TEST(AArch64TranslateRange, TranslateBlockStopsAtBranch) {
+  // add x0, x0, #1; b.ne #-4; add x0, x0, #1
+  std::vector<uint8_t> bytes = {0x00, 0x04, 0x00, 0x91, 0xe1, 0xff,
+                                0xff, 0x54, 0x00, 0x04, 0x00, 0x91};
+
+  TranslationBuffer buffer;
+  ASSERT_EQ(aarch64::TranslateBlock(0x1000, bytes.data(), bytes.size(),
+                                    &buffer),
+            8);
+  bytes.resize(8);
+  ExpectSameTranslation(buffer, bytes, aarch64::kDefaultFlags);
+
+  // without a branch, the block runs to the end of the range.
+  buffer.Clear();
+  ASSERT_EQ(aarch64::TranslateBlock(0x1000, bytes.data(), 4, &buffer), 4);
+  ASSERT_EQ(buffer.size(), 1);
+}
+
+// counts how many times the mnemonic is formatted.
+class CountingMnemonic : public Mnemonic::Source {
+  int *count_;
+
+ public:
+  explicit CountingMnemonic(int *count) : count_(count) {}
+
+  void Print(std::ostream &stream) const override {
+    ++*count_;
+    stream << "mnemonic";
+  }
+
+  size_t size() const override { return sizeof(*this); }
+};
+
+TEST(AArch64TranslateInstruction, FormatsMnemonicWhenPrinted) {
+  int count = 0;
+  NativeInstruction ni;
+  ni.mnemonic = Mnemonic(std::make_shared<CountingMnemonic>(&count));
+  NativeInstruction copy = ni;
+  ASSERT_FALSE(copy.mnemonic.empty());
+  ASSERT_EQ(count, 0);
+
+  std::stringstream stream;
+  stream << copy.mnemonic;
+  ASSERT_EQ(stream.str(), "mnemonic");
+  ASSERT_EQ(count, 1);
+  ASSERT_EQ(ni.mnemonic.str(), "mnemonic");
+  ASSERT_EQ(count, 2);
+
+  // translations from the encoding decode it again to format the mnemonic.
+  // add x0, x1, #0x10
+  std::vector<uint8_t> bytes = {0x20, 0x40, 0x00, 0x91};
+  auto di = aarch64::decoder::DecodeInstruction(0x1000, 0x91004020);
+  std::string expected;
+  aarch64::decoder::PrintInstruction(di, &expected);
+
+  auto encoded = aarch64::TranslateInstruction(0x1000, bytes);
+  ASSERT_EQ(encoded.mnemonic.str(), expected);
+  ASSERT_EQ(aarch64::TranslateInstruction(di).mnemonic.str(), expected);
+
+  encoded = aarch64::TranslateInstruction(
+      0x1000, bytes, aarch64::kDefaultFlags | kNoMnemonics);
+  ASSERT_TRUE(encoded.mnemonic.empty());
+}
+
+}  // namespace test
+}  // namespace reil
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
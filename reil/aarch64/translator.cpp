@@ -17,7 +17,11 @@
 #include <cassert>
 #include <cstring>
 #include <map>
-#include <sstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
 
 #include "reil/immediate.h"
 
@@ -25,50 +29,40 @@ namespace reil {
 namespace aarch64 {
 
 static Register X_[] = {
-    Register(64, kX0, "x0"),   Register(64, kX1, "x1"),
-    Register(64, kX2, "x2"),   Register(64, kX3, "x3"),
-    Register(64, kX4, "x4"),   Register(64, kX5, "x5"),
-    Register(64, kX6, "x6"),   Register(64, kX7, "x7"),
-    Register(64, kX8, "x8"),   Register(64, kX9, "x9"),
-    Register(64, kX10, "x10"), Register(64, kX11, "x11"),
-    Register(64, kX12, "x12"), Register(64, kX13, "x13"),
-    Register(64, kX14, "x14"), Register(64, kX15, "x15"),
-    Register(64, kX16, "x16"), Register(64, kX17, "x17"),
-    Register(64, kX18, "x18"), Register(64, kX19, "x19"),
-    Register(64, kX20, "x20"), Register(64, kX21, "x21"),
-    Register(64, kX22, "x22"), Register(64, kX23, "x23"),
-    Register(64, kX24, "x24"), Register(64, kX25, "x25"),
-    Register(64, kX26, "x26"), Register(64, kX27, "x27"),
-    Register(64, kX28, "x28"), Register(64, kX29, "x29"),
-    Register(64, kX30, "x30"),
+    Register(64, kX0),  Register(64, kX1),  Register(64, kX2),
+    Register(64, kX3),  Register(64, kX4),  Register(64, kX5),
+    Register(64, kX6),  Register(64, kX7),  Register(64, kX8),
+    Register(64, kX9),  Register(64, kX10), Register(64, kX11),
+    Register(64, kX12), Register(64, kX13), Register(64, kX14),
+    Register(64, kX15), Register(64, kX16), Register(64, kX17),
+    Register(64, kX18), Register(64, kX19), Register(64, kX20),
+    Register(64, kX21), Register(64, kX22), Register(64, kX23),
+    Register(64, kX24), Register(64, kX25), Register(64, kX26),
+    Register(64, kX27), Register(64, kX28), Register(64, kX29),
+    Register(64, kX30),
 };
 
-static Register sp_(64, kSp, "sp");
-static Register pc_(64, kPc, "pc");
+static Register sp_(64, kSp);
+static Register pc_(64, kPc);
 
 static Register V_[] = {
-    Register(128, kV0, "v0"),   Register(128, kV1, "v1"),
-    Register(128, kV2, "v2"),   Register(128, kV3, "v3"),
-    Register(128, kV4, "v4"),   Register(128, kV5, "v5"),
-    Register(128, kV6, "v6"),   Register(128, kV7, "v7"),
-    Register(128, kV8, "v8"),   Register(128, kV9, "v9"),
-    Register(128, kV10, "v10"), Register(128, kV11, "v11"),
-    Register(128, kV12, "v12"), Register(128, kV13, "v13"),
-    Register(128, kV14, "v14"), Register(128, kV15, "v15"),
-    Register(128, kV16, "v16"), Register(128, kV17, "v17"),
-    Register(128, kV18, "v18"), Register(128, kV19, "v19"),
-    Register(128, kV20, "v20"), Register(128, kV21, "v21"),
-    Register(128, kV22, "v22"), Register(128, kV23, "v23"),
-    Register(128, kV24, "v24"), Register(128, kV25, "v25"),
-    Register(128, kV26, "v26"), Register(128, kV27, "v27"),
-    Register(128, kV28, "v28"), Register(128, kV29, "v29"),
-    Register(128, kV30, "v30"), Register(128, kV31, "v31"),
+    Register(128, kV0),  Register(128, kV1),  Register(128, kV2),
+    Register(128, kV3),  Register(128, kV4),  Register(128, kV5),
+    Register(128, kV6),  Register(128, kV7),  Register(128, kV8),
+    Register(128, kV9),  Register(128, kV10), Register(128, kV11),
+    Register(128, kV12), Register(128, kV13), Register(128, kV14),
+    Register(128, kV15), Register(128, kV16), Register(128, kV17),
+    Register(128, kV18), Register(128, kV19), Register(128, kV20),
+    Register(128, kV21), Register(128, kV22), Register(128, kV23),
+    Register(128, kV24), Register(128, kV25), Register(128, kV26),
+    Register(128, kV27), Register(128, kV28), Register(128, kV29),
+    Register(128, kV30), Register(128, kV31),
 };
 
-static Register n_(8, kN, "n");
-static Register z_(8, kZ, "z");
-static Register c_(8, kC, "c");
-static Register v_(8, kV, "v");
+static Register n_(8, kN);
+static Register z_(8, kZ);
+static Register c_(8, kC);
+static Register v_(8, kV);
 
 class Translation : public reil::Translation {
  private:
@@ -128,6 +122,8 @@ class Translation : public reil::Translation {
 
  public:
   explicit Translation(uint32_t flags, const decoder::Instruction& di);
+  Translation(uint32_t flags, const decoder::Instruction& di,
+              std::vector<reil::Instruction>* output);
   virtual ~Translation();
 
   bool Translate();
@@ -136,6 +132,10 @@ class Translation : public reil::Translation {
 Translation::Translation(uint32_t flags, const decoder::Instruction& di)
     : reil::Translation(flags), di_(di) {}
 
+Translation::Translation(uint32_t flags, const decoder::Instruction& di,
+                         std::vector<reil::Instruction>* output)
+    : reil::Translation(flags, output), di_(di) {}
+
 Translation::~Translation() {}
 
 Operand Translation::Register(decoder::Register::Name name) {
@@ -1631,18 +1631,31 @@ uint8_t RegisterIndex(std::string name) {
   return register_names_.at(name);
 }
 
-NativeInstruction TranslateInstruction(const decoder::Instruction& di, uint32_t flags) {
+// the mnemonic of an instruction translated from its encoding only keeps the
+// encoding, and decodes it again if the mnemonic is ever needed.
+class EncodedMnemonic : public Mnemonic::Source {
+  uint64_t address_;
+  uint32_t opcode_;
+
+ public:
+  EncodedMnemonic(uint64_t address, uint32_t opcode)
+      : address_(address), opcode_(opcode) {}
+
+  void Print(std::ostream& stream) const override {
+    stream << decoder::DecodeInstruction(address_, opcode_);
+  }
+
+  size_t size() const override { return sizeof(*this); }
+};
+
+static NativeInstruction TranslateInstruction(const decoder::Instruction& di,
+                                              uint32_t flags,
+                                              Mnemonic mnemonic) {
   NativeInstruction ni;
 
   ni.address = di.address;
   ni.size = 4;
-
-  // generate mnemonic if necessary
-  if (!(flags & kNoMnemonics)) {
-    std::ostringstream mnemonic;
-    mnemonic << di;
-    ni.mnemonic = mnemonic.str();
-  }
+  ni.mnemonic = std::move(mnemonic);
 
   // perform translation
   Translation translation(flags, di);
@@ -1655,6 +1668,70 @@ NativeInstruction TranslateInstruction(const decoder::Instruction& di, uint32_t
   return ni;
 }
 
+NativeInstruction TranslateInstruction(const decoder::Instruction& di, uint32_t flags) {
+  // without the encoding there is nothing smaller to keep than the formatted
+  // mnemonic itself.
+  std::string mnemonic;
+  if (!(flags & kNoMnemonics)) {
+    decoder::PrintInstruction(di, &mnemonic);
+  }
+  return TranslateInstruction(di, flags, Mnemonic(std::move(mnemonic)));
+}
+
+static void TranslateInstruction(const decoder::Instruction& di,
+                                 uint32_t flags,
+                                 std::vector<reil::Instruction>* output) {
+  size_t begin = output->size();
+  Translation translation(flags, di, output);
+  if (translation.Translate()) {
+    translation.Resolve();
+  } else {
+    output->erase(output->begin() + begin, output->end());
+    output->push_back(Unkn());
+  }
+}
+
+static size_t Translate(uint64_t address, const uint8_t* bytes,
+                        size_t bytes_len, TranslationBuffer* buffer,
+                        uint32_t flags, bool stop_at_block_end) {
+  bool mnemonics = !(flags & kNoMnemonics);
+  std::vector<reil::Instruction>* reil = buffer->reil();
+
+  size_t offset = 0;
+  while (offset + sizeof(uint32_t) <= bytes_len) {
+    uint32_t opcode;
+    memcpy(&opcode, bytes + offset, sizeof(opcode));
+    auto di = decoder::DecodeInstruction(address + offset, opcode);
+
+    if (mnemonics) {
+      decoder::PrintInstruction(di, buffer->mnemonics());
+    }
+    size_t reil_begin = reil->size();
+    TranslateInstruction(di, flags, reil);
+    buffer->Commit(address + offset, sizeof(opcode));
+    offset += sizeof(opcode);
+
+    if (stop_at_block_end &&
+        EndsBasicBlock(absl::Span<const reil::Instruction>(
+            reil->data() + reil_begin, reil->size() - reil_begin))) {
+      break;
+    }
+  }
+  return offset;
+}
+
+size_t TranslateRange(uint64_t address, const uint8_t* bytes,
+                      size_t bytes_len, TranslationBuffer* buffer,
+                      uint32_t flags) {
+  return Translate(address, bytes, bytes_len, buffer, flags, false);
+}
+
+size_t TranslateBlock(uint64_t address, const uint8_t* bytes,
+                      size_t bytes_len, TranslationBuffer* buffer,
+                      uint32_t flags) {
+  return Translate(address, bytes, bytes_len, buffer, flags, true);
+}
+
 NativeInstruction TranslateInstruction(uint64_t address, std::vector<uint8_t> bytes,
                             uint32_t flags) {
   return TranslateInstruction(address, bytes.data(), bytes.size(), flags);
@@ -1671,7 +1748,11 @@ NativeInstruction TranslateInstruction(uint64_t address, const uint8_t* bytes,
   // decode instruction
   auto di = decoder::DecodeInstruction(address, opcode);
 
-  return TranslateInstruction(di, flags);
+  Mnemonic mnemonic;
+  if (!(flags & kNoMnemonics)) {
+    mnemonic = Mnemonic(std::make_shared<EncodedMnemonic>(address, opcode));
+  }
+  return TranslateInstruction(di, flags, std::move(mnemonic));
 }
 }  // namespace aarch64
 }  // namespace reil
@@ -114,6 +114,19 @@ NativeInstruction TranslateInstruction(uint64_t address, std::vector<uint8_t> by
                             uint32_t flags = kDefaultFlags);
 NativeInstruction TranslateInstruction(uint64_t address, const uint8_t* bytes,
                             size_t bytes_len, uint32_t flags = kDefaultFlags);
+
+// translates every whole instruction in bytes, appending them to buffer, and
+// returns the number of bytes translated. nothing is allocated per
+// instruction once the buffer has grown to fit the range.
+size_t TranslateRange(uint64_t address, const uint8_t* bytes,
+                      size_t bytes_len, TranslationBuffer* buffer,
+                      uint32_t flags = kDefaultFlags);
+
+// as TranslateRange, but stops after the first instruction that ends a basic
+// block (a branch, call or return, a system call or an unknown instruction).
+size_t TranslateBlock(uint64_t address, const uint8_t* bytes,
+                      size_t bytes_len, TranslationBuffer* buffer,
+                      uint32_t flags = kDefaultFlags);
 }  // namespace aarch64
 }  // namespace reil
 
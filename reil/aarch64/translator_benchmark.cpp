@@ -0,0 +1,258 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures decoder, translator and printer throughput over the executable
+// mappings of a memory image:
+//
+//   aarch64_translator_benchmark [benchmark flags] image.mem
+//
+// Every stage is run over the whole corpus and then over the instructions of
+// each top level decoder group on its own, so the time spent in each group is
+// the group's instruction count times its time per instruction.
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "memory_image/memory_image.h"
+#include "reil/aarch64/decoder.h"
+#include "reil/aarch64/translator.h"
+
+namespace reil {
+namespace aarch64 {
+
+struct Word {
+  uint64_t address;
+  uint32_t opcode;
+};
+
+static const char *GroupName(decoder::Group group) {
+  switch (group) {
+    case decoder::Group::kUnallocated:
+      return "Unallocated";
+    case decoder::Group::kDataProcessingImmediate:
+      return "DataProcessingImmediate";
+    case decoder::Group::kBranchExceptionGeneratingSystem:
+      return "BranchExceptionGeneratingSystem";
+    case decoder::Group::kLoadStore:
+      return "LoadStore";
+    case decoder::Group::kDataProcessingRegister:
+      return "DataProcessingRegister";
+  }
+  abort();
+}
+
+// discards everything written to it, so that printing is measured without
+// the cost of growing a string.
+class NullBuffer : public std::streambuf {
+ protected:
+  int overflow(int c) override { return c; }
+  std::streamsize xsputn(const char *, std::streamsize count) override {
+    return count;
+  }
+};
+
+static void BM_Decode(benchmark::State &state,
+                      const std::vector<Word> *words) {
+  size_t i = 0;
+  for (auto _ : state) {
+    const Word &word = (*words)[i];
+    benchmark::DoNotOptimize(
+        decoder::DecodeInstruction(word.address, word.opcode));
+    if (++i == words->size()) {
+      i = 0;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["instructions"] = words->size();
+}
+
+static void BM_Translate(benchmark::State &state,
+                         const std::vector<decoder::Instruction> *insns,
+                         uint32_t flags) {
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(TranslateInstruction((*insns)[i], flags));
+    if (++i == insns->size()) {
+      i = 0;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["instructions"] = insns->size();
+}
+
+// translates the corpus in ranges of kRangeSize instructions, reusing one
+// buffer, to measure translation without per-instruction allocation.
+static constexpr size_t kRangeSize = 1024;
+
+static void BM_TranslateRange(benchmark::State &state,
+                              const std::vector<Word> *words,
+                              uint32_t flags) {
+  std::vector<uint8_t> bytes;
+  for (const auto &word : *words) {
+    for (int i = 0; i < 4; ++i) {
+      bytes.push_back(word.opcode >> (i * 8));
+    }
+  }
+
+  TranslationBuffer buffer;
+  size_t i = 0;
+  int64_t translated = 0;
+  for (auto _ : state) {
+    size_t count = std::min(kRangeSize, words->size() - i);
+    buffer.Clear();
+    TranslateRange((*words)[i].address, &bytes[i * 4], count * 4, &buffer,
+                   flags);
+    benchmark::DoNotOptimize(buffer);
+    translated += count;
+    i += count;
+    if (i == words->size()) {
+      i = 0;
+    }
+  }
+  // the last range of the corpus may be shorter than kRangeSize.
+  state.SetItemsProcessed(translated);
+  state.counters["instructions"] = words->size();
+}
+
+static void BM_Print(benchmark::State &state,
+                     const std::vector<decoder::Instruction> *insns) {
+  NullBuffer buffer;
+  std::ostream stream(&buffer);
+  size_t i = 0;
+  for (auto _ : state) {
+    stream << (*insns)[i];
+    if (++i == insns->size()) {
+      i = 0;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["instructions"] = insns->size();
+}
+
+static void BM_PrintBuffer(benchmark::State &state,
+                           const std::vector<decoder::Instruction> *insns) {
+  char buffer[256];
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        decoder::PrintInstruction((*insns)[i], buffer, sizeof(buffer)));
+    if (++i == insns->size()) {
+      i = 0;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["instructions"] = insns->size();
+}
+
+struct Corpus {
+  std::vector<Word> words;
+  std::vector<decoder::Instruction> insns;
+};
+
+static void RegisterBenchmarks(const std::string &name, const Corpus &corpus) {
+  benchmark::RegisterBenchmark(("BM_Decode/" + name).c_str(), BM_Decode,
+                               &corpus.words);
+  benchmark::RegisterBenchmark(("BM_Translate/" + name).c_str(),
+                               BM_Translate, &corpus.insns, kDefaultFlags);
+  benchmark::RegisterBenchmark(("BM_TranslateNoMnemonics/" + name).c_str(),
+                               BM_Translate, &corpus.insns,
+                               kDefaultFlags | kNoMnemonics);
+  benchmark::RegisterBenchmark(("BM_TranslateRange/" + name).c_str(),
+                               BM_TranslateRange, &corpus.words,
+                               kDefaultFlags);
+  benchmark::RegisterBenchmark(
+      ("BM_TranslateRangeNoMnemonics/" + name).c_str(), BM_TranslateRange,
+      &corpus.words, kDefaultFlags | kNoMnemonics);
+  benchmark::RegisterBenchmark(("BM_Print/" + name).c_str(), BM_Print,
+                               &corpus.insns);
+  benchmark::RegisterBenchmark(("BM_PrintBuffer/" + name).c_str(),
+                               BM_PrintBuffer, &corpus.insns);
+}
+}  // namespace aarch64
+}  // namespace reil
+
+int main(int argc, char **argv) {
+  using namespace reil::aarch64;
+
+  // results are reported as json by default, as for immediate_benchmark.
+  std::string format = "--benchmark_format=json";
+  std::vector<char *> args(argv, argv + argc);
+  args.insert(args.begin() + 1, &format[0]);
+  int args_count = args.size();
+
+  benchmark::Initialize(&args_count, args.data());
+  if (args_count != 2) {
+    std::cerr << "Usage: " << argv[0] << " [benchmark flags] memory_image_proto"
+              << std::endl;
+    return -1;
+  }
+
+  auto memory_image = reil::MemoryImage::Load(args[1]);
+  if (!memory_image) {
+    std::cerr << "Could not load " << args[1] << std::endl;
+    return -1;
+  }
+
+  Corpus all;
+  std::map<decoder::Group, Corpus> groups;
+  for (const auto &mapping : memory_image->mappings()) {
+    if (!mapping.executable) {
+      continue;
+    }
+
+    absl::Span<const uint8_t> bytes;
+    for (size_t offset = 0; offset + 4 <= mapping.size(); offset += 4) {
+      Word word;
+      word.address = mapping.address + offset;
+      if (bytes.size() < 4) {
+        bytes = memory_image->Read(word.address);
+        if (bytes.size() < 4) {
+          std::cerr << "Could not read mapping at 0x" << std::hex
+                    << mapping.address << " offset 0x" << offset << std::dec
+                    << std::endl;
+          break;
+        }
+      }
+      word.opcode = bytes[0] | bytes[1] << 8 | bytes[2] << 16 |
+                    static_cast<uint32_t>(bytes[3]) << 24;
+      bytes.remove_prefix(4);
+      auto insn = decoder::DecodeInstruction(word.address, word.opcode);
+
+      Corpus &group = groups[decoder::DecodeGroup(word.opcode)];
+      group.words.push_back(word);
+      group.insns.push_back(insn);
+      all.words.push_back(word);
+      all.insns.push_back(insn);
+    }
+  }
+
+  if (all.words.empty()) {
+    std::cerr << "No executable mappings in " << args[1] << std::endl;
+    return -1;
+  }
+
+  RegisterBenchmarks("All", all);
+  for (const auto &group : groups) {
+    RegisterBenchmarks(GroupName(group.first), group.second);
+  }
+
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
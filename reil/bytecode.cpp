@@ -0,0 +1,73 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "reil/bytecode.h"
+
+namespace reil {
+static BytecodeOperand CompileOperand(const Operand& op, Bytecode* bc) {
+  BytecodeOperand result;
+  result.type = op.type();
+  switch (op.type()) {
+    case kImmediate: {
+      Immediate imm = op.immediate();
+      result.size = imm.size();
+      if (result.size <= 64) {
+        result.value = static_cast<uint64_t>(imm);
+      } else {
+        result.index = bc->immediates.size();
+        bc->immediates.push_back(imm);
+      }
+    } break;
+
+    case kOffset: {
+      result.index = op.offset().offset;
+    } break;
+
+    case kRegister: {
+      Register reg = op.reg();
+      result.size = reg.size;
+      result.index = reg.index;
+    } break;
+
+    case kTemporary: {
+      Temporary tmp = op.temporary();
+      result.size = tmp.size;
+      result.index = tmp.index;
+    } break;
+
+    default: {
+      // labels are resolved by the translation, so anything else is unused.
+      result.type = kNone;
+    }
+  }
+  return result;
+}
+
+Bytecode CompileBytecode(const NativeInstruction& ni) {
+  Bytecode bc;
+  bc.address = ni.address;
+  bc.size = ni.size;
+  bc.code.reserve(ni.reil.size());
+  for (const Instruction& ri : ni.reil) {
+    BytecodeInstruction bi;
+    bi.opcode = ri.opcode;
+    bi.input0 = CompileOperand(ri.input0, &bc);
+    bi.input1 = CompileOperand(ri.input1, &bc);
+    bi.input2 = CompileOperand(ri.input2, &bc);
+    bi.output = CompileOperand(ri.output, &bc);
+    bc.code.push_back(bi);
+  }
+  return bc;
+}
+}  // namespace reil
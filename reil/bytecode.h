@@ -0,0 +1,58 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef REIL_BYTECODE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "reil/immediate.h"
+#include "reil/reil.h"
+
+namespace reil {
+// A REIL operand resolved for execution: registers and temporaries are reduced
+// to their slot index, and immediates of 64 bits or less are stored inline.
+// Wider immediates are stored in the owning Bytecode's immediates pool, and
+// index is their position there.
+struct BytecodeOperand {
+  uint8_t type = kNone;
+  uint16_t size = 0;
+  uint32_t index = 0;
+  uint64_t value = 0;
+};
+
+struct BytecodeInstruction {
+  Opcode opcode;
+  BytecodeOperand input0;
+  BytecodeOperand input1;
+  BytecodeOperand input2;
+  BytecodeOperand output;
+};
+
+// The REIL translation of a native instruction, lowered to a dense form that
+// the interpreter can execute without dispatching on operand types or
+// constructing Immediates. There is exactly one BytecodeInstruction for each
+// REIL instruction, so Offset targets are unchanged.
+struct Bytecode {
+  uint64_t address = 0;
+  uint8_t size = 0;
+  std::vector<BytecodeInstruction> code;
+  std::vector<Immediate> immediates;
+};
+
+Bytecode CompileBytecode(const NativeInstruction& ni);
+}  // namespace reil
+
+#define REIL_BYTECODE_H_
+#endif  // REIL_BYTECODE_H_
@@ -0,0 +1,146 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "reil/aarch64.h"
+#include "reil/bytecode.h"
+#include "reil/interpreter.h"
+
+namespace reil {
+
+std::mt19937_64 prng;
+
+class WriteRecorder : public TraceSink {
+ public:
+  std::set<std::pair<uint64_t, size_t>> writes;
+
+  void OnMemoryWrite(uint64_t address,
+                     absl::Span<const uint8_t> bytes) override {
+    writes.emplace(address, bytes.size());
+  }
+};
+
+void RandomState(Interpreter& interpreter) {
+  for (uint32_t index = aarch64::kX0; index <= aarch64::kPc; ++index) {
+    interpreter.SetRegister(index, Immediate(64, prng()));
+  }
+  for (uint32_t index = aarch64::kN; index <= aarch64::kV; ++index) {
+    interpreter.SetRegister(index, Immediate(8, prng() & 1));
+  }
+  for (uint32_t index = aarch64::kV0; index <= aarch64::kV31; ++index) {
+    Immediate value(128, prng());
+    value <<= 64;
+    value |= Immediate(128, prng());
+    interpreter.SetRegister(index, value);
+  }
+}
+
+void ExpectSameState(Interpreter& reference, Interpreter& interpreter,
+                     const WriteRecorder& recorder, uint32_t opcode) {
+  for (uint32_t index = aarch64::kX0; index <= aarch64::kV31; ++index) {
+    Immediate expected = reference.GetRegister(index);
+    Immediate actual = interpreter.GetRegister(index);
+    ASSERT_EQ(expected.size(), actual.size())
+        << std::hex << opcode << " " << aarch64::RegisterName(index);
+    ASSERT_EQ(expected, actual)
+        << std::hex << opcode << " " << aarch64::RegisterName(index);
+  }
+
+  for (const auto& write : recorder.writes) {
+    ASSERT_EQ(reference.GetMemory(write.first, write.second),
+              interpreter.GetMemory(write.first, write.second))
+        << std::hex << opcode << " " << write.first;
+  }
+}
+
+// the bytecode interpreter must match the reference interpreter exactly, so we
+// run both on the translations of random instructions from random states.
+TEST(Bytecode, MatchesReferenceInterpreter) {
+  for (int i = 0; i < 0x8000; ++i) {
+    uint32_t opcode = prng();
+    NativeInstruction ni = aarch64::TranslateInstruction(
+        0x1000, reinterpret_cast<uint8_t*>(&opcode), sizeof(opcode));
+    Bytecode bc = CompileBytecode(ni);
+
+    Interpreter reference(aarch64::kV31 + 1);
+    WriteRecorder recorder;
+    reference.set_trace_sink(&recorder);
+    std::mt19937_64 state_prng = prng;
+    RandomState(reference);
+
+    Interpreter interpreter(aarch64::kV31 + 1);
+    prng = state_prng;
+    RandomState(interpreter);
+
+    uint64_t expected_pc = 0, actual_pc = 0;
+    bool expected_throws = false, actual_throws = false;
+    try {
+      expected_pc = reference.Execute(ni);
+    } catch (const std::out_of_range&) {
+      expected_throws = true;
+    }
+    try {
+      actual_pc = interpreter.Execute(bc);
+    } catch (const std::out_of_range&) {
+      actual_throws = true;
+    }
+
+    ASSERT_EQ(expected_throws, actual_throws) << std::hex << opcode;
+    if (!expected_throws) {
+      ASSERT_EQ(expected_pc, actual_pc) << std::hex << opcode;
+      ExpectSameState(reference, interpreter, recorder, opcode);
+    }
+  }
+}
+
+// division by zero gives zero in both interpreters, at every operand width.
+TEST(Bytecode, DivideByZero) {
+  for (uint16_t size : {8, 64, 128, 256}) {
+    for (Opcode opcode : {Opcode::Div, Opcode::Mod}) {
+      NativeInstruction ni;
+      ni.address = 0x1000;
+      ni.size = 4;
+      if (opcode == Opcode::Div) {
+        ni.reil.push_back(
+            Div(Immediate(size, 5), Immediate(size, 0), Register(size, 0)));
+      } else {
+        ni.reil.push_back(
+            Mod(Immediate(size, 5), Immediate(size, 0), Register(size, 0)));
+      }
+
+      Interpreter reference(1);
+      reference.SetRegister(0, Immediate(size, 1));
+      reference.Execute(ni);
+      EXPECT_EQ(reference.GetRegister(0), Immediate(size, 0)) << size;
+
+      Interpreter interpreter(1);
+      interpreter.SetRegister(0, Immediate(size, 1));
+      interpreter.Execute(CompileBytecode(ni));
+      EXPECT_EQ(interpreter.GetRegister(0), Immediate(size, 0)) << size;
+    }
+  }
+}
+
+}  // namespace reil
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
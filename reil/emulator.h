@@ -21,16 +21,38 @@
 #include "reil/reil.h"
 
 namespace reil {
+// Why a call to Emulator::Run returned.
+enum class StopReason {
+  // the instruction budget passed to Run was used up.
+  kInstructionLimit,
+  // execution reached a breakpoint; the instruction there has not executed.
+  kBreakpoint,
+  // the pc points at memory that has not been mapped.
+  kUnmappedFetch,
+  // a Sys instruction (eg. svc) executed; the pc is after it.
+  kSys,
+  // the instruction at the pc has no translation (an Unkn instruction), and
+  // has not executed.
+  kUnknownInstruction,
+};
+
 class Emulator {
  public:
   Emulator();
   virtual ~Emulator();
 
-  virtual void Run() = 0;
+  // Executes instructions from the current pc until one of the conditions in
+  // StopReason is met. A breakpoint at the pc when Run is called is ignored,
+  // so that execution can be resumed from it.
+  virtual StopReason Run(uint64_t max_instructions) = 0;
   virtual bool SingleStep() = 0;
+  virtual void AddBreakpoint(uint64_t address) = 0;
+  virtual void RemoveBreakpoint(uint64_t address) = 0;
   virtual Immediate GetRegister(uint32_t index) const = 0;
   virtual void SetRegister(uint32_t index, Immediate value) = 0;
   virtual std::vector<uint8_t> GetMemory(uint64_t address, size_t size) = 0;
+  virtual void MapMemory(uint64_t address,
+                         absl::Span<const uint8_t> bytes) = 0;
   virtual void SetMemory(uint64_t address,
                          const absl::Span<uint8_t>& bytes) = 0;
   virtual void SetMemory(uint64_t address, uint8_t* bytes,
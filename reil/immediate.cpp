@@ -19,42 +19,44 @@
 #include <iomanip>
 
 #include "absl/container/fixed_array.h"
+#include "absl/numeric/int128.h"
 #include "glog/logging.h"
 
 namespace reil {
+// limbs are accessed as bytes through byte_data(), which (like the integer
+// conversions) relies on the host being little-endian.
 
-Immediate::Immediate() : bytes_(0) {}
+static inline uint16_t LimbCount(uint16_t size) { return (size / 8 + 7) / 8; }
 
-Immediate::Immediate(uint16_t size, uint64_t value) : bytes_(size / 8) {
-  if (size / 8 < sizeof(uint64_t)) {
-    memcpy(bytes_.data(), &value, bytes_.size());
-  } else {
-    memset(bytes_.data(), 0, bytes_.size());
-    memcpy(bytes_.data(), &value, sizeof(uint64_t));
-  }
-}
+Immediate::Immediate() {}
 
-Immediate::Immediate(uint16_t size, const Immediate &value) : bytes_(size / 8) {
-  if (bytes_.size() < value.bytes_.size()) {
-    memcpy(bytes_.data(), value.bytes_.data(), bytes_.size());
-  } else {
-    memset(bytes_.data(), 0, bytes_.size());
-    memcpy(bytes_.data(), value.bytes_.data(), value.bytes_.size());
-  }
+Immediate::Immediate(uint16_t size, const Immediate &value)
+    : size_(size / 8 * 8), limbs_(LimbCount(size)) {
+  size_t count = std::min(limbs_.size(), value.limbs_.size());
+  std::copy(value.limbs_.begin(), value.limbs_.begin() + count,
+            limbs_.begin());
+  Truncate();
 }
 
 Immediate::Immediate(const absl::Span<uint8_t> &bytes)
     : Immediate(bytes.data(), bytes.size()) {}
 
 Immediate::Immediate(const uint8_t *bytes, size_t bytes_len)
-    : bytes_(bytes_len) {
-  memcpy(bytes_.data(), bytes, bytes_.size());
+    : size_(bytes_len * 8), limbs_(LimbCount(bytes_len * 8)) {
+  memcpy(byte_data(), bytes, bytes_len);
 }
 
-uint16_t Immediate::size() const { return bytes_.size() * 8; }
+void Immediate::Truncate() {
+  uint16_t top_bits = size_ % 64;
+  if (top_bits) {
+    limbs_.back() &= (1ull << top_bits) - 1;
+  }
+}
+
+uint16_t Immediate::size() const { return size_; }
 
 absl::Span<uint8_t> Immediate::bytes() {
-  return absl::Span<uint8_t>(bytes_.data(), bytes_.size());
+  return absl::Span<uint8_t>(byte_data(), byte_width());
 }
 
 Immediate Immediate::Extract(uint16_t size, uint16_t offset) const {
@@ -76,60 +78,58 @@ Immediate Immediate::ZeroExtend(uint16_t size) const {
 Immediate Immediate::SignExtend(uint16_t size) const {
   Immediate result(size, *this);
 
-  if (bytes_[bytes_.size() - 1] & 0x80) {
-    memset(result.bytes_.data() + bytes_.size(), 0xff,
-           result.bytes_.size() - bytes_.size());
+  if (size_ && size_ < result.size_ &&
+      (limbs_[(size_ - 1) / 64] >> ((size_ - 1) % 64)) & 1) {
+    result.limbs_[size_ / 64] |= ~0ull << (size_ % 64);
+    for (size_t i = size_ / 64 + 1; i < result.limbs_.size(); ++i) {
+      result.limbs_[i] = ~0ull;
+    }
+    result.Truncate();
   }
 
   return result;
 }
 
 Immediate::operator bool() const {
-  for (uint16_t i = 0; i < bytes_.size(); ++i) {
-    if (bytes_[i]) return true;
+  for (uint64_t limb : limbs_) {
+    if (limb) return true;
   }
   return false;
 }
 
-Immediate::operator uint8_t() const {
-  uint8_t value = 0;
-  memcpy(&value, bytes_.data(), std::min(bytes_.size(), sizeof(value)));
-  return value;
-}
+Immediate::operator uint8_t() const { return static_cast<uint8_t>(limb(0)); }
 
 Immediate::operator uint16_t() const {
-  uint16_t value = 0;
-  memcpy(&value, bytes_.data(), std::min(bytes_.size(), sizeof(value)));
-  return value;
+  return static_cast<uint16_t>(limb(0));
 }
 
 Immediate::operator uint32_t() const {
-  uint32_t value = 0;
-  memcpy(&value, bytes_.data(), std::min(bytes_.size(), sizeof(value)));
-  return value;
+  return static_cast<uint32_t>(limb(0));
 }
 
-Immediate::operator uint64_t() const {
-  uint64_t value = 0;
-  memcpy(&value, bytes_.data(), std::min(bytes_.size(), sizeof(value)));
-  return value;
-}
+Immediate::operator uint64_t() const { return limb(0); }
 
 bool Immediate::operator==(const Immediate &other) const {
-  DCHECK(bytes_.size() == other.bytes_.size());
+  DCHECK(size_ == other.size_);
+
+  if (limbs_.size() == 1) {
+    return limbs_[0] == other.limb(0);
+  }
 
-  return (memcmp(bytes_.data(), other.bytes_.data(), bytes_.size()) == 0);
+  for (size_t i = 0; i < limbs_.size(); ++i) {
+    if (limbs_[i] != other.limb(i)) {
+      return false;
+    }
+  }
+  return true;
 }
 
 bool Immediate::operator<(const Immediate &other) const {
-  DCHECK(bytes_.size() == other.bytes_.size());
+  DCHECK(size_ == other.size_);
 
-  uint16_t byte_width = bytes_.size();
-  for (uint16_t i = 1; i <= byte_width; ++i) {
-    if (bytes_[byte_width - i] < other.bytes_[byte_width - i]) {
-      return true;
-    } else if (bytes_[byte_width - i] > other.bytes_[byte_width - i]) {
-      return false;
+  for (size_t i = limbs_.size(); i-- > 0;) {
+    if (limbs_[i] != other.limb(i)) {
+      return limbs_[i] < other.limb(i);
     }
   }
 
@@ -137,14 +137,11 @@ bool Immediate::operator<(const Immediate &other) const {
 }
 
 bool Immediate::operator<=(const Immediate &other) const {
-  DCHECK(bytes_.size() == other.bytes_.size());
+  DCHECK(size_ == other.size_);
 
-  uint16_t byte_width = bytes_.size();
-  for (uint16_t i = 1; i <= byte_width; ++i) {
-    if (bytes_[byte_width - i] < other.bytes_[byte_width - i]) {
-      return true;
-    } else if (bytes_[byte_width - i] > other.bytes_[byte_width - i]) {
-      return false;
+  for (size_t i = limbs_.size(); i-- > 0;) {
+    if (limbs_[i] != other.limb(i)) {
+      return limbs_[i] < other.limb(i);
     }
   }
 
@@ -165,7 +162,10 @@ bool Immediate::operator>=(const Immediate &other) const {
 
 Immediate Immediate::Mask(uint16_t size, uint16_t mask_size) {
   Immediate mask(mask_size);
-  memset(mask.bytes_.data(), 0xff, mask.bytes_.size());
+  for (auto &limb : mask.limbs_) {
+    limb = ~0ull;
+  }
+  mask.Truncate();
   return mask.ZeroExtend(size);
 }
 
@@ -220,45 +220,80 @@ Immediate Immediate::UnsignedMax(uint16_t size) {
 }
 
 Immediate operator+(const Immediate &lhs, const Immediate &rhs) {
-  DCHECK(lhs.bytes_.size() == rhs.bytes_.size());
+  DCHECK(lhs.size_ == rhs.size_);
 
   Immediate result(lhs.size() * 2);
-
-  uint8_t i = 0;
-  uint16_t tmp = 0;
-
-  for (i = 0; i < lhs.bytes_.size(); ++i) {
-    tmp += lhs.bytes_[i] + rhs.bytes_[i];
-    result.bytes_[i] = (uint8_t)tmp;
-    tmp >>= 8;
+  if (result.limbs_.size() == 1) {
+    result.limbs_[0] = lhs.limbs_[0] + rhs.limb(0);
+    return result;
   }
 
-  result.bytes_[i++] = tmp;
-  for (; i < result.bytes_.size(); ++i) {
-    result.bytes_[i] = 0;
+  // the result is twice as wide as the operands, so there is always room for
+  // the final carry.
+  uint64_t carry = 0;
+  size_t i;
+  for (i = 0; i < lhs.limbs_.size(); ++i) {
+    uint64_t sum = lhs.limbs_[i] + carry;
+    carry = sum < carry;
+    sum += rhs.limb(i);
+    carry += sum < rhs.limb(i);
+    result.limbs_[i] = sum;
+  }
+  if (i < result.limbs_.size()) {
+    result.limbs_[i] = carry;
   }
 
   return result;
 }
 
 Immediate operator-(const Immediate &lhs, const Immediate &rhs) {
-  DCHECK(lhs.bytes_.size() == rhs.bytes_.size());
+  DCHECK(lhs.size_ == rhs.size_);
 
   Immediate result(lhs.size() * 2);
+  if (result.limbs_.size() == 1) {
+    result.limbs_[0] = lhs.limbs_[0] - rhs.limb(0);
+    result.Truncate();
+    return result;
+  }
 
-  uint8_t i = 0;
-  int16_t tmp = 0;
-
-  for (i = 0; i < lhs.bytes_.size(); ++i) {
-    tmp += lhs.bytes_[i] - rhs.bytes_[i];
-    result.bytes_[i] = (uint8_t)tmp;
-    tmp >>= 8;
+  // the borrow propagates through the upper half of the result.
+  uint64_t borrow = 0;
+  for (size_t i = 0; i < result.limbs_.size(); ++i) {
+    uint64_t difference = lhs.limb(i) - rhs.limb(i);
+    uint64_t next_borrow = lhs.limb(i) < rhs.limb(i);
+    next_borrow |= difference < borrow;
+    result.limbs_[i] = difference - borrow;
+    borrow = next_borrow;
   }
+  result.Truncate();
 
-  for (; i < result.bytes_.size(); ++i) {
-    result.bytes_[i] = (uint8_t)tmp;
+  return result;
+}
+
+Immediate limb_multiply(const Immediate &lhs, const Immediate &rhs) {
+  // schoolbook multiplication on 64-bit limbs; each partial product is a
+  // single 64x64->128 bit multiply.
+  size_t lhs_count = lhs.limbs_.size();
+  size_t rhs_count = rhs.limbs_.size();
+  absl::FixedArray<uint64_t> product(lhs_count + rhs_count, 0);
+
+  for (size_t i = 0; i < lhs_count; ++i) {
+    uint64_t carry = 0;
+    for (size_t j = 0; j < rhs_count; ++j) {
+      absl::uint128 tmp = absl::uint128(lhs.limbs_[i]) * rhs.limbs_[j];
+      tmp += product[i + j];
+      tmp += carry;
+      product[i + j] = absl::Uint128Low64(tmp);
+      carry = absl::Uint128High64(tmp);
+    }
+    product[i + rhs_count] = carry;
   }
 
+  Immediate result(lhs.size() * 2);
+  std::copy(product.begin(),
+            product.begin() + std::min(product.size(), result.limbs_.size()),
+            result.limbs_.begin());
+  result.Truncate();
   return result;
 }
 
@@ -279,11 +314,14 @@ Immediate lattice_multiply(const Immediate &lhs, const Immediate &rhs) {
   //    0x10000 > (0xff + 0xfe) * byte_width
   //    byte_width < 0x80
 
-  uint16_t byte_width = lhs.bytes_.size();
+  uint16_t byte_width = lhs.byte_width();
+  const uint8_t *lhs_bytes = lhs.byte_data();
+  const uint8_t *rhs_bytes = rhs.byte_data();
 
   Immediate result(lhs.size() * 2);
+  uint8_t *result_bytes = result.byte_data();
 
-  size_t lattice_size = lhs.bytes_.size() * rhs.bytes_.size();
+  size_t lattice_size = lhs.byte_width() * rhs.byte_width();
   absl::FixedArray<uint8_t> lattice(lattice_size);
   absl::FixedArray<uint8_t> carry_lattice(lattice_size);
 
@@ -293,7 +331,7 @@ Immediate lattice_multiply(const Immediate &lhs, const Immediate &rhs) {
 
   for (uint16_t j = 0; j < byte_width; ++j) {
     for (uint16_t i = 0; i < byte_width; ++i) {
-      tmp = lhs.bytes_[i] * rhs.bytes_[j];
+      tmp = lhs_bytes[i] * rhs_bytes[j];
       lattice[(i * byte_width) + j] = (uint8_t)tmp;
       carry_lattice[(i * byte_width) + j] = (uint8_t)(tmp >> 8);
     }
@@ -311,7 +349,7 @@ Immediate lattice_multiply(const Immediate &lhs, const Immediate &rhs) {
         }
       }
     }
-    result.bytes_[i] = (uint8_t)byte_value;
+    result_bytes[i] = (uint8_t)byte_value;
   }
 
   return result;
@@ -381,35 +419,175 @@ Immediate karatsuba_multiply(const Immediate &lhs, const Immediate &rhs) {
 }
 
 Immediate operator*(const Immediate &lhs, const Immediate &rhs) {
-  DCHECK(lhs.bytes_.size() == rhs.bytes_.size());
-  uint16_t byte_width = lhs.bytes_.size();
+  DCHECK(lhs.size_ == rhs.size_);
+  uint16_t byte_width = lhs.byte_width();
 
   if (byte_width <= 4) {
     uint64_t lhs64 = static_cast<uint64_t>(lhs);
     uint64_t rhs64 = static_cast<uint64_t>(rhs);
     return Immediate(64, lhs64 * rhs64);
-  } else if (byte_width < 0x80) {
-    return lattice_multiply(lhs, rhs);
+  } else if (byte_width <= 8) {
+    absl::uint128 product = absl::uint128(lhs.limbs_[0]) * rhs.limb(0);
+    Immediate result(lhs.size() * 2);
+    result.limbs_[0] = absl::Uint128Low64(product);
+    result.limbs_[1] = absl::Uint128High64(product);
+    result.Truncate();
+    return result;
+  } else {
+    return limb_multiply(lhs, rhs);
+  }
+}
+
+static size_t SignificantLimbs(const uint64_t *limbs, size_t count) {
+  while (count && !limbs[count - 1]) {
+    --count;
+  }
+  return count;
+}
+
+static inline int LeadingZeros(uint64_t value) {
+  int count = 0;
+  while (!(value & (1ull << 63))) {
+    value <<= 1;
+    ++count;
+  }
+  return count;
+}
+
+// Knuth, TAOCP vol. 2, 4.3.1, algorithm D: divides the m limb u by the n limb
+// v, where u[m - 1] and v[n - 1] are non-zero and m >= n >= 2, writing the
+// m - n + 1 limb quotient to q and the n limb remainder to r.
+static void DivideLimbs(const uint64_t *u, size_t m, const uint64_t *v,
+                        size_t n, uint64_t *q, uint64_t *r) {
+  const absl::uint128 base = absl::MakeUint128(1, 0);
+
+  // D1: normalise so that the top bit of the divisor is set, which bounds the
+  // error in each quotient digit estimate to 2.
+  int shift = LeadingZeros(v[n - 1]);
+  absl::FixedArray<uint64_t> vn(n);
+  absl::FixedArray<uint64_t> un(m + 1);
+  for (size_t i = n - 1; i > 0; --i) {
+    vn[i] = shift ? (v[i] << shift) | (v[i - 1] >> (64 - shift)) : v[i];
+  }
+  vn[0] = v[0] << shift;
+  un[m] = shift ? u[m - 1] >> (64 - shift) : 0;
+  for (size_t i = m - 1; i > 0; --i) {
+    un[i] = shift ? (u[i] << shift) | (u[i - 1] >> (64 - shift)) : u[i];
+  }
+  un[0] = u[0] << shift;
+
+  for (size_t j = m - n + 1; j-- > 0;) {
+    // D3: estimate the quotient digit from the top two limbs of the
+    // remainder, and correct the estimate using the next limb.
+    absl::uint128 numerator = absl::MakeUint128(un[j + n], un[j + n - 1]);
+    absl::uint128 qhat = numerator / vn[n - 1];
+    absl::uint128 rhat = numerator % vn[n - 1];
+    while (qhat >= base ||
+           qhat * vn[n - 2] > absl::MakeUint128(absl::Uint128Low64(rhat),
+                                                un[j + n - 2])) {
+      --qhat;
+      rhat += vn[n - 1];
+      if (rhat >= base) {
+        break;
+      }
+    }
+
+    // D4: multiply and subtract.
+    uint64_t digit = absl::Uint128Low64(qhat);
+    uint64_t carry = 0;
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < n; ++i) {
+      absl::uint128 product = absl::uint128(digit) * vn[i] + carry;
+      carry = absl::Uint128High64(product);
+      uint64_t low = absl::Uint128Low64(product);
+      uint64_t difference = un[i + j] - low;
+      uint64_t next_borrow = un[i + j] < low;
+      next_borrow += difference < borrow;
+      un[i + j] = difference - borrow;
+      borrow = next_borrow;
+    }
+    uint64_t difference = un[j + n] - carry;
+    bool negative = un[j + n] < carry || difference < borrow;
+    un[j + n] = difference - borrow;
+
+    // D6: the estimate was one too large, so add the divisor back.
+    if (negative) {
+      --digit;
+      carry = 0;
+      for (size_t i = 0; i < n; ++i) {
+        absl::uint128 sum = absl::uint128(un[i + j]) + vn[i] + carry;
+        un[i + j] = absl::Uint128Low64(sum);
+        carry = absl::Uint128High64(sum);
+      }
+      un[j + n] += carry;
+    }
+
+    q[j] = digit;
+  }
+
+  // D8: unnormalise the remainder.
+  for (size_t i = 0; i < n; ++i) {
+    r[i] = shift ? (un[i] >> shift) | (un[i + 1] << (64 - shift)) : un[i];
+  }
+}
+
+static void DivideLimbs(absl::Span<const uint64_t> lhs,
+                        absl::Span<const uint64_t> rhs,
+                        absl::Span<uint64_t> quotient,
+                        absl::Span<uint64_t> remainder) {
+  size_t m = SignificantLimbs(lhs.data(), lhs.size());
+  size_t n = SignificantLimbs(rhs.data(), rhs.size());
+  std::fill(quotient.begin(), quotient.end(), 0);
+  std::fill(remainder.begin(), remainder.end(), 0);
+
+  if (m < n) {
+    std::copy(lhs.begin(), lhs.begin() + m, remainder.begin());
+  } else if (n == 1) {
+    // short division by a single limb.
+    uint64_t carry = 0;
+    for (size_t i = m; i-- > 0;) {
+      absl::uint128 numerator = absl::MakeUint128(carry, lhs[i]);
+      quotient[i] = absl::Uint128Low64(numerator / rhs[0]);
+      carry = absl::Uint128Low64(numerator % rhs[0]);
+    }
+    remainder[0] = carry;
   } else {
-    return karatsuba_multiply(lhs, rhs);
+    DivideLimbs(lhs.data(), m, rhs.data(), n, quotient.data(),
+                remainder.data());
   }
 }
 
+Immediate knuth_divide(const Immediate &lhs, const Immediate &rhs) {
+  Immediate quotient(lhs.size());
+  Immediate remainder(lhs.size());
+  DivideLimbs(lhs.limbs_, rhs.limbs_, absl::MakeSpan(quotient.limbs_),
+              absl::MakeSpan(remainder.limbs_));
+  return quotient;
+}
+
+Immediate knuth_modulus(const Immediate &lhs, const Immediate &rhs) {
+  Immediate quotient(lhs.size());
+  Immediate remainder(lhs.size());
+  DivideLimbs(lhs.limbs_, rhs.limbs_, absl::MakeSpan(quotient.limbs_),
+              absl::MakeSpan(remainder.limbs_));
+  return remainder;
+}
+
 Immediate binary_long_divide(const Immediate &lhs, const Immediate &rhs) {
   Immediate quotient(lhs.size());
 
   // binary long division
   Immediate dividend = lhs.ZeroExtend(lhs.size() + 8);
-  uint16_t dividend_width = dividend.bytes_.size();
+  uint16_t dividend_width = dividend.byte_width();
 
   Immediate divisor = rhs.ZeroExtend(rhs.size() + 8);
-  uint16_t divisor_width = divisor.bytes_.size();
+  uint16_t divisor_width = divisor.byte_width();
 
   // first we normalise, to make sure we only do the minimum necessary  work.
 
   uint16_t dividend_shift = 0;
   for (uint16_t i = 1; i <= dividend_width; ++i) {
-    uint8_t dividend_byte = dividend.bytes_[dividend_width - i];
+    uint8_t dividend_byte = dividend.byte_data()[dividend_width - i];
     if (dividend_byte != 0) {
       dividend_shift = 8 * (i - 1);
       while (!(dividend_byte & 0x80)) {
@@ -422,7 +600,7 @@ Immediate binary_long_divide(const Immediate &lhs, const Immediate &rhs) {
 
   uint16_t divisor_shift = 0;
   for (uint16_t i = 1; i <= divisor_width; ++i) {
-    uint8_t divisor_byte = divisor.bytes_[divisor_width - i];
+    uint8_t divisor_byte = divisor.byte_data()[divisor_width - i];
     if (divisor_byte != 0) {
       divisor_shift = 8 * (i - 1);
       while (!(divisor_byte & 0x80)) {
@@ -433,8 +611,6 @@ Immediate binary_long_divide(const Immediate &lhs, const Immediate &rhs) {
     }
   }
 
-  std::cerr << dividend_shift << " " << divisor_shift << std::endl;
-
   uint16_t bit = divisor_shift - dividend_shift;
   divisor <<= bit;
   if (divisor >= dividend) {
@@ -445,11 +621,9 @@ Immediate binary_long_divide(const Immediate &lhs, const Immediate &rhs) {
   // now we compute the quotient in max(bit) subtractions and shifts.
 
   while (bit) {
-    std::cerr << bit << std::endl;
-    std::cerr << quotient << std::endl;
     if (dividend >= divisor) {
       dividend = (dividend - divisor).Extract(lhs.size() + 8);
-      quotient.bytes_[bit / 8] |= 1 << (bit % 8);
+      quotient.byte_data()[bit / 8] |= 1 << (bit % 8);
     }
 
     bit -= 1;
@@ -458,7 +632,7 @@ Immediate binary_long_divide(const Immediate &lhs, const Immediate &rhs) {
 
   if (dividend >= divisor) {
     dividend = (dividend - divisor).Extract(lhs.size() + 8);
-    quotient.bytes_[0] |= 1;
+    quotient.byte_data()[0] |= 1;
   }
 
   return quotient;
@@ -467,16 +641,16 @@ Immediate binary_long_divide(const Immediate &lhs, const Immediate &rhs) {
 Immediate binary_long_modulus(const Immediate &lhs, const Immediate &rhs) {
   // binary long division
   Immediate dividend = lhs.ZeroExtend(lhs.size() + 8);
-  uint16_t dividend_width = dividend.bytes_.size();
+  uint16_t dividend_width = dividend.byte_width();
 
   Immediate divisor = rhs.ZeroExtend(rhs.size() + 8);
-  uint16_t divisor_width = divisor.bytes_.size();
+  uint16_t divisor_width = divisor.byte_width();
 
   // first we normalise, to make sure we only do the minimum necessary  work.
 
   uint16_t dividend_shift = 0;
   for (uint16_t i = 1; i <= dividend_width; ++i) {
-    uint8_t dividend_byte = dividend.bytes_[dividend_width - i];
+    uint8_t dividend_byte = dividend.byte_data()[dividend_width - i];
     if (dividend_byte != 0) {
       dividend_shift = 8 * (i - 1);
       while (!(dividend_byte & 0x80)) {
@@ -489,7 +663,7 @@ Immediate binary_long_modulus(const Immediate &lhs, const Immediate &rhs) {
 
   uint16_t divisor_shift = 0;
   for (uint16_t i = 1; i <= divisor_width; ++i) {
-    uint8_t divisor_byte = divisor.bytes_[divisor_width - i];
+    uint8_t divisor_byte = divisor.byte_data()[divisor_width - i];
     if (divisor_byte != 0) {
       divisor_shift = 8 * (i - 1);
       while (!(divisor_byte & 0x80)) {
@@ -526,75 +700,47 @@ Immediate binary_long_modulus(const Immediate &lhs, const Immediate &rhs) {
 }
 
 Immediate operator/(const Immediate &lhs, const Immediate &rhs) {
-  DCHECK(lhs.bytes_.size() == rhs.bytes_.size());
+  DCHECK(lhs.size_ == rhs.size_);
   Immediate quotient(lhs.size());
-  uint16_t byte_width = lhs.bytes_.size();
 
   if (!rhs) {
-    // TODO: raise divide by zero exception
     return quotient;
   }
 
-  if (lhs == rhs) {
-    // quotient is 1
-    quotient.bytes_[0] = 1;
-  } else if (byte_width == 1) {
-    uint8_t lhs8 = static_cast<uint8_t>(lhs);
-    uint8_t rhs8 = static_cast<uint8_t>(rhs);
-    return Immediate(8, lhs8 / rhs8);
-  } else if (byte_width == 2) {
-    uint16_t lhs16 = static_cast<uint16_t>(lhs);
-    uint16_t rhs16 = static_cast<uint16_t>(rhs);
-    return Immediate(16, lhs16 / rhs16);
-  } else if (byte_width == 4) {
-    uint32_t lhs32 = static_cast<uint32_t>(lhs);
-    uint32_t rhs32 = static_cast<uint32_t>(rhs);
-    return Immediate(32, lhs32 / rhs32);
-  } else if (byte_width == 8) {
-    uint64_t lhs64 = static_cast<uint64_t>(lhs);
-    uint64_t rhs64 = static_cast<uint64_t>(rhs);
-    return Immediate(64, lhs64 / rhs64);
-  } else if (rhs < lhs) {
-    return binary_long_divide(lhs, rhs);
+  if (lhs.size_ <= 64) {
+    quotient.limbs_[0] = lhs.limbs_[0] / rhs.limb(0);
+  } else if (lhs.size_ <= 128) {
+    absl::uint128 value =
+        absl::MakeUint128(lhs.limbs_[1], lhs.limbs_[0]) /
+        absl::MakeUint128(rhs.limb(1), rhs.limb(0));
+    quotient.limbs_[0] = absl::Uint128Low64(value);
+    quotient.limbs_[1] = absl::Uint128High64(value);
   } else {
-    // do nothing, quotient is zero
+    return knuth_divide(lhs, rhs);
   }
 
   return quotient;
 }
 
 Immediate operator%(const Immediate &lhs, const Immediate &rhs) {
-  DCHECK(lhs.bytes_.size() == rhs.bytes_.size());
-  uint16_t byte_width = lhs.bytes_.size();
+  DCHECK(lhs.size_ == rhs.size_);
 
   if (!rhs) {
-    // TODO: raise divide by zero exception
     return Immediate(lhs.size());
   }
 
-  if (lhs == rhs) {
-    // quotient is 1
-    return Immediate(lhs.size());
-  } else if (byte_width == 1) {
-    uint8_t lhs8 = static_cast<uint8_t>(lhs);
-    uint8_t rhs8 = static_cast<uint8_t>(rhs);
-    return Immediate(8, lhs8 % rhs8);
-  } else if (byte_width == 2) {
-    uint16_t lhs16 = static_cast<uint16_t>(lhs);
-    uint16_t rhs16 = static_cast<uint16_t>(rhs);
-    return Immediate(16, lhs16 % rhs16);
-  } else if (byte_width == 4) {
-    uint32_t lhs32 = static_cast<uint32_t>(lhs);
-    uint32_t rhs32 = static_cast<uint32_t>(rhs);
-    return Immediate(32, lhs32 % rhs32);
-  } else if (byte_width == 8) {
-    uint64_t lhs64 = static_cast<uint64_t>(lhs);
-    uint64_t rhs64 = static_cast<uint64_t>(rhs);
-    return Immediate(64, lhs64 % rhs64);
-  } else if (rhs < lhs) {
-    return binary_long_modulus(lhs, rhs);
+  if (lhs.size_ <= 64) {
+    return Immediate(lhs.size(), lhs.limbs_[0] % rhs.limb(0));
+  } else if (lhs.size_ <= 128) {
+    Immediate remainder(lhs.size());
+    absl::uint128 value =
+        absl::MakeUint128(lhs.limbs_[1], lhs.limbs_[0]) %
+        absl::MakeUint128(rhs.limb(1), rhs.limb(0));
+    remainder.limbs_[0] = absl::Uint128Low64(value);
+    remainder.limbs_[1] = absl::Uint128High64(value);
+    return remainder;
   } else {
-    return lhs;
+    return knuth_modulus(lhs, rhs);
   }
 }
 
@@ -614,30 +760,30 @@ Immediate operator^(Immediate lhs, const Immediate &rhs) {
 }
 
 Immediate &Immediate::operator&=(const Immediate &rhs) {
-  DCHECK(bytes_.size() == rhs.bytes_.size());
+  DCHECK(size_ == rhs.size_);
 
-  for (uint16_t i = 0; i < bytes_.size(); ++i) {
-    bytes_[i] &= rhs.bytes_[i];
+  for (size_t i = 0; i < limbs_.size(); ++i) {
+    limbs_[i] &= rhs.limb(i);
   }
 
   return *this;
 }
 
 Immediate &Immediate::operator|=(const Immediate &rhs) {
-  DCHECK(bytes_.size() == rhs.bytes_.size());
+  DCHECK(size_ == rhs.size_);
 
-  for (uint16_t i = 0; i < bytes_.size(); ++i) {
-    bytes_[i] |= rhs.bytes_[i];
+  for (size_t i = 0; i < limbs_.size(); ++i) {
+    limbs_[i] |= rhs.limb(i);
   }
 
   return *this;
 }
 
 Immediate &Immediate::operator^=(const Immediate &rhs) {
-  DCHECK(bytes_.size() == rhs.bytes_.size());
+  DCHECK(size_ == rhs.size_);
 
-  for (uint16_t i = 0; i < bytes_.size(); ++i) {
-    bytes_[i] ^= rhs.bytes_[i];
+  for (size_t i = 0; i < limbs_.size(); ++i) {
+    limbs_[i] ^= rhs.limb(i);
   }
 
   return *this;
@@ -654,44 +800,48 @@ Immediate &Immediate::operator>>=(const Immediate &rhs) {
 }
 
 Immediate &Immediate::operator<<=(uint16_t rhs) {
-  uint16_t byte_width = bytes_.size();
-  uint16_t byte_shift = rhs / 8;
-  uint8_t bit_shift = rhs % 8;
-
-  if (byte_shift >= byte_width) {
-    memset(bytes_.data(), 0, byte_width);
-  } else if (bit_shift) {
-    for (uint16_t i = byte_width - 1; i > byte_shift; --i) {
-      bytes_[i] = (bytes_[i - byte_shift] << bit_shift) |
-                  (bytes_[i - byte_shift - 1] >> (8 - bit_shift));
-    }
-    bytes_[byte_shift] = bytes_[0] << bit_shift;
-    memset(bytes_.data(), 0, byte_shift);
+  if (rhs >= size_) {
+    std::fill(limbs_.begin(), limbs_.end(), 0);
+  } else if (limbs_.size() == 1) {
+    limbs_[0] <<= rhs;
+    Truncate();
   } else {
-    memmove(bytes_.data() + byte_shift, bytes_.data(), byte_width - byte_shift);
-    memset(bytes_.data(), 0, byte_shift);
+    size_t limb_shift = rhs / 64;
+    uint8_t bit_shift = rhs % 64;
+    for (size_t i = limbs_.size(); i-- > 0;) {
+      uint64_t value = 0;
+      if (i >= limb_shift) {
+        value = limbs_[i - limb_shift] << bit_shift;
+        if (bit_shift && i > limb_shift) {
+          value |= limbs_[i - limb_shift - 1] >> (64 - bit_shift);
+        }
+      }
+      limbs_[i] = value;
+    }
+    Truncate();
   }
 
   return *this;
 }
 
 Immediate &Immediate::operator>>=(uint16_t rhs) {
-  uint16_t byte_width = bytes_.size();
-  uint16_t byte_shift = rhs / 8;
-  uint8_t bit_shift = rhs % 8;
-
-  if (byte_shift >= byte_width) {
-    memset(bytes_.data(), 0, byte_width);
-  } else if (bit_shift) {
-    for (uint16_t i = byte_shift; i < byte_width - 1; ++i) {
-      bytes_[i - byte_shift] =
-          (bytes_[i] >> bit_shift) | (bytes_[i + 1] << (8 - bit_shift));
-    }
-    bytes_[byte_width - 1 - byte_shift] = bytes_[byte_width - 1] >> bit_shift;
-    memset(bytes_.data() + (byte_width - byte_shift), 0, byte_shift);
+  if (rhs >= size_) {
+    std::fill(limbs_.begin(), limbs_.end(), 0);
+  } else if (limbs_.size() == 1) {
+    limbs_[0] >>= rhs;
   } else {
-    memmove(bytes_.data(), bytes_.data() + byte_shift, byte_width - byte_shift);
-    memset(bytes_.data() + (byte_width - byte_shift), 0, byte_shift);
+    size_t limb_shift = rhs / 64;
+    uint8_t bit_shift = rhs % 64;
+    for (size_t i = 0; i < limbs_.size(); ++i) {
+      uint64_t value = 0;
+      if (i + limb_shift < limbs_.size()) {
+        value = limbs_[i + limb_shift] >> bit_shift;
+        if (bit_shift && i + limb_shift + 1 < limbs_.size()) {
+          value |= limbs_[i + limb_shift + 1] << (64 - bit_shift);
+        }
+      }
+      limbs_[i] = value;
+    }
   }
 
   return *this;
@@ -722,9 +872,10 @@ std::ostream &operator<<(std::ostream &stream, const Immediate &imm) {
   auto old_precision = stream.precision();
   auto old_fill = stream.fill();
 
+  const uint8_t *bytes = imm.byte_data();
   stream << std::nouppercase << std::setfill('0') << std::hex;
-  for (uint16_t i = 1; i <= imm.bytes_.size(); ++i) {
-    stream << std::setw(2) << (uint16_t)imm.bytes_[imm.bytes_.size() - i];
+  for (uint16_t i = 1; i <= imm.byte_width(); ++i) {
+    stream << std::setw(2) << (uint16_t)bytes[imm.byte_width() - i];
   }
 
   stream.flags(old_flags);
@@ -22,9 +22,31 @@
 #include "absl/types/span.h"
 
 namespace reil {
+// An unsigned integer of a whole number of bytes.
+//
+// Values are stored in little-endian order in 64-bit limbs, so values of up to
+// 64 bits are a single machine word, and values of up to 128 bits still need
+// no allocation. Arithmetic on values of 64 bits or less (and multiplication
+// and division up to 128 bits) is done natively; only wider values use
+// multi-limb arithmetic. Bits of the top limb above size() are always zero.
 class Immediate {
  private:
-  absl::InlinedVector<uint8_t, 8> bytes_;
+  uint16_t size_ = 0;
+  absl::InlinedVector<uint64_t, 2> limbs_;
+
+  inline uint16_t byte_width() const { return size_ / 8; }
+  inline uint8_t *byte_data() {
+    return reinterpret_cast<uint8_t *>(limbs_.data());
+  }
+  inline const uint8_t *byte_data() const {
+    return reinterpret_cast<const uint8_t *>(limbs_.data());
+  }
+  inline uint64_t limb(size_t index) const {
+    return index < limbs_.size() ? limbs_[index] : 0;
+  }
+
+  // clears the bits of the top limb above size().
+  void Truncate();
 
  public:
   Immediate();
@@ -69,6 +91,13 @@ class Immediate {
   bool operator>(const Immediate &other) const;
   bool operator>=(const Immediate &other) const;
 
+  // wide multiplication and division work on 64-bit limbs; the byte-wise
+  // lattice, karatsuba and binary long division implementations are kept to
+  // cross-check them.
+  friend Immediate limb_multiply(const Immediate &lhs, const Immediate &rhs);
+  friend Immediate knuth_divide(const Immediate &lhs, const Immediate &rhs);
+  friend Immediate knuth_modulus(const Immediate &lhs, const Immediate &rhs);
+
   friend Immediate lattice_multiply(const Immediate &lhs, const Immediate &rhs);
   friend Immediate karatsuba_multiply(const Immediate &lhs,
                                       const Immediate &rhs);
@@ -81,6 +110,8 @@ class Immediate {
   friend Immediate operator+(const Immediate &lhs, const Immediate &rhs);
   friend Immediate operator-(const Immediate &lhs, const Immediate &rhs);
   friend Immediate operator*(const Immediate &lhs, const Immediate &rhs);
+  // dividing by zero gives a zero quotient and remainder, as the aarch64 udiv
+  // and sdiv instructions do, so translations can use Div without a check.
   friend Immediate operator/(const Immediate &lhs, const Immediate &rhs);
   friend Immediate operator%(const Immediate &lhs, const Immediate &rhs);
 
@@ -106,6 +137,25 @@ class Immediate {
 
   friend std::ostream &operator<<(std::ostream &stream, const Immediate &imm);
 };
+
+// constructing an immediate from a single word is the common case for
+// operands, so it is defined here to be inlined; values of up to 64 bits are
+// pushed as a single limb, which is much cheaper than sizing the limbs first.
+inline Immediate::Immediate(uint16_t size, uint64_t value)
+    : size_(size / 8 * 8) {
+  if (size_ == 0) {
+    return;
+  } else if (size_ < 64) {
+    limbs_.push_back(value & ((1ull << size_) - 1));
+  } else if (size_ == 64) {
+    limbs_.push_back(value);
+  } else {
+    limbs_.resize((size_ + 63) / 64);
+    limbs_[0] = value;
+    Truncate();
+  }
+}
+
 }  // namespace reil
 
 #define REIL_IMMEDIATE_H_
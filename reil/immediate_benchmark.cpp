@@ -0,0 +1,281 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "reil/immediate.h"
+
+namespace reil {
+
+std::mt19937_64 prng;
+
+Immediate RandomImmediate(uint16_t size, uint16_t random_size) {
+  // Mask only works in whole bytes (Mask(8, 4) is zero), so values of less
+  // than 64 random bits, such as the divisors of 8 bit divisions, are masked
+  // before they are converted.
+  if (random_size < 64) {
+    return Immediate(size, prng() & ((1ull << random_size) - 1));
+  }
+
+  Immediate result(size);
+  for (uint16_t i = 0; i < random_size; i += 64) {
+    result |= Immediate(size, prng()) << i;
+  }
+  return result & Immediate::Mask(size, random_size);
+}
+
+// every benchmark takes the operand size in bits as its only argument, and
+// cycles through a small pool of random operands so that the timings are not
+// specific to one value.
+constexpr size_t kOperandCount = 64;
+
+std::vector<Immediate> RandomOperands(uint16_t size, uint16_t random_size) {
+  std::vector<Immediate> operands;
+  for (size_t i = 0; i < kOperandCount; ++i) {
+    operands.push_back(RandomImmediate(size, random_size));
+  }
+  return operands;
+}
+
+template <typename Op>
+void BinaryBenchmark(benchmark::State &state, uint16_t lhs_size,
+                     uint16_t rhs_size, Op op) {
+  uint16_t size = state.range(0);
+  auto lhs = RandomOperands(size, lhs_size);
+  auto rhs = RandomOperands(size, rhs_size);
+  for (size_t i = 0; i < kOperandCount; ++i) {
+    // avoid division by zero.
+    if (!rhs[i]) {
+      rhs[i] = Immediate(size, 1);
+    }
+  }
+
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(op(lhs[i], rhs[i]));
+    i = (i + 1) % kOperandCount;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+template <typename Op>
+void UnaryBenchmark(benchmark::State &state, Op op) {
+  uint16_t size = state.range(0);
+  auto operands = RandomOperands(size, size);
+
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(op(operands[i]));
+    i = (i + 1) % kOperandCount;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_Construct(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  uint64_t value = prng();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Immediate(size, value));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Construct)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_Copy(benchmark::State &state) {
+  UnaryBenchmark(state, [](const Immediate &imm) { return Immediate(imm); });
+}
+BENCHMARK(BM_Copy)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_Extract(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  UnaryBenchmark(state, [size](const Immediate &imm) {
+    return imm.Extract(size / 2, size / 4);
+  });
+}
+BENCHMARK(BM_Extract)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_ZeroExtend(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  UnaryBenchmark(state, [size](const Immediate &imm) {
+    return imm.ZeroExtend(size * 2);
+  });
+}
+BENCHMARK(BM_ZeroExtend)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_SignExtend(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  UnaryBenchmark(state, [size](const Immediate &imm) {
+    return imm.SignExtend(size * 2);
+  });
+}
+BENCHMARK(BM_SignExtend)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_Add(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  BinaryBenchmark(state, size, size,
+                  [](const Immediate &lhs, const Immediate &rhs) {
+                    return lhs + rhs;
+                  });
+}
+BENCHMARK(BM_Add)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_Subtract(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  BinaryBenchmark(state, size, size,
+                  [](const Immediate &lhs, const Immediate &rhs) {
+                    return lhs - rhs;
+                  });
+}
+BENCHMARK(BM_Subtract)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_Multiply(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  BinaryBenchmark(state, size, size,
+                  [](const Immediate &lhs, const Immediate &rhs) {
+                    return lhs * rhs;
+                  });
+}
+BENCHMARK(BM_Multiply)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_LimbMultiply(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  BinaryBenchmark(state, size, size,
+                  [](const Immediate &lhs, const Immediate &rhs) {
+                    return limb_multiply(lhs, rhs);
+                  });
+}
+BENCHMARK(BM_LimbMultiply)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_LatticeMultiply(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  BinaryBenchmark(state, size, size,
+                  [](const Immediate &lhs, const Immediate &rhs) {
+                    return lattice_multiply(lhs, rhs);
+                  });
+}
+BENCHMARK(BM_LatticeMultiply)->RangeMultiplier(2)->Range(8, 256);
+
+// karatsuba splits its operands in half, so it needs at least two bytes.
+void BM_KaratsubaMultiply(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  BinaryBenchmark(state, size, size,
+                  [](const Immediate &lhs, const Immediate &rhs) {
+                    return karatsuba_multiply(lhs, rhs);
+                  });
+}
+BENCHMARK(BM_KaratsubaMultiply)->RangeMultiplier(2)->Range(16, 256);
+
+// the divisors are half the width of the dividends, so that both the quotient
+// and the remainder are non-trivial.
+void BM_Divide(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  BinaryBenchmark(state, size, size / 2,
+                  [](const Immediate &lhs, const Immediate &rhs) {
+                    return lhs / rhs;
+                  });
+}
+BENCHMARK(BM_Divide)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_Modulus(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  BinaryBenchmark(state, size, size / 2,
+                  [](const Immediate &lhs, const Immediate &rhs) {
+                    return lhs % rhs;
+                  });
+}
+BENCHMARK(BM_Modulus)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_KnuthDivide(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  BinaryBenchmark(state, size, size / 2,
+                  [](const Immediate &lhs, const Immediate &rhs) {
+                    return knuth_divide(lhs, rhs);
+                  });
+}
+BENCHMARK(BM_KnuthDivide)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_BinaryLongDivide(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  BinaryBenchmark(state, size, size / 2,
+                  [](const Immediate &lhs, const Immediate &rhs) {
+                    return binary_long_divide(lhs, rhs);
+                  });
+}
+BENCHMARK(BM_BinaryLongDivide)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_ShiftLeft(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  UnaryBenchmark(state, [size](const Immediate &imm) {
+    return imm << static_cast<uint16_t>(size / 2 + 3);
+  });
+}
+BENCHMARK(BM_ShiftLeft)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_ShiftRight(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  UnaryBenchmark(state, [size](const Immediate &imm) {
+    return imm >> static_cast<uint16_t>(size / 2 + 3);
+  });
+}
+BENCHMARK(BM_ShiftRight)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_And(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  BinaryBenchmark(state, size, size,
+                  [](const Immediate &lhs, const Immediate &rhs) {
+                    return lhs & rhs;
+                  });
+}
+BENCHMARK(BM_And)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_Equal(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  BinaryBenchmark(state, size, size,
+                  [](const Immediate &lhs, const Immediate &rhs) {
+                    return lhs == rhs;
+                  });
+}
+BENCHMARK(BM_Equal)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_LessThan(benchmark::State &state) {
+  uint16_t size = state.range(0);
+  BinaryBenchmark(state, size, size,
+                  [](const Immediate &lhs, const Immediate &rhs) {
+                    return lhs < rhs;
+                  });
+}
+BENCHMARK(BM_LessThan)->RangeMultiplier(2)->Range(8, 256);
+
+}  // namespace reil
+
+int main(int argc, char **argv) {
+  // results are reported as json by default, so that they can be collected and
+  // compared over time; a --benchmark_format flag given on the command line
+  // comes later and so takes precedence.
+  std::string format = "--benchmark_format=json";
+  std::vector<char *> args(argv, argv + argc);
+  args.insert(args.begin() + 1, &format[0]);
+  int args_count = args.size();
+
+  benchmark::Initialize(&args_count, args.data());
+  if (benchmark::ReportUnrecognizedArguments(args_count, args.data())) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -12,8 +12,10 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <bitset>
 #include <random>
 
+#include "absl/numeric/int128.h"
 #include "gtest/gtest.h"
 
 #include "reil/immediate.h"
@@ -22,6 +24,24 @@ namespace reil {
 
 std::mt19937_64 prng;
 
+Immediate Imm128(absl::uint128 value) {
+  Immediate high(128, absl::Uint128High64(value));
+  return (high << 64) | Immediate(128, absl::Uint128Low64(value));
+}
+
+Immediate RandomImmediate(uint16_t size, uint16_t random_size) {
+  Immediate result(size);
+  for (uint16_t i = 0; i < random_size; i += 64) {
+    result |= Immediate(size, prng()) << i;
+  }
+  return result & Immediate::Mask(size, random_size);
+}
+
+absl::uint128 Uint128(const Immediate& imm) {
+  return absl::MakeUint128(static_cast<uint64_t>(imm.Extract(64, 64)),
+                           static_cast<uint64_t>(imm));
+}
+
 TEST(Immediate, Add) {
   for (int i = 0; i < 128; ++i) {
     uint32_t a = prng();
@@ -65,6 +85,136 @@ TEST(Immediate, Multiply) {
   }
 }
 
+TEST(Immediate, Add64) {
+  for (int i = 0; i < 128; ++i) {
+    uint64_t a = prng();
+    uint64_t b = prng();
+    absl::uint128 c = absl::uint128(a) + b;
+
+    Immediate C = Immediate(64, a) + Immediate(64, b);
+
+    EXPECT_EQ(C.size(), 128);
+    EXPECT_EQ(c, Uint128(C));
+  }
+}
+
+TEST(Immediate, Subtract64) {
+  for (int i = 0; i < 128; ++i) {
+    uint64_t a = prng();
+    uint64_t b = prng();
+    absl::uint128 c = absl::uint128(a) - b;
+
+    Immediate C = Immediate(64, a) - Immediate(64, b);
+
+    EXPECT_EQ(C.size(), 128);
+    EXPECT_EQ(c, Uint128(C));
+  }
+}
+
+TEST(Immediate, Multiply64) {
+  for (int i = 0; i < 0x100; ++i) {
+    uint64_t a = prng();
+    uint64_t b = prng();
+    absl::uint128 c = absl::uint128(a) * b;
+
+    Immediate A = Immediate(64, a);
+    Immediate B = Immediate(64, b);
+    Immediate C = A * B;
+
+    EXPECT_EQ(c, Uint128(C));
+    EXPECT_EQ(C, lattice_multiply(A, B));
+  }
+}
+
+TEST(Immediate, WideMultiply) {
+  for (uint16_t size : {72, 128, 192, 256, 512}) {
+    for (int i = 0; i < 32; ++i) {
+      Immediate A = RandomImmediate(size, size - 8 * (i % 4));
+      Immediate B = RandomImmediate(size, size - 8 * (i % 3));
+
+      Immediate C = A * B;
+      EXPECT_EQ(C.size(), size * 2);
+      EXPECT_EQ(C, lattice_multiply(A, B)) << A << " * " << B;
+    }
+  }
+
+  for (uint16_t size : {1024, 2048}) {
+    for (int i = 0; i < 4; ++i) {
+      Immediate A = RandomImmediate(size, size);
+      Immediate B = RandomImmediate(size, size - 64 * i);
+
+      EXPECT_EQ(A * B, karatsuba_multiply(A, B)) << A << " * " << B;
+    }
+  }
+}
+
+TEST(Immediate, WideDivide) {
+  for (uint16_t size : {192, 256, 512}) {
+    for (int i = 0; i < 64; ++i) {
+      Immediate A = RandomImmediate(size, size - 32 * (i % 3));
+      Immediate B = RandomImmediate(size, 8 + prng() % (size - 8));
+      if (!B || !(B < A)) {
+        continue;
+      }
+
+      Immediate Q = A / B;
+      Immediate R = A % B;
+      EXPECT_EQ(Q, binary_long_divide(A, B)) << A << " / " << B;
+      // binary_long_modulus returns a result 8 bits wider than its operands.
+      EXPECT_EQ(R, binary_long_modulus(A, B).Extract(size)) << A << " % " << B;
+
+      EXPECT_TRUE(R < B);
+      Immediate P = Q * B;
+      EXPECT_EQ((P + R.ZeroExtend(size * 2)).Extract(size), A);
+    }
+  }
+
+  // limbs close to the limb boundaries are what exercise the corrections to
+  // the quotient digit estimates in algorithm D.
+  const uint64_t kEdgeLimbs[] = {0, 1, 0x7fffffffffffffff, 0x8000000000000000,
+                                 0xfffffffffffffffe, 0xffffffffffffffff};
+  for (int i = 0; i < 0x1000; ++i) {
+    Immediate A(256), B(256);
+    for (int j = 0; j < 4; ++j) {
+      A |= Immediate(256, kEdgeLimbs[prng() % 6]) << (64 * j);
+      B |= Immediate(256, kEdgeLimbs[prng() % 6]) << (64 * (j % (i % 4 + 1)));
+    }
+    if (!B) {
+      continue;
+    }
+
+    Immediate Q = A / B;
+    Immediate R = A % B;
+    EXPECT_TRUE(R < B) << A << " % " << B;
+    Immediate P = Q * B;
+    EXPECT_EQ((P + R.ZeroExtend(512)).Extract(256), A) << A << " / " << B;
+  }
+}
+
+TEST(Immediate, Divide128) {
+  for (int i = 0; i < 128; ++i) {
+    absl::uint128 a = absl::MakeUint128(prng(), prng());
+    absl::uint128 b = absl::MakeUint128(prng() >> (i % 64), prng());
+
+    EXPECT_EQ(a / b, Uint128(Imm128(a) / Imm128(b)));
+    EXPECT_EQ(a % b, Uint128(Imm128(a) % Imm128(b)));
+  }
+}
+
+TEST(Immediate, SignExtend) {
+  for (int i = 0; i < 128; ++i) {
+    uint32_t a = prng();
+    uint64_t c = static_cast<int64_t>(static_cast<int32_t>(a));
+
+    Immediate C = Immediate(32, a).SignExtend(64);
+
+    EXPECT_EQ(c, static_cast<uint64_t>(C));
+
+    Immediate D = Immediate(64, c).SignExtend(192);
+    EXPECT_EQ(D.Extract(64, 128), Immediate(64, (a >> 31) ? ~0ull : 0));
+  }
+}
+
 TEST(Immediate, Divide) {
   for (int i = 0; i < 128; ++i) {
     uint32_t a = prng();
@@ -163,6 +313,30 @@ TEST(Immediate, LogicalShiftRight) {
   }
 }
 
+TEST(Immediate, WideShift) {
+  for (int i = 0; i < 128; ++i) {
+    std::bitset<256> a;
+    Immediate A(256);
+    for (int j = 0; j < 4; ++j) {
+      uint64_t limb = prng();
+      a |= std::bitset<256>(limb) << (64 * j);
+      A |= Immediate(256, limb) << (64 * j);
+    }
+    uint16_t b = prng() % 260;
+
+    std::bitset<256> left = a << b;
+    std::bitset<256> right = a >> b;
+    Immediate LEFT = A << b;
+    Immediate RIGHT = A >> b;
+    for (int j = 0; j < 4; ++j) {
+      EXPECT_EQ((left >> (64 * j) & std::bitset<256>(~0ull)).to_ullong(),
+                static_cast<uint64_t>(LEFT.Extract(64, 64 * j)));
+      EXPECT_EQ((right >> (64 * j) & std::bitset<256>(~0ull)).to_ullong(),
+                static_cast<uint64_t>(RIGHT.Extract(64, 64 * j)));
+    }
+  }
+}
+
 TEST(Immediate, Equal) {
   for (int i = 0; i < 128; ++i) {
     uint64_t a = prng();
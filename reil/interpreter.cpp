@@ -15,69 +15,77 @@
 #include "reil/interpreter.h"
 
 #include <cassert>
+#include <cstring>
 #include <stdexcept>
 
 namespace reil {
 
-Interpreter::Interpreter() {}
+Interpreter::Interpreter(uint32_t register_count)
+    : registers_(register_count) {}
 
 Interpreter::~Interpreter() {}
 
 Immediate Interpreter::GetOperand(const Operand &op) const {
-  if (absl::holds_alternative<Immediate>(op)) {
-    return absl::get<Immediate>(op);
-  } else if (absl::holds_alternative<Register>(op)) {
-    return registers_.at(absl::get<Register>(op).index);
-  } else if (absl::holds_alternative<Temporary>(op)) {
-    return temporaries_.at(absl::get<Temporary>(op).index);
+  if (op.type() == kImmediate) {
+    return op.immediate();
+  } else if (op.type() == kRegister) {
+    return registers_.Get(op.reg().index);
+  } else if (op.type() == kTemporary) {
+    return temporaries_.Get(op.temporary().index);
   } else {
     // unreachable
     abort();
   }
 }
 
-void Interpreter::SetOperand(const Operand &op, const Immediate &value) {
-  std::cerr << op << " = " << value << std::endl;
-  if (absl::holds_alternative<Register>(op)) {
-    registers_[absl::get<Register>(op).index] = value;
-  } else if (absl::holds_alternative<Temporary>(op)) {
-    temporaries_[absl::get<Temporary>(op).index] = value;
+template <typename Trace>
+void Interpreter::SetOperand(const Operand &op, const Immediate &value,
+                             Trace &trace) {
+  trace.OnWrite(op, value);
+  if (op.type() == kRegister) {
+    registers_.Set(op.reg().index, value);
+  } else if (op.type() == kTemporary) {
+    temporaries_.Set(op.temporary().index, value);
   } else {
     // unreachable
     abort();
   }
 }
 
-void Interpreter::Add(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Add(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
   Immediate b = GetOperand(ri.input1);
-  SetOperand(ri.output, a + b);
+  SetOperand(ri.output, a + b, trace);
 }
 
-void Interpreter::And(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::And(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
   Immediate b = GetOperand(ri.input1);
-  SetOperand(ri.output, a & b);
+  SetOperand(ri.output, a & b, trace);
 }
 
-void Interpreter::Bisz(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Bisz(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
-  SetOperand(ri.output, Immediate(Size(ri.output), a ? 0 : 1));
+  SetOperand(ri.output, Immediate(Size(ri.output), a ? 0 : 1), trace);
 }
 
 void Interpreter::Bsh(const Instruction &ri) {}
 
-void Interpreter::Div(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Div(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
   Immediate b = GetOperand(ri.input1);
-  SetOperand(ri.output, a / b);
+  SetOperand(ri.output, a / b, trace);
 }
 
 void Interpreter::Jcc(const Instruction &ri) {
   Immediate a = GetOperand(ri.input0);
   if (a) {
-    if (ri.output.index() == kOffset) {
-      Offset target = absl::get<Offset>(ri.output);
+    if (ri.output.type() == kOffset) {
+      Offset target = ri.output.offset();
       offset_ = target.offset;
     } else {
       Immediate target = GetOperand(ri.output);
@@ -87,93 +95,110 @@ void Interpreter::Jcc(const Instruction &ri) {
   }
 }
 
-void Interpreter::Ldm(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Ldm(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
   uint64_t address = static_cast<uint64_t>(a);
-  std::vector<uint8_t> bytes = GetMemory(address, Size(ri.output) / 8);
-  SetOperand(ri.output, Immediate(absl::Span<uint8_t>(bytes)));
+  Immediate value(Size(ri.output));
+  absl::Span<uint8_t> bytes = value.bytes();
+  memory_.Read(address, bytes.data(), bytes.size());
+  trace.OnMemoryRead(address, bytes);
+  SetOperand(ri.output, value, trace);
 }
 
-void Interpreter::Mod(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Mod(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
   Immediate b = GetOperand(ri.input1);
-  SetOperand(ri.output, a % b);
+  SetOperand(ri.output, a % b, trace);
 }
 
-void Interpreter::Mul(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Mul(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
   Immediate b = GetOperand(ri.input1);
-  SetOperand(ri.output, a * b);
+  SetOperand(ri.output, a * b, trace);
 }
 
 void Interpreter::Nop(const Instruction &ri) {}
 
-void Interpreter::Or(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Or(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
   Immediate b = GetOperand(ri.input1);
-  SetOperand(ri.output, a | b);
+  SetOperand(ri.output, a | b, trace);
 }
 
-void Interpreter::Stm(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Stm(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
   Immediate b = GetOperand(ri.output);
   uint64_t address = static_cast<uint64_t>(b);
-  SetMemory(address, a.bytes());
+  absl::Span<uint8_t> bytes = a.bytes();
+  memory_.Write(address, bytes.data(), bytes.size());
+  trace.OnMemoryWrite(address, bytes);
 }
 
-void Interpreter::Str(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Str(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
   uint16_t result_size = Size(ri.output);
   if (result_size < a.size()) {
-    SetOperand(ri.output, a.Extract(result_size));
+    SetOperand(ri.output, a.Extract(result_size), trace);
   } else if (a.size() < result_size) {
-    SetOperand(ri.output, a.ZeroExtend(Size(ri.output)));
+    SetOperand(ri.output, a.ZeroExtend(Size(ri.output)), trace);
   } else {
-    SetOperand(ri.output, a);
+    SetOperand(ri.output, a, trace);
   }
 }
 
-void Interpreter::Sub(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Sub(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
   Immediate b = GetOperand(ri.input1);
-  SetOperand(ri.output, a - b);
+  SetOperand(ri.output, a - b, trace);
 }
 
 void Interpreter::Undef(const Instruction &ri) {
-  if (absl::holds_alternative<Register>(ri.output)) {
+  if (ri.output.type() == kRegister) {
     // TODO:
-  } else if (absl::holds_alternative<Temporary>(ri.output)) {
+  } else if (ri.output.type() == kTemporary) {
     // TODO:
   }
 }
 
 void Interpreter::Unkn(const Instruction &ri) {}
 
-void Interpreter::Xor(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Xor(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
   Immediate b = GetOperand(ri.input1);
-  SetOperand(ri.output, a ^ b);
+  SetOperand(ri.output, a ^ b, trace);
 }
 
-void Interpreter::Equ(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Equ(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
   Immediate b = GetOperand(ri.input1);
-  SetOperand(ri.output, Immediate(Size(ri.output), a == b ? 1 : 0));
+  SetOperand(ri.output, Immediate(Size(ri.output), a == b ? 1 : 0), trace);
 }
 
-void Interpreter::Lshl(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Lshl(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
   Immediate b = GetOperand(ri.input1);
-  SetOperand(ri.output, a << b);
+  SetOperand(ri.output, a << b, trace);
 }
 
-void Interpreter::Lshr(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Lshr(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
   Immediate b = GetOperand(ri.input1);
-  SetOperand(ri.output, a >> b);
+  SetOperand(ri.output, a >> b, trace);
 }
 
-void Interpreter::Ashr(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Ashr(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
   Immediate b = GetOperand(ri.input1);
 
@@ -186,59 +211,62 @@ void Interpreter::Ashr(const Instruction &ri) {
     a >>= b;
   }
 
-  SetOperand(ri.output, a);
+  SetOperand(ri.output, a, trace);
 }
 
-void Interpreter::Sex(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Sex(const Instruction &ri, Trace &trace) {
   Immediate a = GetOperand(ri.input0);
   uint16_t result_size = Size(ri.output);
   if (result_size < a.size()) {
-    SetOperand(ri.output, a.Extract(result_size));
+    SetOperand(ri.output, a.Extract(result_size), trace);
   } else if (a.size() < result_size) {
-    SetOperand(ri.output, a.SignExtend(Size(ri.output)));
+    SetOperand(ri.output, a.SignExtend(Size(ri.output)), trace);
   } else {
-    SetOperand(ri.output, a);
+    SetOperand(ri.output, a, trace);
   }
 }
 
 void Interpreter::Sys(const Instruction &ri) {}
 
-void Interpreter::Ite(const Instruction &ri) {
+template <typename Trace>
+void Interpreter::Ite(const Instruction &ri, Trace &trace) {
   Immediate cond = GetOperand(ri.input0);
   Immediate if_value = GetOperand(ri.input1);
   Immediate else_value = GetOperand(ri.input2);
 
   if (cond) {
-    SetOperand(ri.output, if_value);
+    SetOperand(ri.output, if_value, trace);
   } else {
-    SetOperand(ri.output, else_value);
+    SetOperand(ri.output, else_value, trace);
   }
 }
 
-void Interpreter::Start(NativeInstruction ni) {
+void Interpreter::Start(const NativeInstruction &ni) {
   assert(ni.reil.size() < 0xffff);
 
   instructions_ = ni.reil;
   offset_ = 0;
   pc_ = ni.address;
-  temporaries_.clear();
+  temporaries_.Clear();
 }
 
-uint16_t Interpreter::SingleStep() {
-  const Instruction &ri = instructions_[offset_++];
-  std::cerr << ri << std::endl;
+template <typename Trace>
+uint16_t Interpreter::SingleStep(Trace &trace) {
+  const Instruction &ri = instructions_[offset_];
+  trace.OnInstruction(pc_, offset_++, ri);
 
   switch (ri.opcode) {
     case Opcode::Add: {
-      Add(ri);
+      Add(ri, trace);
     } break;
 
     case Opcode::And: {
-      And(ri);
+      And(ri, trace);
     } break;
 
     case Opcode::Bisz: {
-      Bisz(ri);
+      Bisz(ri, trace);
     } break;
 
     case Opcode::Bsh: {
@@ -246,7 +274,7 @@ uint16_t Interpreter::SingleStep() {
     } break;
 
     case Opcode::Div: {
-      Div(ri);
+      Div(ri, trace);
     } break;
 
     case Opcode::Jcc: {
@@ -254,15 +282,15 @@ uint16_t Interpreter::SingleStep() {
     } break;
 
     case Opcode::Ldm: {
-      Ldm(ri);
+      Ldm(ri, trace);
     } break;
 
     case Opcode::Mod: {
-      Mod(ri);
+      Mod(ri, trace);
     } break;
 
     case Opcode::Mul: {
-      Mul(ri);
+      Mul(ri, trace);
     } break;
 
     case Opcode::Nop: {
@@ -270,19 +298,19 @@ uint16_t Interpreter::SingleStep() {
     } break;
 
     case Opcode::Or: {
-      Or(ri);
+      Or(ri, trace);
     } break;
 
     case Opcode::Stm: {
-      Stm(ri);
+      Stm(ri, trace);
     } break;
 
     case Opcode::Str: {
-      Str(ri);
+      Str(ri, trace);
     } break;
 
     case Opcode::Sub: {
-      Sub(ri);
+      Sub(ri, trace);
     } break;
 
     case Opcode::Undef: {
@@ -294,27 +322,27 @@ uint16_t Interpreter::SingleStep() {
     } break;
 
     case Opcode::Xor: {
-      Xor(ri);
+      Xor(ri, trace);
     } break;
 
     case Opcode::Equ: {
-      Equ(ri);
+      Equ(ri, trace);
     } break;
 
     case Opcode::Lshl: {
-      Lshl(ri);
+      Lshl(ri, trace);
     } break;
 
     case Opcode::Lshr: {
-      Lshr(ri);
+      Lshr(ri, trace);
     } break;
 
     case Opcode::Ashr: {
-      Ashr(ri);
+      Ashr(ri, trace);
     } break;
 
     case Opcode::Sex: {
-      Sex(ri);
+      Sex(ri, trace);
     } break;
 
     case Opcode::Sys: {
@@ -322,40 +350,532 @@ uint16_t Interpreter::SingleStep() {
     } break;
 
     case Opcode::Ite: {
-      Ite(ri);
+      Ite(ri, trace);
     }
   }
 
   return offset_;
 }
 
-uint64_t Interpreter::Execute(NativeInstruction ni) {
-  Start(ni);
+uint16_t Interpreter::SingleStep() {
+  if (trace_sink_) {
+    SinkTrace trace(trace_sink_);
+    return SingleStep(trace);
+  } else {
+    NoTrace trace;
+    return SingleStep(trace);
+  }
+}
+
+template <typename Trace>
+uint64_t Interpreter::Execute(uint64_t next_pc, Trace &trace) {
   while (offset_ < instructions_.size()) {
-    SingleStep();
+    SingleStep(trace);
   }
   if (offset_ != 0xffff) {
-    pc_ = ni.address + ni.size;
+    pc_ = next_pc;
   }
   return pc_;
 }
 
+uint64_t Interpreter::Execute(const NativeInstruction &ni) {
+  uint64_t next_pc = ni.address + ni.size;
+  Start(ni);
+
+  if (trace_sink_) {
+    SinkTrace trace(trace_sink_);
+    return Execute(next_pc, trace);
+  } else {
+    NoTrace trace;
+    return Execute(next_pc, trace);
+  }
+}
+
+static inline absl::uint128 Mask128(uint16_t size) {
+  return size < 128 ? (absl::uint128(1) << size) - 1 : ~absl::uint128(0);
+}
+
+inline bool Interpreter::Load(const Bytecode &bc, const BytecodeOperand &op,
+                              uint16_t *size, absl::uint128 *value) const {
+  switch (op.type) {
+    case kImmediate: {
+      *size = op.size;
+      if (op.size <= 64) {
+        *value = op.value;
+        return true;
+      } else if (op.size <= 128) {
+        const Immediate &imm = bc.immediates[op.index];
+        *value = absl::MakeUint128(static_cast<uint64_t>(imm >> 64),
+                                   static_cast<uint64_t>(imm));
+        return true;
+      }
+      return false;
+    }
+
+    case kRegister: {
+      *size = registers_.size(op.index);
+      if (*size <= 128) {
+        *value = registers_.GetValue(op.index);
+        return true;
+      }
+      return false;
+    }
+
+    case kTemporary: {
+      *size = temporaries_.size(op.index);
+      if (*size <= 128) {
+        *value = temporaries_.GetValue(op.index);
+        return true;
+      }
+      return false;
+    }
+
+    default: {
+      // unreachable
+      abort();
+    }
+  }
+}
+
+inline Immediate Interpreter::LoadImmediate(const Bytecode &bc,
+                                            const BytecodeOperand &op) const {
+  switch (op.type) {
+    case kImmediate: {
+      if (op.size <= 64) {
+        return Immediate(op.size, op.value);
+      }
+      return bc.immediates[op.index];
+    }
+
+    case kRegister: {
+      return registers_.Get(op.index);
+    }
+
+    case kTemporary: {
+      return temporaries_.Get(op.index);
+    }
+
+    default: {
+      // unreachable
+      abort();
+    }
+  }
+}
+
+inline bool Interpreter::LoadBool(const Bytecode &bc,
+                                  const BytecodeOperand &op) const {
+  uint16_t size;
+  absl::uint128 value;
+  if (Load(bc, op, &size, &value)) {
+    return value != 0;
+  }
+  return static_cast<bool>(LoadImmediate(bc, op));
+}
+
+inline void Interpreter::Store(const BytecodeOperand &op, uint16_t size,
+                               absl::uint128 value) {
+  if (op.type == kRegister) {
+    registers_.SetValue(op.index, size, value);
+  } else if (op.type == kTemporary) {
+    temporaries_.SetValue(op.index, size, value);
+  } else {
+    // unreachable
+    abort();
+  }
+}
+
+inline void Interpreter::Store(const BytecodeOperand &op,
+                               const Immediate &value) {
+  if (op.type == kRegister) {
+    registers_.Set(op.index, value);
+  } else if (op.type == kTemporary) {
+    temporaries_.Set(op.index, value);
+  } else {
+    // unreachable
+    abort();
+  }
+}
+
+// the handlers below compute on unboxed values when the operand and result
+// sizes allow it, and otherwise fall back to exactly what the corresponding
+// Instruction handler does. sizes of values are always whole bytes, since
+// that's all an Immediate can represent, so declared sizes are rounded down to
+// match.
+//
+// with gcc and clang, dispatch uses computed gotos, so that every handler ends
+// with its own indirect branch; otherwise it's a plain switch.
+#if defined(__GNUC__)
+#define REIL_COMPUTED_GOTO 1
+#define REIL_OPCODE(name) op_##name:
+#define REIL_DISPATCH()                            \
+  if (ip >= end) goto done;                        \
+  goto *kDispatch[static_cast<uint8_t>(ip->opcode)]
+#else
+#define REIL_COMPUTED_GOTO 0
+#define REIL_OPCODE(name) case Opcode::name:
+#define REIL_DISPATCH()     \
+  if (ip >= end) goto done; \
+  continue
+#endif
+#define REIL_NEXT() \
+  ++ip;             \
+  REIL_DISPATCH()
+
+uint64_t Interpreter::Execute(const Bytecode &bc) {
+  const BytecodeInstruction *code = bc.code.data();
+  const BytecodeInstruction *end = code + bc.code.size();
+  const BytecodeInstruction *ip = code;
+  bool jumped = false;
+
+  uint16_t a_size, b_size, c_size;
+  absl::uint128 a, b, c;
+
+  instructions_ = absl::Span<const Instruction>();
+  offset_ = 0;
+  pc_ = bc.address;
+  temporaries_.Clear();
+
+#if REIL_COMPUTED_GOTO
+  static_assert(static_cast<uint8_t>(Opcode::Ite) == 23,
+                "dispatch table must match Opcode");
+  static const void *const kDispatch[] = {
+      &&op_Add,  &&op_And,   &&op_Bisz, &&op_Bsh,  &&op_Div,  &&op_Jcc,
+      &&op_Ldm,  &&op_Mod,   &&op_Mul,  &&op_Nop,  &&op_Or,   &&op_Stm,
+      &&op_Str,  &&op_Sub,   &&op_Undef, &&op_Unkn, &&op_Xor, &&op_Equ,
+      &&op_Lshl, &&op_Lshr,  &&op_Ashr, &&op_Sex,  &&op_Sys,  &&op_Ite,
+  };
+  REIL_DISPATCH();
+#else
+  if (ip >= end) goto done;
+  for (;;) {
+    switch (ip->opcode) {
+#endif
+
+  REIL_OPCODE(Add) {
+    if (Load(bc, ip->input0, &a_size, &a) &&
+        Load(bc, ip->input1, &b_size, &b) && a_size <= 64) {
+      Store(ip->output, a_size * 2, a + b);
+    } else {
+      Store(ip->output,
+            LoadImmediate(bc, ip->input0) + LoadImmediate(bc, ip->input1));
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(And) {
+    if (Load(bc, ip->input0, &a_size, &a) &&
+        Load(bc, ip->input1, &b_size, &b)) {
+      Store(ip->output, a_size, a & b);
+    } else {
+      Store(ip->output,
+            LoadImmediate(bc, ip->input0) & LoadImmediate(bc, ip->input1));
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Bisz) {
+    Store(ip->output, ip->output.size & ~7,
+          LoadBool(bc, ip->input0) ? 0 : 1);
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Div) {
+    if (Load(bc, ip->input0, &a_size, &a) &&
+        Load(bc, ip->input1, &b_size, &b)) {
+      if (b == 0) {
+        // as for Immediate, the quotient of a division by zero is zero.
+        Store(ip->output, a_size, 0);
+      } else if (a_size <= 64) {
+        Store(ip->output, a_size,
+              absl::Uint128Low64(a) / absl::Uint128Low64(b));
+      } else {
+        Store(ip->output, a_size, a / b);
+      }
+    } else {
+      Store(ip->output,
+            LoadImmediate(bc, ip->input0) / LoadImmediate(bc, ip->input1));
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Jcc) {
+    if (LoadBool(bc, ip->input0)) {
+      if (ip->output.type == kOffset) {
+        ip = code + ip->output.index;
+        REIL_DISPATCH();
+      }
+
+      if (Load(bc, ip->output, &a_size, &a)) {
+        pc_ = absl::Uint128Low64(a);
+      } else {
+        pc_ = static_cast<uint64_t>(LoadImmediate(bc, ip->output));
+      }
+      jumped = true;
+      goto done;
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Ldm) {
+    uint64_t address;
+    if (Load(bc, ip->input0, &a_size, &a)) {
+      address = absl::Uint128Low64(a);
+    } else {
+      address = static_cast<uint64_t>(LoadImmediate(bc, ip->input0));
+    }
+
+    uint16_t size = ip->output.size & ~7;
+    if (size <= 128) {
+      uint64_t value[2] = {0, 0};
+      memory_.Read(address, reinterpret_cast<uint8_t *>(value), size / 8);
+      Store(ip->output, size, absl::MakeUint128(value[1], value[0]));
+    } else {
+      Immediate value(size);
+      absl::Span<uint8_t> bytes = value.bytes();
+      memory_.Read(address, bytes.data(), bytes.size());
+      Store(ip->output, value);
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Mod) {
+    if (Load(bc, ip->input0, &a_size, &a) &&
+        Load(bc, ip->input1, &b_size, &b)) {
+      if (b == 0) {
+        // as for Immediate, the remainder of a division by zero is zero.
+        Store(ip->output, a_size, 0);
+      } else if (a_size <= 64) {
+        Store(ip->output, a_size,
+              absl::Uint128Low64(a) % absl::Uint128Low64(b));
+      } else {
+        Store(ip->output, a_size, a % b);
+      }
+    } else {
+      Store(ip->output,
+            LoadImmediate(bc, ip->input0) % LoadImmediate(bc, ip->input1));
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Mul) {
+    if (Load(bc, ip->input0, &a_size, &a) &&
+        Load(bc, ip->input1, &b_size, &b) && a_size <= 64) {
+      // products of 32 bits or less are always 64 bits wide.
+      Store(ip->output, a_size <= 32 ? 64 : a_size * 2, a * b);
+    } else {
+      Store(ip->output,
+            LoadImmediate(bc, ip->input0) * LoadImmediate(bc, ip->input1));
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Or) {
+    if (Load(bc, ip->input0, &a_size, &a) &&
+        Load(bc, ip->input1, &b_size, &b)) {
+      Store(ip->output, a_size, a | b);
+    } else {
+      Store(ip->output,
+            LoadImmediate(bc, ip->input0) | LoadImmediate(bc, ip->input1));
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Stm) {
+    uint64_t address;
+    if (Load(bc, ip->output, &b_size, &b)) {
+      address = absl::Uint128Low64(b);
+    } else {
+      address = static_cast<uint64_t>(LoadImmediate(bc, ip->output));
+    }
+
+    if (Load(bc, ip->input0, &a_size, &a)) {
+      uint64_t value[2] = {absl::Uint128Low64(a), absl::Uint128High64(a)};
+      memory_.Write(address, reinterpret_cast<uint8_t *>(value), a_size / 8);
+    } else {
+      Immediate value = LoadImmediate(bc, ip->input0);
+      absl::Span<uint8_t> bytes = value.bytes();
+      memory_.Write(address, bytes.data(), bytes.size());
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Str) {
+    uint16_t size = ip->output.size & ~7;
+    if (size <= 128 && Load(bc, ip->input0, &a_size, &a)) {
+      Store(ip->output, size, a);
+    } else {
+      Immediate value = LoadImmediate(bc, ip->input0);
+      if (ip->output.size < value.size()) {
+        Store(ip->output, value.Extract(ip->output.size));
+      } else if (value.size() < ip->output.size) {
+        Store(ip->output, value.ZeroExtend(ip->output.size));
+      } else {
+        Store(ip->output, value);
+      }
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Sub) {
+    if (Load(bc, ip->input0, &a_size, &a) &&
+        Load(bc, ip->input1, &b_size, &b) && a_size <= 64) {
+      Store(ip->output, a_size * 2, a - b);
+    } else {
+      Store(ip->output,
+            LoadImmediate(bc, ip->input0) - LoadImmediate(bc, ip->input1));
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Xor) {
+    if (Load(bc, ip->input0, &a_size, &a) &&
+        Load(bc, ip->input1, &b_size, &b)) {
+      Store(ip->output, a_size, a ^ b);
+    } else {
+      Store(ip->output,
+            LoadImmediate(bc, ip->input0) ^ LoadImmediate(bc, ip->input1));
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Equ) {
+    bool equal;
+    if (Load(bc, ip->input0, &a_size, &a) &&
+        Load(bc, ip->input1, &b_size, &b)) {
+      equal = a == b;
+    } else {
+      equal = LoadImmediate(bc, ip->input0) == LoadImmediate(bc, ip->input1);
+    }
+    Store(ip->output, ip->output.size & ~7, equal ? 1 : 0);
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Lshl) {
+    if (Load(bc, ip->input0, &a_size, &a) &&
+        Load(bc, ip->input1, &b_size, &b)) {
+      uint16_t shift = static_cast<uint16_t>(absl::Uint128Low64(b));
+      Store(ip->output, a_size, shift < a_size ? a << shift : 0);
+    } else {
+      Store(ip->output,
+            LoadImmediate(bc, ip->input0) << LoadImmediate(bc, ip->input1));
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Lshr) {
+    if (Load(bc, ip->input0, &a_size, &a) &&
+        Load(bc, ip->input1, &b_size, &b)) {
+      uint16_t shift = static_cast<uint16_t>(absl::Uint128Low64(b));
+      Store(ip->output, a_size, shift < a_size ? a >> shift : 0);
+    } else {
+      Store(ip->output,
+            LoadImmediate(bc, ip->input0) >> LoadImmediate(bc, ip->input1));
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Ashr) {
+    if (Load(bc, ip->input0, &a_size, &a) &&
+        Load(bc, ip->input1, &b_size, &b)) {
+      uint64_t shift64 = absl::Uint128Low64(b);
+      uint16_t shift = static_cast<uint16_t>(shift64);
+      uint16_t fill_shift = static_cast<uint16_t>(a_size - shift64);
+      bool negative = a_size && (a >> (a_size - 1)) != 0;
+
+      c = shift < a_size ? a >> shift : 0;
+      if (negative && fill_shift < a_size) {
+        c |= Mask128(a_size) << fill_shift;
+      }
+      Store(ip->output, a_size, c);
+    } else {
+      Immediate value = LoadImmediate(bc, ip->input0);
+      Immediate shift = LoadImmediate(bc, ip->input1);
+      uint16_t size = value.size();
+      if (Immediate::SignBit(size, size) & value) {
+        value >>= shift;
+        value |= Immediate::Mask(size, size) << (size - (uint64_t)shift);
+      } else {
+        value >>= shift;
+      }
+      Store(ip->output, value);
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Sex) {
+    uint16_t size = ip->output.size & ~7;
+    if (size <= 128 && Load(bc, ip->input0, &a_size, &a)) {
+      if (a_size < size && a_size && (a >> (a_size - 1)) != 0) {
+        a |= Mask128(size) & ~Mask128(a_size);
+      }
+      Store(ip->output, size, a);
+    } else {
+      Immediate value = LoadImmediate(bc, ip->input0);
+      if (ip->output.size < value.size()) {
+        Store(ip->output, value.Extract(ip->output.size));
+      } else if (value.size() < ip->output.size) {
+        Store(ip->output, value.SignExtend(ip->output.size));
+      } else {
+        Store(ip->output, value);
+      }
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Ite) {
+    const BytecodeOperand &op =
+        LoadBool(bc, ip->input0) ? ip->input1 : ip->input2;
+    if (Load(bc, op, &c_size, &c)) {
+      Store(ip->output, c_size, c);
+    } else {
+      Store(ip->output, LoadImmediate(bc, op));
+    }
+  }
+  REIL_NEXT();
+
+  REIL_OPCODE(Bsh)
+  REIL_OPCODE(Nop)
+  REIL_OPCODE(Undef)
+  REIL_OPCODE(Unkn)
+  REIL_OPCODE(Sys) {}
+  REIL_NEXT();
+
+#if !REIL_COMPUTED_GOTO
+    }
+  }
+#endif
+
+done:
+  if (!jumped) {
+    pc_ = bc.address + bc.size;
+  }
+  return pc_;
+}
+
+#undef REIL_NEXT
+#undef REIL_DISPATCH
+#undef REIL_OPCODE
+#undef REIL_COMPUTED_GOTO
+
 Immediate Interpreter::GetRegister(uint32_t index) const {
-  return registers_.at(index);
+  return registers_.Get(index);
 }
 
 void Interpreter::SetRegister(uint32_t index, const Immediate &value) {
-  registers_[index] = value;
+  registers_.Set(index, value);
 }
 
 std::vector<uint8_t> Interpreter::GetMemory(uint64_t address, size_t size) {
-  std::vector<uint8_t> bytes;
-  for (size_t i = 0; i < size; ++i) {
-    bytes.push_back(memory_[address + i]);
-  }
+  std::vector<uint8_t> bytes(size);
+  memory_.Read(address, bytes.data(), bytes.size());
   return bytes;
 }
 
+void Interpreter::MapMemory(uint64_t address,
+                            absl::Span<const uint8_t> bytes) {
+  memory_.Map(address, bytes);
+}
+
 void Interpreter::SetMemory(uint64_t address,
                             const absl::Span<uint8_t> &bytes) {
   SetMemory(address, bytes.data(), bytes.size());
@@ -363,8 +883,6 @@ void Interpreter::SetMemory(uint64_t address,
 
 void Interpreter::SetMemory(uint64_t address, const uint8_t *bytes,
                             size_t bytes_len) {
-  for (size_t i = 0; i < bytes_len; ++i) {
-    memory_[address + i] = bytes[i];
-  }
+  memory_.Write(address, bytes, bytes_len);
 }
 }  // namespace reil
@@ -14,64 +14,119 @@
 
 #ifndef REIL_INTERPRETER_H_
 
-#include <map>
 #include <vector>
 
+#include "absl/numeric/int128.h"
 #include "absl/types/span.h"
 
+#include "reil/bytecode.h"
+#include "reil/memory.h"
+#include "reil/register_file.h"
 #include "reil/reil.h"
+#include "reil/trace.h"
 
 namespace reil {
 class Interpreter {
  private:
-  std::map<uint64_t, uint8_t> memory_;
-  std::map<uint32_t, Immediate> registers_;
-  std::map<uint32_t, Immediate> temporaries_;
+  Memory memory_;
+  RegisterFile registers_;
+  RegisterFile temporaries_;
 
-  std::vector<Instruction> instructions_;
+  absl::Span<const Instruction> instructions_;
   uint64_t pc_;
   uint16_t offset_;
 
+  TraceSink *trace_sink_ = nullptr;
+
   Immediate GetOperand(const Operand &op) const;
-  void SetOperand(const Operand &op, const Immediate &value);
+  template <typename Trace>
+  void SetOperand(const Operand &op, const Immediate &value, Trace &trace);
 
-  void Add(const Instruction &ri);
-  void And(const Instruction &ri);
-  void Bisz(const Instruction &ri);
+  template <typename Trace>
+  void Add(const Instruction &ri, Trace &trace);
+  template <typename Trace>
+  void And(const Instruction &ri, Trace &trace);
+  template <typename Trace>
+  void Bisz(const Instruction &ri, Trace &trace);
   void Bsh(const Instruction &ri);
-  void Div(const Instruction &ri);
+  template <typename Trace>
+  void Div(const Instruction &ri, Trace &trace);
   void Jcc(const Instruction &ri);
-  void Ldm(const Instruction &ri);
-  void Mod(const Instruction &ri);
-  void Mul(const Instruction &ri);
+  template <typename Trace>
+  void Ldm(const Instruction &ri, Trace &trace);
+  template <typename Trace>
+  void Mod(const Instruction &ri, Trace &trace);
+  template <typename Trace>
+  void Mul(const Instruction &ri, Trace &trace);
   void Nop(const Instruction &ri);
-  void Or(const Instruction &ri);
-  void Stm(const Instruction &ri);
-  void Str(const Instruction &ri);
-  void Sub(const Instruction &ri);
+  template <typename Trace>
+  void Or(const Instruction &ri, Trace &trace);
+  template <typename Trace>
+  void Stm(const Instruction &ri, Trace &trace);
+  template <typename Trace>
+  void Str(const Instruction &ri, Trace &trace);
+  template <typename Trace>
+  void Sub(const Instruction &ri, Trace &trace);
   void Undef(const Instruction &ri);
   void Unkn(const Instruction &ri);
-  void Xor(const Instruction &ri);
-  void Equ(const Instruction &ri);
-  void Lshl(const Instruction &ri);
-  void Lshr(const Instruction &ri);
-  void Ashr(const Instruction &ri);
-  void Sex(const Instruction &ri);
+  template <typename Trace>
+  void Xor(const Instruction &ri, Trace &trace);
+  template <typename Trace>
+  void Equ(const Instruction &ri, Trace &trace);
+  template <typename Trace>
+  void Lshl(const Instruction &ri, Trace &trace);
+  template <typename Trace>
+  void Lshr(const Instruction &ri, Trace &trace);
+  template <typename Trace>
+  void Ashr(const Instruction &ri, Trace &trace);
+  template <typename Trace>
+  void Sex(const Instruction &ri, Trace &trace);
   void Sys(const Instruction &ri);
-  void Ite(const Instruction &ri);
+  template <typename Trace>
+  void Ite(const Instruction &ri, Trace &trace);
+
+  template <typename Trace>
+  uint16_t SingleStep(Trace &trace);
+  template <typename Trace>
+  uint64_t Execute(uint64_t next_pc, Trace &trace);
+
+  // bytecode operands are loaded unboxed when they are 128 bits or less, and
+  // as Immediates otherwise.
+  bool Load(const Bytecode &bc, const BytecodeOperand &op, uint16_t *size,
+            absl::uint128 *value) const;
+  Immediate LoadImmediate(const Bytecode &bc, const BytecodeOperand &op) const;
+  bool LoadBool(const Bytecode &bc, const BytecodeOperand &op) const;
+  void Store(const BytecodeOperand &op, uint16_t size, absl::uint128 value);
+  void Store(const BytecodeOperand &op, const Immediate &value);
 
  public:
-  Interpreter();
+  explicit Interpreter(uint32_t register_count = 0);
   ~Interpreter();
 
-  void Start(NativeInstruction ni);
+  // Execution is only traced while a TraceSink is set; without one the
+  // interpreter runs a specialisation with no tracing code at all.
+  TraceSink *trace_sink() const { return trace_sink_; }
+  void set_trace_sink(TraceSink *trace_sink) { trace_sink_ = trace_sink; }
+
+  // The interpreter executes ni.reil in place, so ni must outlive the calls to
+  // SingleStep (or Execute) that run it; this lets callers keep translations
+  // cached and run them repeatedly without copying.
+  void Start(const NativeInstruction &ni);
   uint16_t SingleStep();
-  uint64_t Execute(NativeInstruction ni);
+  uint64_t Execute(const NativeInstruction &ni);
+
+  // Executes a compiled native instruction, with the same results as executing
+  // the NativeInstruction it was compiled from. This is never traced.
+  uint64_t Execute(const Bytecode &bc);
 
   Immediate GetRegister(uint32_t index) const;
   void SetRegister(uint32_t index, const Immediate &value);
 
+  Memory &memory() { return memory_; }
+  const Memory &memory() const { return memory_; }
+
   std::vector<uint8_t> GetMemory(uint64_t address, size_t size);
+  void MapMemory(uint64_t address, absl::Span<const uint8_t> bytes);
   void SetMemory(uint64_t address, const absl::Span<uint8_t> &bytes);
   void SetMemory(uint64_t address, const uint8_t *bytes, size_t bytes_len);
 };
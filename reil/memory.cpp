@@ -0,0 +1,177 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "reil/memory.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace reil {
+constexpr uint64_t Memory::kPageSize;
+constexpr uint64_t Memory::kPageMask;
+
+Memory::Memory() {}
+
+Memory::Memory(const Memory& other)
+    : pages_(other.pages_), written_pages_(other.written_pages_) {}
+
+Memory::Memory(Memory&& other)
+    : pages_(std::move(other.pages_)),
+      written_pages_(std::move(other.written_pages_)) {
+  other.FlushTlb();
+}
+
+Memory::~Memory() {}
+
+Memory& Memory::operator=(const Memory& other) {
+  if (this != &other) {
+    pages_ = other.pages_;
+    written_pages_ = other.written_pages_;
+    FlushTlb();
+  }
+  return *this;
+}
+
+Memory& Memory::operator=(Memory&& other) {
+  if (this != &other) {
+    pages_ = std::move(other.pages_);
+    written_pages_ = std::move(other.written_pages_);
+    FlushTlb();
+    other.FlushTlb();
+  }
+  return *this;
+}
+
+void Memory::FlushTlb() {
+  tlb_address_ = 1;
+  tlb_page_ = nullptr;
+}
+
+void Memory::Written(uint64_t page_address, Page* page) {
+  page->watched = false;
+  written_pages_.push_back(page_address);
+}
+
+uint8_t* Memory::WritablePage(uint64_t page_address) {
+  Page* page = FindPage(page_address);
+  if (!page) {
+    page = &pages_[page_address];
+    tlb_address_ = page_address;
+    tlb_page_ = page;
+  } else if (page->watched) {
+    Written(page_address, page);
+  }
+
+  // the page is either backed by memory we don't own, or shared with a copy of
+  // this Memory, so we need to take a private copy before writing.
+  if (!page->owned || page->owned.use_count() > 1) {
+    auto owned = std::make_shared<PageData>();
+    if (page->data) {
+      memcpy(owned->data(), page->data, kPageSize);
+    } else {
+      memset(owned->data(), 0, kPageSize);
+    }
+    page->owned = std::move(owned);
+    page->data = page->owned->data();
+  }
+
+  return page->owned->data();
+}
+
+void Memory::Map(uint64_t address, absl::Span<const uint8_t> bytes) {
+  const uint8_t* data = bytes.data();
+  size_t size = bytes.size();
+
+  while (size) {
+    uint64_t page_address = address & ~kPageMask;
+    uint64_t offset = address & kPageMask;
+    size_t chunk_size = std::min<size_t>(size, kPageSize - offset);
+
+    if (chunk_size == kPageSize) {
+      Page& page = pages_[page_address];
+      if (page.watched) {
+        Written(page_address, &page);
+      }
+      page.data = data;
+      page.owned.reset();
+    } else {
+      memcpy(WritablePage(page_address) + offset, data, chunk_size);
+    }
+
+    address += chunk_size;
+    data += chunk_size;
+    size -= chunk_size;
+  }
+}
+
+bool Memory::Mapped(uint64_t address, size_t size) const {
+  uint64_t page_address = address & ~kPageMask;
+  uint64_t end_address = address + size;
+  do {
+    if (!pages_.count(page_address)) {
+      return false;
+    }
+    page_address += kPageSize;
+  } while (page_address < end_address && page_address != 0);
+  return true;
+}
+
+void Memory::Read(uint64_t address, uint8_t* bytes, size_t bytes_len) {
+  while (bytes_len) {
+    uint64_t offset = address & kPageMask;
+    size_t chunk_size = std::min<size_t>(bytes_len, kPageSize - offset);
+
+    Page* page = FindPage(address & ~kPageMask);
+    if (page) {
+      memcpy(bytes, page->data + offset, chunk_size);
+    } else {
+      memset(bytes, 0, chunk_size);
+    }
+
+    address += chunk_size;
+    bytes += chunk_size;
+    bytes_len -= chunk_size;
+  }
+}
+
+void Memory::Write(uint64_t address, const uint8_t* bytes, size_t bytes_len) {
+  while (bytes_len) {
+    uint64_t offset = address & kPageMask;
+    size_t chunk_size = std::min<size_t>(bytes_len, kPageSize - offset);
+
+    memcpy(WritablePage(address & ~kPageMask) + offset, bytes, chunk_size);
+
+    address += chunk_size;
+    bytes += chunk_size;
+    bytes_len -= chunk_size;
+  }
+}
+
+void Memory::Watch(uint64_t address) {
+  auto page_iter = pages_.find(address & ~kPageMask);
+  if (page_iter != pages_.end()) {
+    page_iter->second.watched = true;
+  }
+}
+
+void Memory::Clear() {
+  for (auto& page : pages_) {
+    if (page.second.watched) {
+      written_pages_.push_back(page.first);
+    }
+  }
+  pages_.clear();
+  FlushTlb();
+}
+}  // namespace reil
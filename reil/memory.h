@@ -0,0 +1,112 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef REIL_MEMORY_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/types/span.h"
+
+namespace reil {
+// Sparse, paged guest memory.
+//
+// Memory is split into 4KiB pages held in a hash page table, with a single
+// entry software TLB in front of it so that runs of accesses to the same page
+// (the common case for both instruction fetch and stack traffic) avoid the
+// table lookup entirely. Unmapped memory reads as zero.
+//
+// Pages can be backed by memory owned by someone else (typically the data of a
+// MemoryImage mapping); such pages are shared until the first write, at which
+// point they are copied. Copying a Memory shares all pages in the same way.
+//
+// Pages can also be watched, so that a client caching something derived from
+// their contents (eg. translated code) can find out when they are modified.
+class Memory {
+ public:
+  static constexpr uint64_t kPageSize = 0x1000;
+  static constexpr uint64_t kPageMask = kPageSize - 1;
+
+ private:
+  typedef std::array<uint8_t, kPageSize> PageData;
+
+  struct Page {
+    // current contents of the page, either owned or backing memory.
+    const uint8_t* data = nullptr;
+    std::shared_ptr<PageData> owned;
+    bool watched = false;
+  };
+
+  std::unordered_map<uint64_t, Page> pages_;
+  std::vector<uint64_t> written_pages_;
+
+  // page addresses are always aligned, so this never matches an empty tlb.
+  uint64_t tlb_address_ = 1;
+  Page* tlb_page_ = nullptr;
+
+  inline Page* FindPage(uint64_t page_address) {
+    if (tlb_address_ != page_address) {
+      auto page_iter = pages_.find(page_address);
+      if (page_iter == pages_.end()) {
+        return nullptr;
+      }
+      tlb_address_ = page_address;
+      tlb_page_ = &page_iter->second;
+    }
+    return tlb_page_;
+  }
+
+  uint8_t* WritablePage(uint64_t page_address);
+  void FlushTlb();
+  void Written(uint64_t page_address, Page* page);
+
+ public:
+  Memory();
+  Memory(const Memory& other);
+  Memory(Memory&& other);
+  ~Memory();
+
+  Memory& operator=(const Memory& other);
+  Memory& operator=(Memory&& other);
+
+  // Maps bytes at address without copying them. The caller must keep bytes
+  // alive for the lifetime of this Memory (and of any copies of it). Partial
+  // pages at either end of the range are copied.
+  void Map(uint64_t address, absl::Span<const uint8_t> bytes);
+
+  // Returns true if every byte in [address, address + size) has been mapped or
+  // written.
+  bool Mapped(uint64_t address, size_t size = 1) const;
+
+  void Read(uint64_t address, uint8_t* bytes, size_t bytes_len);
+  void Write(uint64_t address, const uint8_t* bytes, size_t bytes_len);
+
+  // Marks the page containing address as watched, if it is mapped. The next
+  // write to (or remapping of) a watched page unwatches it and records it in
+  // written_pages().
+  void Watch(uint64_t address);
+
+  const std::vector<uint64_t>& written_pages() const { return written_pages_; }
+  void ClearWrittenPages() { written_pages_.clear(); }
+
+  void Clear();
+};
+}  // namespace reil
+
+#define REIL_MEMORY_H_
+#endif  // REIL_MEMORY_H_
@@ -0,0 +1,111 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "reil/memory.h"
+
+namespace reil {
+
+std::mt19937_64 prng;
+
+TEST(Memory, UnmappedReadsZero) {
+  Memory memory;
+  std::vector<uint8_t> bytes(16, 0xcc);
+
+  memory.Read(0x1000, bytes.data(), bytes.size());
+
+  EXPECT_EQ(bytes, std::vector<uint8_t>(16, 0));
+  EXPECT_FALSE(memory.Mapped(0x1000));
+}
+
+TEST(Memory, ReadWriteAcrossPages) {
+  Memory memory;
+  std::vector<uint8_t> bytes(0x2010);
+  for (auto& byte : bytes) {
+    byte = prng();
+  }
+
+  memory.Write(0x1ff8, bytes.data(), bytes.size());
+  EXPECT_TRUE(memory.Mapped(0x1ff8, bytes.size()));
+  EXPECT_FALSE(memory.Mapped(0x1ff8, 0x4000));
+
+  std::vector<uint8_t> result(bytes.size());
+  memory.Read(0x1ff8, result.data(), result.size());
+  EXPECT_EQ(bytes, result);
+}
+
+TEST(Memory, MapIsCopyOnWrite) {
+  std::vector<uint8_t> backing(0x2000, 0x41);
+  Memory memory;
+
+  memory.Map(0x4000, absl::Span<const uint8_t>(backing));
+  EXPECT_TRUE(memory.Mapped(0x4000, backing.size()));
+
+  uint8_t value = 0x42;
+  memory.Write(0x5004, &value, sizeof(value));
+
+  uint8_t result[2];
+  memory.Read(0x5003, result, sizeof(result));
+  EXPECT_EQ(result[0], 0x41);
+  EXPECT_EQ(result[1], 0x42);
+
+  // the backing memory must not be modified by writes.
+  EXPECT_EQ(backing[0x1004], 0x41);
+
+  // and pages that haven't been written to are still shared with it.
+  backing[0x10] = 0x43;
+  memory.Read(0x4010, result, 1);
+  EXPECT_EQ(result[0], 0x43);
+}
+
+TEST(Memory, MapPartialPage) {
+  std::vector<uint8_t> backing(0x10, 0x41);
+  Memory memory;
+
+  memory.Map(0x4ff8, absl::Span<const uint8_t>(backing));
+  EXPECT_TRUE(memory.Mapped(0x4000));
+  EXPECT_TRUE(memory.Mapped(0x5000));
+
+  uint8_t result[0x20];
+  memory.Read(0x4ff0, result, sizeof(result));
+  for (int i = 0; i < 0x20; ++i) {
+    EXPECT_EQ(result[i], (0x8 <= i && i < 0x18) ? 0x41 : 0);
+  }
+}
+
+TEST(Memory, CopyIsCopyOnWrite) {
+  Memory memory;
+  uint8_t value = 0x41;
+  memory.Write(0x1000, &value, sizeof(value));
+
+  Memory copy(memory);
+  value = 0x42;
+  copy.Write(0x1000, &value, sizeof(value));
+
+  memory.Read(0x1000, &value, sizeof(value));
+  EXPECT_EQ(value, 0x41);
+  copy.Read(0x1000, &value, sizeof(value));
+  EXPECT_EQ(value, 0x42);
+}
+
+}  // namespace reil
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
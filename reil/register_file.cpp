@@ -0,0 +1,113 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "reil/register_file.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "glog/logging.h"
+
+namespace reil {
+RegisterFile::RegisterFile(uint32_t size) : slots_(size) {}
+
+Immediate RegisterFile::Get(uint32_t index) const {
+  if (!defined(index)) {
+    throw std::out_of_range("undefined register");
+  }
+
+  const Slot& slot = slots_[index];
+  if (slot.size <= 64) {
+    return Immediate(slot.size, slot.low);
+  } else if (slot.size <= 128) {
+    Immediate value(slot.size);
+    absl::Span<uint8_t> bytes = value.bytes();
+    memcpy(bytes.data(), &slot.low, sizeof(slot.low));
+    memcpy(bytes.data() + sizeof(slot.low), &slot.high,
+           bytes.size() - sizeof(slot.low));
+    return value;
+  }
+  return wide_values_[index];
+}
+
+void RegisterFile::Set(uint32_t index, const Immediate& value) {
+  if (value.size() <= 64) {
+    SetValue(index, value.size(), static_cast<uint64_t>(value));
+    return;
+  } else if (value.size() <= 128) {
+    Immediate high = value >> 64;
+    SetValue(index, value.size(),
+             absl::MakeUint128(static_cast<uint64_t>(high),
+                               static_cast<uint64_t>(value)));
+    return;
+  }
+
+  if (index >= slots_.size()) {
+    slots_.resize(index + 1);
+  }
+  if (index >= wide_values_.size()) {
+    wide_values_.resize(index + 1);
+  }
+
+  Slot& slot = slots_[index];
+  slot.generation = generation_;
+  slot.size = value.size();
+  wide_values_[index] = value;
+}
+
+absl::uint128 RegisterFile::GetValue(uint32_t index) const {
+  if (!defined(index)) {
+    throw std::out_of_range("undefined register");
+  }
+
+  const Slot& slot = slots_[index];
+  if (slot.size <= 128) {
+    return absl::MakeUint128(slot.high, slot.low);
+  }
+
+  const Immediate& value = wide_values_[index];
+  Immediate high = value.Extract(64, 64);
+  return absl::MakeUint128(static_cast<uint64_t>(high),
+                           static_cast<uint64_t>(value));
+}
+
+void RegisterFile::SetValue(uint32_t index, uint16_t size,
+                            absl::uint128 value) {
+  DCHECK(size <= 128);
+
+  if (index >= slots_.size()) {
+    slots_.resize(index + 1);
+  }
+
+  if (size < 128) {
+    value &= (absl::uint128(1) << size) - 1;
+  }
+
+  Slot& slot = slots_[index];
+  slot.generation = generation_;
+  slot.size = size;
+  slot.low = absl::Uint128Low64(value);
+  slot.high = absl::Uint128High64(value);
+}
+
+void RegisterFile::Clear() {
+  if (++generation_ == 0) {
+    // the generation counter wrapped, so stale slots could now look defined.
+    for (auto& slot : slots_) {
+      slot.generation = 0;
+    }
+    generation_ = 1;
+  }
+}
+}  // namespace reil
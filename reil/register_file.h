@@ -0,0 +1,69 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef REIL_REGISTER_FILE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/numeric/int128.h"
+
+#include "reil/immediate.h"
+
+namespace reil {
+// Dense, index-addressed storage for register or temporary values.
+//
+// Values of up to 128 bits are stored unboxed in the slot itself; only wider
+// values (eg. intermediate products of vector registers) are stored as an
+// Immediate. Clear() is constant time, so the same RegisterFile can be reused
+// for the temporaries of every native instruction.
+class RegisterFile {
+  struct Slot {
+    uint32_t generation = 0;
+    uint16_t size = 0;
+    uint64_t low = 0;
+    uint64_t high = 0;
+  };
+
+  std::vector<Slot> slots_;
+  std::vector<Immediate> wide_values_;
+  uint32_t generation_ = 1;
+
+ public:
+  explicit RegisterFile(uint32_t size = 0);
+
+  inline bool defined(uint32_t index) const {
+    return index < slots_.size() && slots_[index].generation == generation_;
+  }
+
+  // returns the size in bits of the value at index, or 0 if it is undefined.
+  inline uint16_t size(uint32_t index) const {
+    return defined(index) ? slots_[index].size : 0;
+  }
+
+  Immediate Get(uint32_t index) const;
+  void Set(uint32_t index, const Immediate& value);
+
+  // fast paths for values of 128 bits or less; GetValue returns the low 128
+  // bits of wider values.
+  absl::uint128 GetValue(uint32_t index) const;
+  void SetValue(uint32_t index, uint16_t size, absl::uint128 value);
+
+  // undefines every value.
+  void Clear();
+};
+}  // namespace reil
+
+#define REIL_REGISTER_FILE_H_
+#endif  // REIL_REGISTER_FILE_H_
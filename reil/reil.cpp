@@ -14,19 +14,96 @@
 
 #include "reil/reil.h"
 
+#include <atomic>
 #include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <type_traits>
+
+#include "glog/logging.h"
+
+#include "reil/aarch64/translator.h"
 
 namespace reil {
+static_assert(sizeof(Operand) == 16, "Operand should be packed");
+static_assert(std::is_trivially_copyable<Operand>::value,
+              "Operand should be trivially copyable");
+
 Offset::Offset(uint16_t offset) : offset(offset) {}
 
-Register::Register(uint16_t size, uint8_t index, const std::string& name)
-    : size(size), index(index), name(name) {}
+Register::Register(uint16_t size, uint8_t index) : size(size), index(index) {}
 
 Temporary::Temporary(uint16_t size, uint16_t index)
     : size(size), index(index) {}
 
 Label::Label(uint8_t index) : index(index) {}
 
+// the pool of immediates too wide to be stored inline in an Operand. values
+// are deduplicated, so the pool only grows with the number of distinct wide
+// constants, and are never removed or moved, so that looking one up (which
+// the interpreter does often) needs no locking.
+class WideImmediatePool {
+  static constexpr size_t kChunkSize = 1024;
+  static constexpr size_t kMaxChunks = 1024;
+
+  struct Less {
+    bool operator()(const Immediate& lhs, const Immediate& rhs) const {
+      if (lhs.size() != rhs.size()) {
+        return lhs.size() < rhs.size();
+      }
+      return lhs < rhs;
+    }
+  };
+
+  std::mutex mutex_;
+  std::map<Immediate, uint32_t, Less> indices_;
+  std::atomic<Immediate*> chunks_[kMaxChunks] = {};
+
+ public:
+  static WideImmediatePool& Get() {
+    static WideImmediatePool* pool = new WideImmediatePool();
+    return *pool;
+  }
+
+  uint32_t Intern(const Immediate& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = indices_.find(value);
+    if (iter != indices_.end()) {
+      return iter->second;
+    }
+
+    uint32_t index = indices_.size();
+    CHECK_LT(index / kChunkSize, kMaxChunks);
+    Immediate* chunk = chunks_[index / kChunkSize].load();
+    if (!chunk) {
+      chunk = new Immediate[kChunkSize];
+      chunks_[index / kChunkSize].store(chunk, std::memory_order_release);
+    }
+    chunk[index % kChunkSize] = value;
+    indices_.emplace(value, index);
+    return index;
+  }
+
+  const Immediate& Lookup(uint32_t index) const {
+    return chunks_[index / kChunkSize].load(
+        std::memory_order_acquire)[index % kChunkSize];
+  }
+};
+
+Operand::Operand(const Immediate& imm)
+    : type_(kImmediate), size_(imm.size()) {
+  if (size_ <= 64) {
+    value_ = static_cast<uint64_t>(imm);
+  } else {
+    index_ = WideImmediatePool::Get().Intern(imm);
+  }
+}
+
+const Immediate& Operand::WideImmediate(uint32_t index) {
+  return WideImmediatePool::Get().Lookup(index);
+}
+
 const Immediate kJump = Imm8(0);
 const Immediate kCall = Imm8(1);
 const Immediate kReturn = Imm8(2);
@@ -284,31 +361,34 @@ static std::ostream& hex(std::ostream& stream, T value, size_t width = 0) {
 }
 
 std::ostream& operator<<(std::ostream& stream, const Operand& opnd) {
-  switch (opnd.index()) {
+  switch (opnd.type()) {
+    case kNone:
+      break;
+
     case kImmediate: {
-      Immediate imm = absl::get<Immediate>(opnd);
-      stream << imm;
+      stream << opnd.immediate();
     } break;
 
     case kOffset: {
-      Offset off = absl::get<Offset>(opnd);
       stream << ".";
-      hex(stream, off.offset, 4);
+      hex(stream, opnd.offset().offset, 4);
     } break;
 
     case kRegister: {
-      Register reg = absl::get<Register>(opnd);
-      stream << "(" << reg.name << ", " << std::dec << reg.size << ")";
+      // aarch64 is the only architecture we translate, so register indices
+      // are always aarch64 registers.
+      Register reg = opnd.reg();
+      stream << "(" << aarch64::RegisterName(reg.index) << ", " << std::dec
+             << reg.size << ")";
     } break;
 
     case kTemporary: {
-      Temporary tmp = absl::get<Temporary>(opnd);
+      Temporary tmp = opnd.temporary();
       stream << "(t" << std::dec << tmp.index << ", " << tmp.size << ")";
     } break;
 
     case kLabel: {
-      Label lbl = absl::get<Label>(opnd);
-      stream << "label_" << (int)lbl.index;
+      stream << "label_" << (int)opnd.label().index;
     } break;
   }
   return stream;
@@ -413,26 +493,26 @@ std::ostream& operator<<(std::ostream& stream, const Instruction& ri) {
     } break;
   }
 
-  if (ri.input0.index() != kNone) {
+  if (ri.input0.type() != kNone) {
     stream << ri.input0;
   }
 
-  if (ri.input1.index() != kNone) {
-    if (ri.input0.index() != kNone) {
+  if (ri.input1.type() != kNone) {
+    if (ri.input0.type() != kNone) {
       stream << ", ";
     }
     stream << ri.input1;
   }
 
-  if (ri.input2.index() != kNone) {
-    if (ri.input1.index() != kNone) {
+  if (ri.input2.type() != kNone) {
+    if (ri.input1.type() != kNone) {
       stream << ", ";
     }
     stream << ri.input2;
   }
 
-  if (ri.output.index() != kNone) {
-    if (ri.input0.index() != kNone) {
+  if (ri.output.type() != kNone) {
+    if (ri.input0.type() != kNone) {
       stream << ", ";
     }
     stream << ri.output;
@@ -441,6 +521,30 @@ std::ostream& operator<<(std::ostream& stream, const Instruction& ri) {
   return stream;
 }
 
+Mnemonic::Source::~Source() {}
+
+std::string Mnemonic::str() const {
+  if (!source_) {
+    return text_;
+  }
+  std::ostringstream stream;
+  source_->Print(stream);
+  return stream.str();
+}
+
+size_t Mnemonic::memory_size() const {
+  return source_ ? source_->size() : text_.capacity();
+}
+
+std::ostream& operator<<(std::ostream& stream, const Mnemonic& mnemonic) {
+  if (mnemonic.source_) {
+    mnemonic.source_->Print(stream);
+  } else {
+    stream << mnemonic.text_;
+  }
+  return stream;
+}
+
 std::ostream& operator<<(std::ostream& stream, const NativeInstruction& ni) {
   hex(stream, ni.address) << " " << ni.mnemonic;  // << std::endl;
   // for (uint16_t i = 0; i < ni.reil.size(); ++i) {
@@ -17,10 +17,10 @@
 #include <cstdint>
 #include <iostream>
 #include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
-#include "absl/types/variant.h"
-
 #include "reil/immediate.h"
 
 namespace reil {
@@ -69,12 +69,13 @@ struct Offset {
   Offset(uint16_t offset);
 };
 
+// registers are identified by their index alone; names are looked up from
+// the architecture when printing.
 struct Register {
   uint16_t size;
   uint8_t index;
-  std::string name;
 
-  Register(uint16_t size, uint8_t index, const std::string& name);
+  Register(uint16_t size, uint8_t index);
 };
 
 struct Temporary {
@@ -90,8 +91,45 @@ struct Label {
   Label(uint8_t index);
 };
 
-typedef absl::variant<int, Immediate, Offset, Register, Temporary, Label>
-    Operand;
+// A REIL operand, packed into 16 bytes: the operand type, its size, an index
+// (of the register, temporary, label or offset) and the value of immediates
+// of 64 bits or less.
+//
+// Wider immediates are rare, so rather than making every operand big enough
+// to hold one they are interned in a global pool, and the index refers to
+// their pool entry.
+class Operand {
+  uint8_t type_ = kNone;
+  uint16_t size_ = 0;
+  uint32_t index_ = 0;
+  uint64_t value_ = 0;
+
+  static const Immediate& WideImmediate(uint32_t index);
+
+ public:
+  Operand() {}
+  Operand(const Immediate& imm);
+  Operand(const Offset& off) : type_(kOffset), index_(off.offset) {}
+  Operand(const Register& reg)
+      : type_(kRegister), size_(reg.size), index_(reg.index) {}
+  Operand(const Temporary& tmp)
+      : type_(kTemporary), size_(tmp.size), index_(tmp.index) {}
+  Operand(const Label& lbl) : type_(kLabel), index_(lbl.index) {}
+
+  OperandType type() const { return static_cast<OperandType>(type_); }
+
+  // the size in bits of an immediate, register or temporary, and zero for
+  // other operands.
+  uint16_t size() const { return size_; }
+
+  Immediate immediate() const {
+    return size_ <= 64 ? Immediate(size_, value_) : WideImmediate(index_);
+  }
+  Offset offset() const { return Offset(index_); }
+  Register reg() const { return Register(size_, index_); }
+  Temporary temporary() const { return Temporary(size_, index_); }
+  Label label() const { return Label(index_); }
+};
 
 // hints for the jcc instruction
 extern const Immediate kJump;
@@ -106,10 +144,44 @@ struct Instruction {
   Operand output;
 };
 
+// The mnemonic of a native instruction. Most analyses never look at it, so
+// translators keep what they need to format it (usually the encoding, to be
+// decoded again) and it is only formatted when printed or converted to a
+// string.
+class Mnemonic {
+ public:
+  class Source {
+   public:
+    virtual ~Source();
+    virtual void Print(std::ostream& stream) const = 0;
+    // the memory used by the source, for caches that budget for it.
+    virtual size_t size() const = 0;
+  };
+
+ private:
+  std::string text_;
+  std::shared_ptr<const Source> source_;
+
+ public:
+  Mnemonic() {}
+  Mnemonic(std::string text) : text_(std::move(text)) {}
+  explicit Mnemonic(std::shared_ptr<const Source> source)
+      : source_(std::move(source)) {}
+
+  bool empty() const { return !source_ && text_.empty(); }
+  std::string str() const;
+  // the memory used by the text or the source, which may be shared with
+  // copies of the mnemonic.
+  size_t memory_size() const;
+
+  friend std::ostream& operator<<(std::ostream& stream,
+                                  const Mnemonic& mnemonic);
+};
+
 struct NativeInstruction {
   uint64_t address = 0;
   uint8_t size = 0;
-  std::string mnemonic = "";
+  Mnemonic mnemonic;
   std::vector<Instruction> reil;
 };
 
@@ -167,20 +239,7 @@ inline Immediate Imm32(uint64_t value) { return Immediate(32, value); }
 
 inline Immediate Imm64(uint64_t value) { return Immediate(64, value); }
 
-inline uint16_t Size(const Operand& operand) {
-  switch (operand.index()) {
-    case kImmediate:
-      return absl::get<Immediate>(operand).size();
-
-    case kRegister:
-      return absl::get<Register>(operand).size;
-
-    case kTemporary:
-      return absl::get<Temporary>(operand).size;
-  }
-
-  return 0;
-}
+inline uint16_t Size(const Operand& operand) { return operand.size(); }
 
 std::ostream& operator<<(std::ostream& stream, const Operand& opnd);
 std::ostream& operator<<(std::ostream& stream, const Instruction& ri);
@@ -0,0 +1,41 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "reil/trace.h"
+
+namespace reil {
+TraceSink::~TraceSink() {}
+
+void TraceSink::OnInstruction(uint64_t address, uint16_t offset,
+                              const Instruction& ri) {}
+
+void TraceSink::OnWrite(const Operand& operand, const Immediate& value) {}
+
+void TraceSink::OnMemoryRead(uint64_t address,
+                             absl::Span<const uint8_t> bytes) {}
+
+void TraceSink::OnMemoryWrite(uint64_t address,
+                              absl::Span<const uint8_t> bytes) {}
+
+StreamTraceSink::StreamTraceSink(std::ostream& stream) : stream_(stream) {}
+
+void StreamTraceSink::OnInstruction(uint64_t address, uint16_t offset,
+                                    const Instruction& ri) {
+  stream_ << ri << std::endl;
+}
+
+void StreamTraceSink::OnWrite(const Operand& operand, const Immediate& value) {
+  stream_ << operand << " = " << value << std::endl;
+}
+}  // namespace reil
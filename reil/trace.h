@@ -0,0 +1,96 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef REIL_TRACE_H_
+
+#include <cstdint>
+#include <iostream>
+
+#include "absl/types/span.h"
+
+#include "reil/immediate.h"
+#include "reil/reil.h"
+
+namespace reil {
+// Receives execution events from the interpreter. All callbacks default to
+// doing nothing, so implementations only need to override the ones they want.
+class TraceSink {
+ public:
+  virtual ~TraceSink();
+
+  // called before each REIL instruction is executed.
+  virtual void OnInstruction(uint64_t address, uint16_t offset,
+                             const Instruction& ri);
+
+  // called whenever a register or temporary is written.
+  virtual void OnWrite(const Operand& operand, const Immediate& value);
+
+  virtual void OnMemoryRead(uint64_t address,
+                            absl::Span<const uint8_t> bytes);
+  virtual void OnMemoryWrite(uint64_t address,
+                             absl::Span<const uint8_t> bytes);
+};
+
+// Writes a textual trace of each instruction and register write to stream.
+class StreamTraceSink : public TraceSink {
+  std::ostream& stream_;
+
+ public:
+  explicit StreamTraceSink(std::ostream& stream = std::cerr);
+
+  void OnInstruction(uint64_t address, uint16_t offset,
+                     const Instruction& ri) override;
+  void OnWrite(const Operand& operand, const Immediate& value) override;
+};
+
+// Compile-time tracing policies for the interpreter. NoTrace has empty inline
+// callbacks and compiles away entirely; SinkTrace forwards to a TraceSink.
+struct NoTrace {
+  inline void OnInstruction(uint64_t address, uint16_t offset,
+                            const Instruction& ri) {}
+  inline void OnWrite(const Operand& operand, const Immediate& value) {}
+  inline void OnMemoryRead(uint64_t address,
+                           absl::Span<const uint8_t> bytes) {}
+  inline void OnMemoryWrite(uint64_t address,
+                            absl::Span<const uint8_t> bytes) {}
+};
+
+class SinkTrace {
+  TraceSink* sink_;
+
+ public:
+  explicit SinkTrace(TraceSink* sink) : sink_(sink) {}
+
+  inline void OnInstruction(uint64_t address, uint16_t offset,
+                            const Instruction& ri) {
+    sink_->OnInstruction(address, offset, ri);
+  }
+
+  inline void OnWrite(const Operand& operand, const Immediate& value) {
+    sink_->OnWrite(operand, value);
+  }
+
+  inline void OnMemoryRead(uint64_t address, absl::Span<const uint8_t> bytes) {
+    sink_->OnMemoryRead(address, bytes);
+  }
+
+  inline void OnMemoryWrite(uint64_t address,
+                            absl::Span<const uint8_t> bytes) {
+    sink_->OnMemoryWrite(address, bytes);
+  }
+};
+}  // namespace reil
+
+#define REIL_TRACE_H_
+#endif  // REIL_TRACE_H_
@@ -0,0 +1,167 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "reil/interpreter.h"
+#include "reil/trace.h"
+
+namespace reil {
+namespace test {
+// records every event as a line of text, in order.
+class RecordingTraceSink : public TraceSink {
+ public:
+  std::vector<std::string> events;
+
+  void OnInstruction(uint64_t address, uint16_t offset,
+                     const Instruction& ri) override {
+    std::stringstream stream;
+    stream << "instruction " << std::hex << address << ":" << offset << " "
+           << ri;
+    events.push_back(stream.str());
+  }
+
+  void OnWrite(const Operand& operand, const Immediate& value) override {
+    std::stringstream stream;
+    stream << "write " << operand << " " << value;
+    events.push_back(stream.str());
+  }
+
+  void OnMemoryRead(uint64_t address,
+                    absl::Span<const uint8_t> bytes) override {
+    std::stringstream stream;
+    stream << "read " << std::hex << address << " " << bytes.size();
+    events.push_back(stream.str());
+  }
+
+  void OnMemoryWrite(uint64_t address,
+                     absl::Span<const uint8_t> bytes) override {
+    std::stringstream stream;
+    stream << "write " << std::hex << address << " " << bytes.size();
+    events.push_back(stream.str());
+  }
+};
+
+// str 0x2000 to r0, stores 0x1234 there, and loads it back into t0.
+static NativeInstruction MakeInstruction() {
+  NativeInstruction ni;
+  ni.address = 0x1000;
+  ni.size = 4;
+  ni.reil.push_back(Str(Imm64(0x2000), Register(64, 0)));
+  ni.reil.push_back(Stm(Imm16(0x1234), Register(64, 0)));
+  ni.reil.push_back(Ldm(Register(64, 0), Temporary(16, 0)));
+  return ni;
+}
+
+static std::string Print(const Instruction& ri) {
+  std::stringstream stream;
+  stream << ri;
+  return stream.str();
+}
+
+static std::string Print(const Operand& operand, const Immediate& value) {
+  std::stringstream stream;
+  stream << operand << " " << value;
+  return stream.str();
+}
+
+TEST(Trace, TraceSink) {
+  NativeInstruction ni = MakeInstruction();
+  Interpreter interpreter(1);
+  RecordingTraceSink sink;
+  interpreter.set_trace_sink(&sink);
+  interpreter.Execute(ni);
+
+  std::vector<std::string> expected = {
+      "instruction 1000:0 " + Print(ni.reil[0]),
+      "write " + Print(Register(64, 0), Imm64(0x2000)),
+      "instruction 1000:1 " + Print(ni.reil[1]),
+      "write 2000 2",
+      "instruction 1000:2 " + Print(ni.reil[2]),
+      "read 2000 2",
+      "write " + Print(Temporary(16, 0), Imm16(0x1234)),
+  };
+  EXPECT_EQ(sink.events, expected);
+}
+
+TEST(Trace, NoTraceSink) {
+  // without a sink, execution is the same but nothing is traced.
+  NativeInstruction ni = MakeInstruction();
+  Interpreter interpreter(1);
+  RecordingTraceSink sink;
+  interpreter.set_trace_sink(&sink);
+  interpreter.set_trace_sink(nullptr);
+  interpreter.Execute(ni);
+
+  EXPECT_TRUE(sink.events.empty());
+  EXPECT_EQ(interpreter.GetRegister(0), Imm64(0x2000));
+  EXPECT_EQ(interpreter.GetMemory(0x2000, 2),
+            std::vector<uint8_t>({0x34, 0x12}));
+}
+
+TEST(Trace, StreamTraceSink) {
+  NativeInstruction ni = MakeInstruction();
+  Interpreter interpreter(1);
+  std::stringstream stream;
+  StreamTraceSink sink(stream);
+  interpreter.set_trace_sink(&sink);
+  interpreter.Execute(ni);
+
+  // instructions and register writes are written, but not memory accesses.
+  std::stringstream expected;
+  expected << ni.reil[0] << std::endl
+           << Operand(Register(64, 0)) << " = " << Imm64(0x2000) << std::endl
+           << ni.reil[1] << std::endl
+           << ni.reil[2] << std::endl
+           << Operand(Temporary(16, 0)) << " = " << Imm16(0x1234)
+           << std::endl;
+  EXPECT_EQ(stream.str(), expected.str());
+}
+
+TEST(Trace, SinkTrace) {
+  // the policy forwards every event to its sink.
+  RecordingTraceSink sink;
+  SinkTrace trace(&sink);
+  uint8_t bytes[4] = {};
+  trace.OnInstruction(0x1000, 1, Nop());
+  trace.OnWrite(Register(64, 0), Imm64(1));
+  trace.OnMemoryRead(0x2000, absl::Span<const uint8_t>(bytes, 4));
+  trace.OnMemoryWrite(0x3000, absl::Span<const uint8_t>(bytes, 2));
+
+  std::vector<std::string> expected = {
+      "instruction 1000:1 " + Print(Nop()),
+      "write " + Print(Register(64, 0), Imm64(1)),
+      "read 2000 4",
+      "write 3000 2",
+  };
+  EXPECT_EQ(sink.events, expected);
+
+  // and the empty policy accepts the same events.
+  NoTrace no_trace;
+  no_trace.OnInstruction(0x1000, 1, Nop());
+  no_trace.OnWrite(Register(64, 0), Imm64(1));
+  no_trace.OnMemoryRead(0x2000, absl::Span<const uint8_t>(bytes, 4));
+  no_trace.OnMemoryWrite(0x3000, absl::Span<const uint8_t>(bytes, 2));
+}
+}  // namespace test
+}  // namespace reil
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
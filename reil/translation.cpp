@@ -15,10 +15,66 @@
 #include "reil/translation.h"
 
 namespace reil {
-Translation::Translation(uint32_t flags) : flags_(flags) {
+NativeInstructionView TranslationBuffer::operator[](size_t index) const {
+  uint32_t mnemonic_begin = index ? entries_[index - 1].mnemonic_end : 0;
+  uint32_t reil_begin = index ? entries_[index - 1].reil_end : 0;
+  const Entry& entry = entries_[index];
+
+  NativeInstructionView view;
+  view.address = entry.address;
+  view.size = entry.size;
+  view.mnemonic = absl::string_view(mnemonics_.data() + mnemonic_begin,
+                                    entry.mnemonic_end - mnemonic_begin);
+  view.reil = absl::Span<const Instruction>(reil_.data() + reil_begin,
+                                            entry.reil_end - reil_begin);
+  return view;
+}
+
+NativeInstruction TranslationBuffer::Get(size_t index) const {
+  NativeInstructionView view = (*this)[index];
+  NativeInstruction ni;
+  ni.address = view.address;
+  ni.size = view.size;
+  ni.mnemonic = Mnemonic(std::string(view.mnemonic));
+  ni.reil.assign(view.reil.begin(), view.reil.end());
+  return ni;
+}
+
+void TranslationBuffer::Clear() {
+  entries_.clear();
+  reil_.clear();
+  mnemonics_.clear();
+}
+
+void TranslationBuffer::Commit(uint64_t address, uint8_t size) {
+  Entry entry;
+  entry.address = address;
+  entry.size = size;
+  entry.mnemonic_end = mnemonics_.size();
+  entry.reil_end = reil_.size();
+  entries_.push_back(entry);
+}
+
+bool EndsBasicBlock(absl::Span<const Instruction> reil) {
+  for (const auto& ri : reil) {
+    if ((ri.opcode == Opcode::Jcc && ri.output.type() != kOffset) ||
+        ri.opcode == Opcode::Sys || ri.opcode == Opcode::Unkn) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Translation::Translation(uint32_t flags)
+    : flags_(flags), translation_(own_translation_), translation_begin_(0) {
   translation_.reserve(0x100);
 }
 
+Translation::Translation(uint32_t flags, std::vector<Instruction>* output)
+    : flags_(flags),
+      translation_(*output),
+      translation_begin_(output->size()) {}
+
 Translation::~Translation() {}
 
 Operand Translation::Tmp(uint16_t size) {
@@ -339,29 +395,38 @@ Operand Translation::UnsignedToSigned(const Operand& value,
   return result;
 }
 
-std::vector<Instruction> Translation::Finalise() {
+void Translation::Resolve() {
   // TODO: Optimise this.
-  for (size_t i = 0; i < translation_.size(); ++i) {
-    auto ri = translation_[i];
-    if (ri.opcode == Opcode::Nop && ri.input0.index() == kLabel) {
-      auto li = absl::get<reil::Label>(ri.input0);
-      for (auto& rj : translation_) {
-        if (rj.opcode == Opcode::Jcc && rj.output.index() == kLabel) {
-          auto lj = absl::get<reil::Label>(rj.output);
+  auto begin = translation_.begin() + translation_begin_;
+  for (size_t i = 0; i < translation_.size() - translation_begin_; ++i) {
+    auto ri = begin[i];
+    if (ri.opcode == Opcode::Nop && ri.input0.type() == kLabel) {
+      auto li = ri.input0.label();
+      for (auto rj = begin; rj != translation_.end(); ++rj) {
+        if (rj->opcode == Opcode::Jcc && rj->output.type() == kLabel) {
+          auto lj = rj->output.label();
           if (li.index == lj.index) {
-            rj.output = Offset(i);
+            rj->output = Offset(i);
           }
         }
       }
 
-      if (i != translation_.size() - 1) {
-        translation_.erase(translation_.begin() + i);
+      if (begin + i != translation_.end() - 1) {
+        translation_.erase(begin + i);
       }
     }
   }
+}
+
+std::vector<Instruction> Translation::Finalise() {
+  Resolve();
 
   // std::cerr << tmp_index_ << std::endl;
 
-  return std::move(translation_);
+  // the instructions are kept long after translation (eg. in caches), so
+  // drop the spare capacity reserved for translating them.
+  std::vector<Instruction> translation(std::move(translation_));
+  translation.shrink_to_fit();
+  return translation;
 }
 }  // namespace reil
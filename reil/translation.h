@@ -16,8 +16,12 @@
 
 #include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
 #include "reil/reil.h"
 
 namespace reil {
@@ -31,14 +35,71 @@ enum TranslationFlags {
   kPerArchitectureFlag = 1 << 24,
 };
 
+// A native instruction that has been translated into a TranslationBuffer.
+// The mnemonic and the REIL instructions point into the buffer, and are only
+// valid until the buffer is next modified.
+struct NativeInstructionView {
+  uint64_t address = 0;
+  uint8_t size = 0;
+  absl::string_view mnemonic;
+  absl::Span<const Instruction> reil;
+};
+
+// An arena that many native instructions can be translated into, so that
+// translating a range of code does not need to allocate per instruction.
+//
+// Translators append the REIL instructions and the mnemonic of each native
+// instruction to reil() and mnemonics(), and then call Commit() to record
+// them; clearing the buffer keeps its storage for reuse.
+class TranslationBuffer {
+  struct Entry {
+    uint64_t address;
+    uint8_t size;
+    uint32_t mnemonic_end;
+    uint32_t reil_end;
+  };
+
+  std::vector<Entry> entries_;
+  std::vector<Instruction> reil_;
+  std::string mnemonics_;
+
+ public:
+  size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+
+  NativeInstructionView operator[](size_t index) const;
+  NativeInstruction Get(size_t index) const;
+
+  void Clear();
+
+  std::vector<Instruction>* reil() { return &reil_; }
+  std::string* mnemonics() { return &mnemonics_; }
+
+  // records everything appended since the previous commit as the
+  // translation of the native instruction at address.
+  void Commit(uint64_t address, uint8_t size);
+};
+
+// returns whether the REIL translation of a native instruction ends a basic
+// block, because it can transfer control anywhere other than within itself or
+// to the next instruction.
+bool EndsBasicBlock(absl::Span<const Instruction> reil);
+
 class Translation {
+ private:
+  std::vector<Instruction> own_translation_;
+
  protected:
   uint32_t flags_;
   bool valid_;
 
   uint16_t tmp_index_ = 0;
   uint8_t label_index_ = 0;
-  std::vector<Instruction> translation_;
+
+  // the instructions are appended to either own_translation_, or to a
+  // caller-provided vector starting at translation_begin_.
+  std::vector<Instruction>& translation_;
+  size_t translation_begin_;
 
   void ReserveInstructions(uint16_t count);
 
@@ -129,10 +190,16 @@ class Translation {
 
  public:
   explicit Translation(uint32_t flags);
+  Translation(uint32_t flags, std::vector<Instruction>* output);
   virtual ~Translation();
 
   bool valid() const { return valid_; }
 
+  // resolves labels into offsets in the instructions appended so far.
+  void Resolve();
+
+  // resolves labels and returns the instructions; only for translations
+  // without a caller-provided output.
   std::vector<Instruction> Finalise();
 };
 }  // namespace reil
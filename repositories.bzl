@@ -21,6 +21,7 @@ def reil_repositories(
   omit_rules_python=False,
   omit_com_google_abseil=False,
   omit_com_github_gflags_gflags=False,
+  omit_com_github_google_benchmark=False,
   omit_com_google_binexport=False,
   omit_com_google_glog=False,
   omit_com_google_googletest=False,
@@ -34,6 +35,8 @@ def reil_repositories(
     com_google_abseil()
   if not omit_com_github_gflags_gflags:
     com_github_gflags_gflags()
+  if not omit_com_github_google_benchmark:
+    com_github_google_benchmark()
   if not omit_com_google_binexport:
     com_google_binexport()
   if not omit_com_google_glog:
@@ -75,6 +78,14 @@ def com_github_gflags_gflags():
     urls = ["https://github.com/gflags/gflags/archive/660603a3df1c400437260b51c55490a046a12e8a.tar.gz"]
   )
 
+def com_github_google_benchmark():
+  http_archive(
+    name = "com_github_google_benchmark",
+    sha256 = "3c6a165b6ecc948967a1ead710d4a181d7b0fbcaa183ef7ea84604994966221a",
+    strip_prefix = "benchmark-1.5.0",
+    urls = ["https://github.com/google/benchmark/archive/v1.5.0.tar.gz"]
+  )
+
 def com_google_binexport():
   http_archive(
     name = "com_google_binexport",